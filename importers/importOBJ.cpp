@@ -250,8 +250,6 @@ namespace mini {
     for (int shapeID=0;shapeID<(int)shapes.size();shapeID++) {
       tinyobj::shape_t &shape = shapes[shapeID];
 
-      Mesh::SP mesh = std::make_shared<Mesh>();
-        
       std::set<int> materialIDs;
       for (auto faceMatID : shape.mesh.material_ids)
         materialIDs.insert(faceMatID);
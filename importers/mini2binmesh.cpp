@@ -51,36 +51,63 @@ int main(int ac, char **av)
   if (inFileName.empty()) usage("no input file name specified");
   if (outFileName.empty()) usage("no output file name base specified");
   
+  // (the binmesh format wants all vertices before all indices; so we
+  // stream over the scene twice, patching in each array's size once
+  // we know it)
   std::cout << MINI_TERMINAL_BLUE
-            << "loading binmesh file from " << inFileName
-            << MINI_TERMINAL_DEFAULT << std::endl;
-
-  Scene::SP scene = Scene::load(inFileName);
-  std::cout << MINI_TERMINAL_GREEN
-            << "scene loaded; now flattening into a single mesh... "
-            << std::endl;
+            << "flattening " << inFileName << " into a single mesh, and saving to "
+            << outFileName << MINI_TERMINAL_DEFAULT << std::endl;
+  std::ofstream out(outFileName,std::ios::binary);
+  size_t count = 0;
+  
+  std::streampos countPos = out.tellp();
+  out.write((char*)&count,sizeof(count));
   std::vector<vec3f> vertices;
-  std::vector<vec3i> indices;
-  for (auto inst : scene->instances)
-    for (auto mesh : inst->object->meshes) {
-      int idxOfs = (int)vertices.size();
-      for (auto vtx : mesh->vertices)
-        vertices.push_back(xfmPoint(inst->xfm,vtx));
-      for (auto idx : mesh->indices)
-        indices.push_back(idxOfs+idx);
+  {
+    SceneReader reader(inFileName);
+    Instance::SP inst;
+    while (reader.next(inst)) {
+      if (!inst) continue;
+      for (auto mesh : inst->object->meshes) {
+        mesh->ensureLoaded();
+        vertices.clear();
+        for (auto vtx : mesh->vertices)
+          vertices.push_back(xfmPoint(inst->xfm,vtx));
+        out.write((char*)vertices.data(),vertices.size()*sizeof(vec3f));
+        count += vertices.size();
+      }
     }
+  }
+  std::streampos endPos = out.tellp();
+  out.seekp(countPos);
+  out.write((char*)&count,sizeof(count));
+  out.seekp(endPos);
   
-  std::cout << MINI_TERMINAL_BLUE
-            << "done flattening into a single mesh; saving to " << outFileName
-            << MINI_TERMINAL_DEFAULT << std::endl;
-  std::ofstream out(outFileName,std::ios::binary);
-  size_t count;
-  count = vertices.size();
+  count = 0;
+  countPos = out.tellp();
   out.write((char*)&count,sizeof(count));
-  out.write((char*)vertices.data(),count*sizeof(vec3f));
-  count = indices.size();
+  std::vector<vec3i> indices;
+  {
+    SceneReader reader(inFileName);
+    Instance::SP inst;
+    int idxOfs = 0;
+    while (reader.next(inst)) {
+      if (!inst) continue;
+      for (auto mesh : inst->object->meshes) {
+        mesh->ensureLoaded();
+        indices.clear();
+        for (auto idx : mesh->indices)
+          indices.push_back(idxOfs+idx);
+        out.write((char*)indices.data(),indices.size()*sizeof(vec3i));
+        count += indices.size();
+        idxOfs += (int)mesh->vertices.size();
+      }
+    }
+  }
+  out.seekp(countPos);
   out.write((char*)&count,sizeof(count));
-  out.write((char*)indices.data(),count*sizeof(vec3i));
+  if (!out.good())
+    throw std::runtime_error("error writing "+outFileName);
   
   std::cout << MINI_TERMINAL_LIGHT_GREEN
             << "lattened scene saved in binmesh format; done."
@@ -8,6 +8,9 @@ using namespace mini;
 #define BAKE_TRANSFORMS 1
 
 Scene::SP g_scene;
+/*! all meshes, objects, instances, and materials get allocated from
+    this arena, rather than with one malloc each */
+Arena::SP g_arena;
 affine3f g_xfm;
 
 void parse_Other(xmlNode * a_node)
@@ -169,7 +172,7 @@ std::string getName(xmlNode *param)
 
 Material::SP parse_Metal(xmlNode *root)
 {
-  Metal::SP mat = Metal::create();
+  Metal::SP mat = makeShared<Metal>(g_arena);
   for (xmlNode *param = findParams(root); param; param = param->next) {
     if (param->type != XML_ELEMENT_NODE)
       continue;
@@ -196,7 +199,7 @@ Material::SP parse_Metal(xmlNode *root)
 
 Material::SP parse_Plastic(xmlNode *root)
 {
-  Plastic::SP mat = Plastic::create();
+  Plastic::SP mat = makeShared<Plastic>(g_arena);
   for (xmlNode *param = findParams(root); param; param = param->next) {
     if (param->type != XML_ELEMENT_NODE)
       continue;
@@ -227,7 +230,7 @@ Material::SP parse_Plastic(xmlNode *root)
 
 Material::SP parse_Velvet(xmlNode *root)
 {
-  Velvet::SP mat = Velvet::create();
+  Velvet::SP mat = makeShared<Velvet>(g_arena);
   for (xmlNode *param = findParams(root); param; param = param->next) {
     if (param->type != XML_ELEMENT_NODE)
       continue;
@@ -258,7 +261,7 @@ Material::SP parse_Velvet(xmlNode *root)
 
 Material::SP parse_MetallicPaint(xmlNode *root)
 {
-  MetallicPaint::SP mat = MetallicPaint::create();
+  MetallicPaint::SP mat = makeShared<MetallicPaint>(g_arena);
   for (xmlNode *param = findParams(root); param; param = param->next) {
     if (param->type != XML_ELEMENT_NODE)
       continue;
@@ -289,7 +292,7 @@ Material::SP parse_MetallicPaint(xmlNode *root)
 
 Material::SP parse_Matte(xmlNode *root)
 {
-  Matte::SP mat = Matte::create();
+  Matte::SP mat = makeShared<Matte>(g_arena);
   for (xmlNode *param = findParams(root); param; param = param->next) {
     if (param->type != XML_ELEMENT_NODE)
       continue;
@@ -308,7 +311,7 @@ Material::SP parse_Matte(xmlNode *root)
 
 Material::SP parse_Dielectric(xmlNode *root)
 {
-  Dielectric::SP mat = Dielectric::create();
+  Dielectric::SP mat = makeShared<Dielectric>(g_arena);
   for (xmlNode *param = findParams(root); param; param = param->next) {
     if (param->type != XML_ELEMENT_NODE)
       continue;
@@ -335,7 +338,7 @@ Material::SP parse_Dielectric(xmlNode *root)
 
 Material::SP parse_ThinGlass(xmlNode *root)
 {
-  ThinGlass::SP mat = ThinGlass::create();
+  ThinGlass::SP mat = makeShared<ThinGlass>(g_arena);
   for (xmlNode *param = findParams(root); param; param = param->next) {
     if (param->type != XML_ELEMENT_NODE)
       continue;
@@ -526,7 +529,7 @@ Material::SP parse_material(xmlNode *root, const std::vector<uint8_t> &binData)
 
 void parse_TriangleMesh(xmlNode *root, const std::vector<uint8_t> &binData)
 {
-  Mesh::SP mesh = Mesh::create();
+  Mesh::SP mesh = makeShared<Mesh>(g_arena);
   
   for (xmlNode *node = root; node; node = node->next) {
     if (node->type != XML_ELEMENT_NODE)
@@ -554,9 +557,11 @@ void parse_TriangleMesh(xmlNode *root, const std::vector<uint8_t> &binData)
     v = xfmPoint(g_xfm,v);
   for (auto &n : mesh->normals)
     n = xfmNormal(g_xfm,n);
-  g_scene->instances.push_back(Instance::create(Object::create({mesh})));
+  Object::SP object = makeShared<Object>(g_arena,std::vector<Mesh::SP>{mesh});
+  g_scene->instances.push_back(makeShared<Instance>(g_arena,object));
 #else
-  g_scene->instances.push_back(Instance::create(Object::create({mesh}),g_xfm));
+  Object::SP object = makeShared<Object>(g_arena,std::vector<Mesh::SP>{mesh});
+  g_scene->instances.push_back(makeShared<Instance>(g_arena,object,g_xfm));
 #endif
 }
 
@@ -638,6 +643,7 @@ int main(int ac, char **av)
   }
 
   g_scene = Scene::create();
+  g_arena = Arena::create();
   
   const std::string binFileName = inFileName.substr(0,inFileName.size()-3)+"bin";
   std::ifstream in(binFileName.c_str(),std::ios::binary);
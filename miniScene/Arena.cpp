@@ -0,0 +1,88 @@
+// ======================================================================== //
+// Copyright 2018-2020 Ingo Wald                                            //
+//                                                                          //
+// Licensed under the Apache License, Version 2.0 (the "License");          //
+// you may not use this file except in compliance with the License.         //
+// You may obtain a copy of the License at                                  //
+//                                                                          //
+//     http://www.apache.org/licenses/LICENSE-2.0                           //
+//                                                                          //
+// Unless required by applicable law or agreed to in writing, software      //
+// distributed under the License is distributed on an "AS IS" BASIS,        //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. //
+// See the License for the specific language governing permissions and      //
+// limitations under the License.                                           //
+// ======================================================================== //
+
+#include "miniScene/Arena.h"
+#include <atomic>
+
+namespace mini {
+
+  /*! the block a thread currently bumps through in a given arena */
+  struct ThreadBlock {
+    uint64_t arenaID   = 0;
+    /*! next free byte in that block, and how many bytes are left
+        there */
+    uint8_t *current   = nullptr;
+    size_t   remaining = 0;
+  };
+
+  /*! every thread keeps the current blocks of the last few arenas it
+      allocated from, so alternating between (a few) arenas does not
+      start a new block on every switch */
+  enum { NUM_THREAD_BLOCKS = 4 };
+  static thread_local ThreadBlock threadBlocks[NUM_THREAD_BLOCKS];
+  static thread_local int         nextThreadBlock = 0;
+
+  static std::atomic<uint64_t> nextArenaID { 1 };
+  
+  Arena::Arena(size_t blockSize)
+    : blockSize(blockSize),
+      arenaID(nextArenaID++)
+  {}
+
+  uint8_t *Arena::newBlock(size_t numBytes)
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    blocks.emplace_back(new uint8_t[numBytes]);
+    numBytesReserved += numBytes;
+    return blocks.back().get();
+  }
+  
+  void *Arena::allocate(size_t numBytes, size_t alignment)
+  {
+    // large requests get a block of their own, so they neither waste
+    // the rest of the current block nor make the next one huge
+    if (numBytes+alignment > blockSize/4) {
+      uint8_t *begin = newBlock(numBytes+alignment);
+      return begin + ((alignment - (uintptr_t)begin) & (alignment-1));
+    }
+    ThreadBlock *block = nullptr;
+    for (auto &tb : threadBlocks)
+      if (tb.arenaID == arenaID) { block = &tb; break; }
+    if (!block) {
+      block = &threadBlocks[nextThreadBlock];
+      nextThreadBlock = (nextThreadBlock+1) % NUM_THREAD_BLOCKS;
+      *block = ThreadBlock();
+      block->arenaID = arenaID;
+    }
+    size_t padding = (alignment - (uintptr_t)block->current) & (alignment-1);
+    if (!block->current || padding+numBytes > block->remaining) {
+      block->current   = newBlock(blockSize);
+      block->remaining = blockSize;
+      padding = (alignment - (uintptr_t)block->current) & (alignment-1);
+    }
+    uint8_t *ptr = block->current+padding;
+    block->current   += padding+numBytes;
+    block->remaining -= padding+numBytes;
+    return ptr;
+  }
+
+  size_t Arena::getNumBytesReserved() const
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    return numBytesReserved;
+  }
+  
+} // ::mini
@@ -0,0 +1,104 @@
+// ======================================================================== //
+// Copyright 2018-2020 Ingo Wald                                            //
+//                                                                          //
+// Licensed under the Apache License, Version 2.0 (the "License");          //
+// you may not use this file except in compliance with the License.         //
+// You may obtain a copy of the License at                                  //
+//                                                                          //
+//     http://www.apache.org/licenses/LICENSE-2.0                           //
+//                                                                          //
+// Unless required by applicable law or agreed to in writing, software      //
+// distributed under the License is distributed on an "AS IS" BASIS,        //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. //
+// See the License for the specific language governing permissions and      //
+// limitations under the License.                                           //
+// ======================================================================== //
+
+#pragma once
+
+#include "miniScene/common.h"
+#include <memory>
+
+namespace mini {
+
+  /*! a monotonic ("bump pointer") memory arena: hands out memory from
+      large blocks, never frees anything individually, and releases
+      all its blocks at once when it dies. Allocating from an arena
+      is thread-safe: each thread bumps through a block of its own,
+      so only getting a new block takes a lock.
+
+      Usually used through makeShared(), in which case every object
+      allocated from the arena keeps that arena alive; ie, the
+      arena's memory gets released once the last such object is
+      gone */
+  struct Arena {
+    typedef std::shared_ptr<Arena> SP;
+
+    inline static SP create(size_t blockSize = defaultBlockSize)
+    { return std::make_shared<Arena>(blockSize); }
+
+    /*! constructs a new arena - note you _probably_ want to use
+        Arena::create() instead */
+    Arena(size_t blockSize = defaultBlockSize);
+
+    /*! returns numBytes bytes of memory, aligned to 'alignment'
+        (which has to be a power of two) */
+    void *allocate(size_t numBytes, size_t alignment);
+
+    /*! total size of all blocks this arena has allocated so far */
+    size_t getNumBytesReserved() const;
+    
+    static const size_t defaultBlockSize = size_t(1)<<20;
+    
+  private:
+    /*! allocates a new block of numBytes bytes and adds it to
+        'blocks' */
+    uint8_t *newBlock(size_t numBytes);
+    
+    mutable std::mutex                    mutex;
+    std::vector<std::unique_ptr<uint8_t[]>> blocks;
+    size_t                                numBytesReserved = 0;
+    const size_t                          blockSize;
+    /*! unique over all arenas ever created, so a thread's bump block
+        can never get mistaken for one of an arena that has since
+        died (and whose address got reused) */
+    const uint64_t                        arenaID;
+  };
+
+  /*! a std allocator that allocates from (and keeps alive) an Arena;
+      for use with std::allocate_shared */
+  template<typename T>
+  struct ArenaAllocator {
+    typedef T value_type;
+
+    ArenaAllocator(const Arena::SP &arena) : arena(arena) {}
+    template<typename U>
+    ArenaAllocator(const ArenaAllocator<U> &other) : arena(other.arena) {}
+
+    inline T *allocate(size_t n)
+    { return (T*)arena->allocate(n*sizeof(T),alignof(T)); }
+    /*! no-op; the memory gets released with the arena */
+    inline void deallocate(T *, size_t) {}
+
+    Arena::SP arena;
+  };
+
+  template<typename T, typename U>
+  inline bool operator==(const ArenaAllocator<T> &a, const ArenaAllocator<U> &b)
+  { return a.arena == b.arena; }
+  template<typename T, typename U>
+  inline bool operator!=(const ArenaAllocator<T> &a, const ArenaAllocator<U> &b)
+  { return a.arena != b.arena; }
+  
+  /*! creates a new T (and its shared_ptr control block) in the given
+      arena; or - if 'arena' is null - with std::make_shared */
+  template<typename T, typename... Args>
+  inline std::shared_ptr<T> makeShared(const Arena::SP &arena, Args&&... args)
+  {
+    if (!arena)
+      return std::make_shared<T>(std::forward<Args>(args)...);
+    return std::allocate_shared<T>(ArenaAllocator<T>(arena),
+                                   std::forward<Args>(args)...);
+  }
+  
+} // ::mini
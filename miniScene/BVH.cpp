@@ -0,0 +1,407 @@
+// ======================================================================== //
+// Copyright 2018-2020 Ingo Wald                                            //
+//                                                                          //
+// Licensed under the Apache License, Version 2.0 (the "License");          //
+// you may not use this file except in compliance with the License.         //
+// You may obtain a copy of the License at                                  //
+//                                                                          //
+//     http://www.apache.org/licenses/LICENSE-2.0                           //
+//                                                                          //
+// Unless required by applicable law or agreed to in writing, software      //
+// distributed under the License is distributed on an "AS IS" BASIS,        //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. //
+// See the License for the specific language governing permissions and      //
+// limitations under the License.                                           //
+// ======================================================================== //
+
+#include "miniScene/BVH.h"
+#include "miniScene/Scene.h"
+#include "miniScene/Serialized.h"
+#include <algorithm>
+
+namespace mini {
+
+  inline float halfArea(const box3f &box)
+  {
+    if (box.empty()) return 0.f;
+    const vec3f d = box.size();
+    return d.x*d.y+d.y*d.z+d.z*d.x;
+  }
+
+  /*! builds a BVH with a binned SAH. Nodes first get built into a
+      temporary array in which each subtree over N prims owns a fixed
+      range of 2N-1 slots - so subtrees can get built in parallel,
+      without the result depending on which thread built what - and
+      then get compacted into the final BVH's node array */
+  struct BVHBuilder {
+    enum { NUM_BINS = 32 };
+    /*! nodes with more prims than this bin (and build their
+        children) in parallel */
+    enum { PARALLEL_THRESHOLD = 4*1024 };
+    
+    struct TempNode {
+      box3f    bounds;
+      /*! prim range (for leaves, ie if count > 0) */
+      uint32_t begin, count;
+      /*! slots of the children (for inner nodes) */
+      uint32_t left, right;
+    };
+
+    /*! per-axis bins of prims' bounds, centroid bounds, and counts;
+        only the first 'numBins' bins (per axis) get used */
+    struct Bins {
+      Bins(int numBins = NUM_BINS) : numBins(numBins)
+      {
+        for (int axis=0;axis<3;axis++)
+          for (int i=0;i<numBins;i++) {
+            bounds[axis][i]     = box3f();
+            centBounds[axis][i] = box3f();
+            count[axis][i]      = 0;
+          }
+      }
+      
+      int      numBins;
+      box3f    bounds[3][NUM_BINS];
+      box3f    centBounds[3][NUM_BINS];
+      uint32_t count[3][NUM_BINS];
+    };
+    
+    BVHBuilder(const std::vector<box3f> &primBounds,
+               const BVH::BuildConfig &config)
+      : primBounds(primBounds), config(config)
+    {}
+
+    inline vec3f centroidOf(uint32_t primID) const
+    { return primBounds[primID].center(); }
+
+    /*! maps centroids into 'numBins' bins per axis, over given
+        (centroid) bounds; small nodes use fewer bins than large
+        ones */
+    struct Binning {
+      Binning(const box3f &centBounds, uint32_t numPrims)
+        : lower(centBounds.lower),
+          numBins(int(std::min(std::max(numPrims,4u),uint32_t(NUM_BINS))))
+      {
+        const vec3f extent = centBounds.size();
+        for (int i=0;i<3;i++)
+          scale[i] = extent[i] > 0.f ? (numBins*(1.f-1e-6f))/extent[i] : 0.f;
+      }
+      inline int binOf(const vec3f &centroid, int axis) const
+      {
+        const int bin = int((centroid[axis]-lower[axis])*scale[axis]);
+        return std::min(std::max(bin,0),numBins-1);
+      }
+      vec3f lower, scale;
+      int   numBins;
+    };
+
+    static Bins merge(const Bins &a, const Bins &b)
+    {
+      Bins result(a.numBins);
+      for (int axis=0;axis<3;axis++)
+        for (int i=0;i<a.numBins;i++) {
+          result.bounds[axis][i]     = a.bounds[axis][i].including(b.bounds[axis][i]);
+          result.centBounds[axis][i] = a.centBounds[axis][i].including(b.centBounds[axis][i]);
+          result.count[axis][i]      = a.count[axis][i]+b.count[axis][i];
+        }
+      return result;
+    }
+    
+    Bins computeBins(uint32_t begin, uint32_t end, const Binning &binning) const
+    {
+      auto binRange = [&](size_t rangeBegin, size_t rangeEnd) {
+        Bins bins(binning.numBins);
+        for (size_t i=rangeBegin;i<rangeEnd;i++) {
+          const uint32_t primID = primIDs[i];
+          const vec3f centroid = centroidOf(primID);
+          for (int axis=0;axis<3;axis++) {
+            const int bin = binning.binOf(centroid,axis);
+            bins.bounds[axis][bin].extend(primBounds[primID]);
+            bins.centBounds[axis][bin].extend(centroid);
+            bins.count[axis][bin]++;
+          }
+        }
+        return bins;
+      };
+      if (end-begin <= PARALLEL_THRESHOLD)
+        return binRange(begin,end);
+      return parallel_reduce((size_t)begin,(size_t)end,PARALLEL_THRESHOLD,
+                             Bins(binning.numBins),binRange,merge);
+    }
+
+    void makeLeaf(TempNode &node, uint32_t begin, uint32_t end)
+    {
+      node.begin = begin;
+      node.count = end-begin;
+    }
+    
+    void build(uint32_t slot, uint32_t begin, uint32_t end,
+               const box3f &bounds, const box3f &centBounds)
+    {
+      TempNode &node = temp[slot];
+      node.bounds = bounds;
+      const uint32_t numPrims = end-begin;
+      if (numPrims == 1) { makeLeaf(node,begin,end); return; }
+
+      // ------------------------------------------------------------------
+      // find the best split over all axes' bins
+      // ------------------------------------------------------------------
+      const vec3f extent = centBounds.size();
+      const Binning binning(centBounds,numPrims);
+      const int numBins = binning.numBins;
+      Bins bins(0);
+      int   bestAxis  = -1;
+      int   bestSplit = -1;
+      float bestCost  = std::numeric_limits<float>::infinity();
+      if (extent.x > 0.f || extent.y > 0.f || extent.z > 0.f) {
+        bins = computeBins(begin,end,binning);
+        for (int axis=0;axis<3;axis++) {
+          if (!(extent[axis] > 0.f)) continue;
+          float    rightArea[NUM_BINS];
+          uint32_t rightCount[NUM_BINS];
+          box3f    box;
+          uint32_t count = 0;
+          for (int i=numBins-1;i>0;--i) {
+            box.extend(bins.bounds[axis][i]);
+            count += bins.count[axis][i];
+            rightArea[i]  = halfArea(box);
+            rightCount[i] = count;
+          }
+          box = box3f();
+          count = 0;
+          for (int i=0;i<numBins-1;i++) {
+            box.extend(bins.bounds[axis][i]);
+            count += bins.count[axis][i];
+            if (count == 0 || rightCount[i+1] == 0) continue;
+            const float cost = halfArea(box)*count + rightArea[i+1]*rightCount[i+1];
+            if (cost < bestCost) {
+              bestCost  = cost;
+              bestAxis  = axis;
+              bestSplit = i;
+            }
+          }
+        }
+      }
+
+      const float leafCost = config.intersectionCost*numPrims;
+      const float area = halfArea(bounds);
+      const float splitCost
+        = (bestAxis < 0)
+        ? std::numeric_limits<float>::infinity()
+        : (area > 0.f
+           ? config.traversalCost+config.intersectionCost*bestCost/area
+           : config.traversalCost+config.intersectionCost*.5f*numPrims);
+      if ((int)numPrims <= config.maxLeafSize && leafCost <= splitCost) {
+        makeLeaf(node,begin,end);
+        return;
+      }
+
+      // ------------------------------------------------------------------
+      // split the prims...
+      // ------------------------------------------------------------------
+      uint32_t mid;
+      box3f lBounds, rBounds, lCentBounds, rCentBounds;
+      if (bestAxis >= 0) {
+        for (int i=0;i<numBins;i++) {
+          box3f &b = (i <= bestSplit) ? lBounds     : rBounds;
+          box3f &c = (i <= bestSplit) ? lCentBounds : rCentBounds;
+          b.extend(bins.bounds[bestAxis][i]);
+          c.extend(bins.centBounds[bestAxis][i]);
+        }
+        mid = uint32_t(std::partition
+                       (primIDs.begin()+begin,primIDs.begin()+end,
+                        [&](uint32_t primID) {
+                          return binning.binOf(centroidOf(primID),bestAxis) <= bestSplit;
+                        })
+                       - primIDs.begin());
+      } else {
+        // all centroids are the same (or there's no usable split), but
+        // too many prims for a leaf: split in the middle
+        mid = begin+numPrims/2;
+        for (uint32_t i=begin;i<end;i++) {
+          const uint32_t primID = primIDs[i];
+          (i < mid ? lBounds : rBounds).extend(primBounds[primID]);
+          (i < mid ? lCentBounds : rCentBounds).extend(centroidOf(primID));
+        }
+      }
+
+      // ------------------------------------------------------------------
+      // ... and recurse; the left subtree gets slots
+      // [slot+1,slot+2*numLeft), the right one the ones after that
+      // ------------------------------------------------------------------
+      node.count = 0;
+      node.left  = slot+1;
+      node.right = slot+2*(mid-begin);
+      if (numPrims > PARALLEL_THRESHOLD)
+        parallel_for(2,[&](int side) {
+            if (side == 0)
+              build(node.left,begin,mid,lBounds,lCentBounds);
+            else
+              build(node.right,mid,end,rBounds,rCentBounds);
+          });
+      else {
+        build(node.left,begin,mid,lBounds,lCentBounds);
+        build(node.right,mid,end,rBounds,rCentBounds);
+      }
+    }
+
+    BVH::SP build()
+    {
+      BVH::SP bvh = std::make_shared<BVH>();
+      if (primBounds.size() >= (1ull<<31))
+        throw std::runtime_error("BVH::build(): too many prims");
+      for (size_t i=0;i<primBounds.size();i++)
+        if (!primBounds[i].empty())
+          primIDs.push_back(uint32_t(i));
+      if (primIDs.empty())
+        return bvh;
+
+      struct RootBounds { box3f bounds, centBounds; };
+      const RootBounds root
+        = parallel_reduce
+        ((size_t)0,primIDs.size(),16*1024,RootBounds(),
+         [&](size_t begin, size_t end) {
+           RootBounds result;
+           for (size_t i=begin;i<end;i++) {
+             result.bounds.extend(primBounds[primIDs[i]]);
+             result.centBounds.extend(centroidOf(primIDs[i]));
+           }
+           return result;
+         },
+         [](const RootBounds &a, const RootBounds &b) {
+           RootBounds result;
+           result.bounds     = a.bounds.including(b.bounds);
+           result.centBounds = a.centBounds.including(b.centBounds);
+           return result;
+         });
+      
+      temp.resize(2*primIDs.size()-1);
+      build(0,0,uint32_t(primIDs.size()),root.bounds,root.centBounds);
+
+      // compact the tree, depth-first, with siblings next to each other
+      std::vector<std::pair<uint32_t,uint32_t>> stack;
+      stack.push_back({0,0});
+      bvh->nodes.resize(1);
+      while (!stack.empty()) {
+        const uint32_t slot  = stack.back().first;
+        const uint32_t nodeID = stack.back().second;
+        stack.pop_back();
+        const TempNode &tempNode = temp[slot];
+        bvh->nodes[nodeID].bounds = tempNode.bounds;
+        if (tempNode.count) {
+          bvh->nodes[nodeID].offset = tempNode.begin;
+          bvh->nodes[nodeID].count  = tempNode.count;
+          continue;
+        }
+        const uint32_t childID = uint32_t(bvh->nodes.size());
+        bvh->nodes.resize(childID+2);
+        bvh->nodes[nodeID].offset = childID;
+        bvh->nodes[nodeID].count  = 0;
+        stack.push_back({tempNode.right,childID+1});
+        stack.push_back({tempNode.left,childID});
+      }
+      bvh->primIDs = std::move(primIDs);
+      return bvh;
+    }
+    
+    const std::vector<box3f> &primBounds;
+    const BVH::BuildConfig   &config;
+    std::vector<uint32_t>     primIDs;
+    std::vector<TempNode>     temp;
+  };
+  
+  BVH::SP BVH::build(const std::vector<box3f> &primBounds,
+                     const BuildConfig &config)
+  {
+    return BVHBuilder(primBounds,config).build();
+  }
+
+  float BVH::sahCost(const BuildConfig &config) const
+  {
+    if (nodes.empty()) return 0.f;
+    const float rootArea = halfArea(nodes[0].bounds);
+    if (!(rootArea > 0.f)) return 0.f;
+    double cost = 0.;
+    for (auto &node : nodes)
+      cost += halfArea(node.bounds)
+        * (node.isLeaf()
+           ? config.intersectionCost*node.count
+           : config.traversalCost);
+    return float(cost/rootArea);
+  }
+  
+  // ==================================================================
+  // object and scene BVHs
+  // ==================================================================
+
+  size_t Object::getPrimOffset(size_t meshID) const
+  {
+    size_t offset = 0;
+    for (size_t i=0;i<meshID && i<meshes.size();i++)
+      if (meshes[i]) offset += meshes[i]->getNumPrims();
+    return offset;
+  }
+  
+  BVH::SP Object::computeBVH(const BVH::BuildConfig &config,
+                             bool asQuantized) const
+  {
+    std::vector<box3f> primBounds(getPrimOffset(meshes.size()));
+    size_t offset = 0;
+    for (auto &mesh : meshes) {
+      if (!mesh) continue;
+      const Mesh &m = mesh->getArrays();
+      // round-trip positions through quantization exactly the way
+      // QuantizedVertices::encode() and decode() do
+      const bool quantize = asQuantized && !m.isQuantized() && !m.vertices.empty();
+      const box3f domain
+        = quantize ? computeBounds(m.vertices.data(),m.vertices.size()) : box3f();
+      auto vertex = [&](int vertexID) {
+        return quantize
+          ? dequantizePosition(quantizePosition(m.vertices[vertexID],domain),domain)
+          : m.getVertex(vertexID);
+      };
+      parallel_for_blocked
+        (0,m.getNumPrims(),16*1024,
+         [&](size_t begin, size_t end) {
+           for (size_t i=begin;i<end;i++) {
+             const vec3i idx = m.getTriangle(i);
+             box3f &box = primBounds[offset+i];
+             box.extend(vertex(idx.x));
+             box.extend(vertex(idx.y));
+             box.extend(vertex(idx.z));
+           }
+         });
+      offset += m.getNumPrims();
+    }
+    return BVH::build(primBounds,config);
+  }
+  
+  void Object::buildBVH(const BVH::BuildConfig &config)
+  {
+    bvh = computeBVH(config);
+  }
+  
+  void Scene::buildBVHs(bool rebuildObjectBVHs,
+                        const BVH::BuildConfig &config)
+  {
+    SerializedScene serialized(this);
+    parallel_for
+      (serialized.objects.size(),
+       [&](size_t objID) {
+         const Object::SP &object = serialized.objects.list[objID];
+         if (rebuildObjectBVHs || !object->bvh)
+           object->buildBVH(config);
+       });
+
+    std::vector<box3f> instanceBounds(instances.size());
+    parallel_for_blocked
+      (0,instances.size(),1024,
+       [&](size_t begin, size_t end) {
+         for (size_t i=begin;i<end;i++)
+           if (instances[i] && instances[i]->object)
+             instanceBounds[i] = instances[i]->getBounds();
+       });
+    bvh = BVH::build(instanceBounds,config);
+  }
+  
+} // ::mini
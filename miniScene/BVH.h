@@ -0,0 +1,79 @@
+// ======================================================================== //
+// Copyright 2018-2020 Ingo Wald                                            //
+//                                                                          //
+// Licensed under the Apache License, Version 2.0 (the "License");          //
+// you may not use this file except in compliance with the License.         //
+// You may obtain a copy of the License at                                  //
+//                                                                          //
+//     http://www.apache.org/licenses/LICENSE-2.0                           //
+//                                                                          //
+// Unless required by applicable law or agreed to in writing, software      //
+// distributed under the License is distributed on an "AS IS" BASIS,        //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. //
+// See the License for the specific language governing permissions and      //
+// limitations under the License.                                           //
+// ======================================================================== //
+
+#pragma once
+
+#include "miniScene/common.h"
+
+namespace mini {
+
+  /*! parameters for building a BVH */
+  struct BVHBuildConfig {
+    /*! leaves with more than this many prims always get split */
+    int   maxLeafSize      = 8;
+    /*! relative costs of traversing a node and of intersecting a
+        prim, for the surface area heuristic */
+    float traversalCost    = 1.f;
+    float intersectionCost = 1.f;
+  };
+  
+  /*! a binary bounding volume hierarchy over a set of primitives
+      (triangles, instances, ...), given only by their bounding
+      boxes. Used both as a per-object "BLAS" over the triangles of
+      an object's meshes (see Object::buildBVH()), and as a "TLAS"
+      over a scene's instances (see Scene::buildBVHs()) */
+  struct BVH {
+    typedef std::shared_ptr<BVH> SP;
+
+    struct Node {
+      inline bool isLeaf() const { return count != 0; }
+      
+      box3f    bounds;
+      /*! for inner nodes, the index of the first of this node's two
+          children (which always are adjacent in 'nodes'); for
+          leaves, the index of this leaf's first prim in 'primIDs' */
+      uint32_t offset;
+      /*! number of prims in this leaf; 0 for inner nodes */
+      uint32_t count;
+    };
+
+    typedef BVHBuildConfig BuildConfig;
+    
+    /*! builds a BVH over prims with the given bounding boxes, using a
+        binned surface area heuristic; builds (large) subtrees in
+        parallel, but the result is deterministic. Prims with empty
+        boxes do not get added */
+    static SP build(const std::vector<box3f> &primBounds,
+                    const BuildConfig &config = BuildConfig());
+
+    /*! bounds of the entire BVH */
+    inline box3f getBounds() const
+    { return nodes.empty() ? box3f() : nodes[0].bounds; }
+
+    /*! the expected cost of a random ray traversing this BVH,
+        according to the surface area heuristic (relative to
+        config's costs) */
+    float sahCost(const BuildConfig &config = BuildConfig()) const;
+    
+    /*! nodes[0] is the root; empty if the BVH has no prims */
+    std::vector<Node>     nodes;
+    /*! the IDs of the prims (ie, their indices into the array of
+        boxes it got built over), in the order leaves refer to
+        them */
+    std::vector<uint32_t> primIDs;
+  };
+  
+} // ::mini
@@ -0,0 +1,218 @@
+// ======================================================================== //
+// Copyright 2018-2020 Ingo Wald                                            //
+//                                                                          //
+// Licensed under the Apache License, Version 2.0 (the "License");          //
+// you may not use this file except in compliance with the License.         //
+// You may obtain a copy of the License at                                  //
+//                                                                          //
+//     http://www.apache.org/licenses/LICENSE-2.0                           //
+//                                                                          //
+// Unless required by applicable law or agreed to in writing, software      //
+// distributed under the License is distributed on an "AS IS" BASIS,        //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. //
+// See the License for the specific language governing permissions and      //
+// limitations under the License.                                           //
+// ======================================================================== //
+
+#include "miniScene/BreakMeshes.h"
+#include "miniScene/Morton.h"
+#include "miniScene/Serialized.h"
+#include <atomic>
+#include <unordered_map>
+
+namespace mini {
+
+  inline vec3f centroidOf(const Mesh &mesh, size_t primID)
+  {
+    const vec3i idx = mesh.getTriangle(primID);
+    return (mesh.getVertex(idx.x)+mesh.getVertex(idx.y)+mesh.getVertex(idx.z))
+      * (1.f/3.f);
+  }
+  
+  /*! appends vertex 'vertexID' of 'in' - with whatever per-vertex
+      arrays that mesh has - to 'out' */
+  inline void copyVertex(Mesh &out, const Mesh &in, size_t vertexID)
+  {
+    if (!in.vertices.empty())
+      out.vertices.push_back(in.vertices[vertexID]);
+    if (!in.normals.empty())
+      out.normals.push_back(in.normals[vertexID]);
+    if (!in.texcoords.empty())
+      out.texcoords.push_back(in.texcoords[vertexID]);
+    if (!in.quantized.vertices.empty())
+      out.quantized.vertices.push_back(in.quantized.vertices[vertexID]);
+    if (!in.quantized.normals.empty())
+      out.quantized.normals.push_back(in.quantized.normals[vertexID]);
+    if (!in.quantized.texcoords.empty())
+      out.quantized.texcoords.push_back(in.quantized.texcoords[vertexID]);
+  }
+  
+  std::vector<Mesh::SP> breakMesh(const Mesh::SP &mesh, size_t maxPrims)
+  {
+    if (maxPrims == 0)
+      throw std::runtime_error("breakMesh: maxPrims has to be at least 1");
+    const Mesh &in = mesh->getArrays();
+    const size_t numPrims = in.getNumPrims();
+    if (numPrims <= maxPrims)
+      return { mesh };
+    if (numPrims >= (1ull<<32))
+      throw std::runtime_error("breakMesh: meshes with 4G or more triangles "
+                               "are not supported");
+    
+    // sort triangles along a Morton curve over their centroids
+    const box3f centBounds
+      = parallel_reduce
+      ((size_t)0,numPrims,16*1024,box3f(),
+       [&](size_t begin, size_t end) {
+         box3f bounds;
+         for (size_t i=begin;i<end;i++)
+           bounds.extend(centroidOf(in,i));
+         return bounds;
+       },
+       [](const box3f &a, const box3f &b) { return a.including(b); });
+    const vec3f scale
+      = rcp(max(centBounds.size(),vec3f(1e-20f)));
+    std::vector<uint64_t> keys(numPrims);
+    parallel_for_blocked
+      (0,numPrims,16*1024,
+       [&](size_t begin, size_t end) {
+         for (size_t i=begin;i<end;i++) {
+           const uint32_t code
+             = mortonCode((centroidOf(in,i)-centBounds.lower)*scale);
+           keys[i] = (uint64_t(code) << 32) | i;
+         }
+       });
+    radixSortUpper32(keys);
+
+    // cut that order into equally sized clusters
+    const size_t numClusters = (numPrims+maxPrims-1)/maxPrims;
+    auto clusterBegin = [&](size_t clusterID)
+    { return clusterID*numPrims/numClusters; };
+
+    // every vertex 'belongs' to the first cluster that uses it; each
+    // cluster assigns (and records) the local IDs of the vertices
+    // it owns in one flat, shared array - no two clusters ever write
+    // the same entry - while the few vertices a cluster shares with
+    // an earlier one get looked up in a small per-cluster table
+    const size_t numVertices = in.getNumVertices();
+    const uint32_t invalid = uint32_t(-1);
+    std::unique_ptr<std::atomic<uint32_t>[]>
+      owner(new std::atomic<uint32_t>[numVertices]);
+    std::vector<uint32_t> localID(numVertices);
+    parallel_for_blocked
+      (0,numVertices,64*1024,
+       [&](size_t begin, size_t end) {
+         for (size_t i=begin;i<end;i++) {
+           owner[i].store(invalid,std::memory_order_relaxed);
+           localID[i] = invalid;
+         }
+       });
+    parallel_for
+      (numClusters,
+       [&](size_t clusterID) {
+         for (size_t i=clusterBegin(clusterID);i<clusterBegin(clusterID+1);i++) {
+           const vec3i idx = in.getTriangle(uint32_t(keys[i]));
+           for (int k=0;k<3;k++) {
+             std::atomic<uint32_t> &o = owner[idx[k]];
+             uint32_t current = o.load(std::memory_order_relaxed);
+             while (clusterID < current
+                    && !o.compare_exchange_weak(current,(uint32_t)clusterID,
+                                                std::memory_order_relaxed))
+               ;
+           }
+         }
+       });
+    
+    std::vector<Mesh::SP> result(numClusters);
+    parallel_for
+      (numClusters,
+       [&](size_t clusterID) {
+         Mesh::SP out = Mesh::create(in.material);
+         out->quantized.domain = in.quantized.domain;
+         std::unordered_map<uint32_t,uint32_t> shared;
+         auto remap = [&](uint32_t vertexID) -> int {
+           if (owner[vertexID].load(std::memory_order_relaxed) == clusterID) {
+             if (localID[vertexID] == invalid) {
+               localID[vertexID] = (uint32_t)out->getNumVertices();
+               copyVertex(*out,in,vertexID);
+             }
+             return (int)localID[vertexID];
+           }
+           auto it = shared.find(vertexID);
+           if (it != shared.end()) return (int)it->second;
+           const uint32_t newID = (uint32_t)out->getNumVertices();
+           copyVertex(*out,in,vertexID);
+           shared[vertexID] = newID;
+           return (int)newID;
+         };
+         const size_t begin = clusterBegin(clusterID);
+         const size_t end   = clusterBegin(clusterID+1);
+         out->indices.resize(end-begin);
+         for (size_t i=begin;i<end;i++) {
+           const vec3i idx = in.getTriangle(uint32_t(keys[i]));
+           out->indices[i-begin] = vec3i(remap(idx.x),remap(idx.y),remap(idx.z));
+         }
+         if (!in.indices16.empty())
+           out->narrowIndices();
+         result[clusterID] = out;
+       });
+    return result;
+  }
+  
+  std::vector<Object::SP> breakObject(const Object::SP &object, size_t maxPrims)
+  {
+    size_t numPrims = 0;
+    for (auto &mesh : object->meshes)
+      if (mesh) numPrims += mesh->getNumPrims();
+    if (numPrims <= maxPrims)
+      return { object };
+    
+    std::vector<Mesh::SP> meshes;
+    for (auto &mesh : object->meshes) {
+      if (!mesh) continue;
+      for (auto &frag : breakMesh(mesh,maxPrims))
+        meshes.push_back(frag);
+    }
+
+    std::vector<Object::SP> result;
+    std::vector<Mesh::SP> currentMeshes;
+    size_t currentSize = 0;
+    for (auto &mesh : meshes) {
+      const size_t meshSize = mesh->getNumPrims();
+      if (!currentMeshes.empty() && currentSize+meshSize > maxPrims) {
+        result.push_back(Object::create(currentMeshes));
+        currentMeshes.clear();
+        currentSize = 0;
+      }
+      currentMeshes.push_back(mesh);
+      currentSize += meshSize;
+    }
+    if (!currentMeshes.empty())
+      result.push_back(Object::create(currentMeshes));
+    return result;
+  }
+  
+  Scene::SP breakLargeMeshes(Scene::SP in, size_t maxPrims)
+  {
+    Scene::SP out = Scene::create();
+    out->quadLights  = in->quadLights;
+    out->dirLights   = in->dirLights;
+    out->envMapLight = in->envMapLight;
+
+    SerializedScene serialized(in.get());
+    std::vector<std::vector<Object::SP>> broken(serialized.objects.size());
+    parallel_for
+      (serialized.objects.size(),
+       [&](size_t objID) {
+         broken[objID] = breakObject(serialized.objects[(int)objID],maxPrims);
+       });
+    
+    for (auto &inst : in->instances) {
+      if (!inst || !inst->object) continue;
+      for (auto &frag : broken[serialized.objects.getID(inst->object)])
+        out->instances.push_back(Instance::create(frag,inst->xfm));
+    }
+    return out;
+  }
+  
+} // ::mini
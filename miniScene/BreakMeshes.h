@@ -0,0 +1,50 @@
+// ======================================================================== //
+// Copyright 2018-2020 Ingo Wald                                            //
+//                                                                          //
+// Licensed under the Apache License, Version 2.0 (the "License");          //
+// you may not use this file except in compliance with the License.         //
+// You may obtain a copy of the License at                                  //
+//                                                                          //
+//     http://www.apache.org/licenses/LICENSE-2.0                           //
+//                                                                          //
+// Unless required by applicable law or agreed to in writing, software      //
+// distributed under the License is distributed on an "AS IS" BASIS,        //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. //
+// See the License for the specific language governing permissions and      //
+// limitations under the License.                                           //
+// ======================================================================== //
+
+#pragma once
+
+#include "miniScene/Scene.h"
+
+namespace mini {
+
+  /*! splits the given mesh into spatially coherent meshes of at most
+      maxPrims triangles each (returns the mesh itself if it already
+      is small enough): triangles get sorted along a Morton curve over
+      their centroids, that order gets cut into equally sized
+      clusters, and each cluster becomes a new mesh with only the
+      vertices (and normals, texcoords) it uses. Clusters get
+      extracted in parallel. All resulting meshes share the input
+      mesh's material, and keep its vertex representation (quantized
+      or not) and index width */
+  std::vector<Mesh::SP> breakMesh(const Mesh::SP &mesh, size_t maxPrims);
+
+  /*! splits all meshes of the given object with breakMesh(), and
+      groups the resulting meshes (in order) into objects of at most
+      maxPrims triangles each. Returns the object itself if it already
+      is small enough */
+  std::vector<Object::SP> breakObject(const Object::SP &object,
+                                      size_t maxPrims);
+  
+  /*! returns a scene with exactly the same lights and triangles as
+      the given one, but in which no object has more than maxPrims
+      triangles: each larger object gets replaced by multiple smaller
+      ones (see breakObject()), each instantiated with the same
+      transform as the original. Objects (and meshes) that do not
+      need breaking get shared with the input scene. Objects get
+      processed in parallel */
+  Scene::SP breakLargeMeshes(Scene::SP in, size_t maxPrims);
+  
+} // ::mini
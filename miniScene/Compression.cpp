@@ -0,0 +1,430 @@
+// ======================================================================== //
+// Copyright 2018-2020 Ingo Wald                                            //
+//                                                                          //
+// Licensed under the Apache License, Version 2.0 (the "License");          //
+// you may not use this file except in compliance with the License.         //
+// You may obtain a copy of the License at                                  //
+//                                                                          //
+//     http://www.apache.org/licenses/LICENSE-2.0                           //
+//                                                                          //
+// Unless required by applicable law or agreed to in writing, software      //
+// distributed under the License is distributed on an "AS IS" BASIS,        //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. //
+// See the License for the specific language governing permissions and      //
+// limitations under the License.                                           //
+// ======================================================================== //
+
+#include "miniScene/Compression.h"
+#ifndef MINI_HAVE_ZLIB
+# define MINI_HAVE_ZLIB 0
+#endif
+#if MINI_HAVE_ZLIB
+# include <zlib.h>
+#endif
+
+namespace mini {
+  namespace compression {
+
+    bool isSupported(Codec codec)
+    {
+      switch (codec) {
+      case NONE:
+      case LZ:
+        return true;
+      case DEFLATE:
+        return MINI_HAVE_ZLIB;
+      default:
+        return false;
+      }
+    }
+    
+    // ==================================================================
+    // filters
+    // ==================================================================
+    
+    /*! replaces each of the given words with its difference to the
+        word 'stride' words before it */
+    template<typename T>
+    inline void applyDelta(const uint8_t *src, std::vector<T> &delta,
+                           size_t numWords, int stride)
+    {
+      delta.resize(numWords);
+      memcpy(delta.data(),src,numWords*sizeof(T));
+      for (size_t i=numWords-1;i>=(size_t)stride && i<numWords;i--)
+        delta[i] -= delta[i-stride];
+    }
+
+    /*! undoes applyDelta(), in place */
+    template<typename T>
+    inline void undoDelta(uint8_t *dst, size_t numWords, int stride)
+    {
+      T *words = (T *)dst;
+      for (size_t i=stride;i<numWords;i++)
+        words[i] += words[i-stride];
+    }
+    
+    /*! number of bytes the byte shuffle of the given filter
+        interleaves: single 4-byte words, except for DELTA16_SHUFFLE,
+        whose 16-bit words would otherwise get mixed up with those
+        of the element's other components, so that one shuffles
+        entire elements (of 'stride' 2-byte words each) */
+    inline size_t shuffleUnitOf(Filter filter, int stride)
+    { return (filter == DELTA16_SHUFFLE) ? 2*size_t(stride) : 4; }
+    
+    void applyFilter(Filter filter, int stride,
+                     const uint8_t *src, uint8_t *dst, size_t numBytes)
+    {
+      const size_t unit     = shuffleUnitOf(filter,stride);
+      const size_t numUnits = numBytes/unit;
+      // whatever doesn't fill a whole unit stays as it is
+      memcpy(dst+unit*numUnits,src+unit*numUnits,numBytes-unit*numUnits);
+      std::vector<uint32_t> delta;
+      std::vector<uint16_t> delta16;
+      if (filter == DELTA_SHUFFLE) {
+        applyDelta(src,delta,numUnits,stride);
+        src = (const uint8_t *)delta.data();
+      } else if (filter == DELTA16_SHUFFLE) {
+        applyDelta(src,delta16,numUnits*stride,stride);
+        src = (const uint8_t *)delta16.data();
+      }
+      for (size_t b=0;b<unit;b++)
+        for (size_t i=0;i<numUnits;i++)
+          *dst++ = src[unit*i+b];
+    }
+    
+    void undoFilter(Filter filter, int stride,
+                    const uint8_t *src, uint8_t *dst, size_t numBytes)
+    {
+      const size_t unit     = shuffleUnitOf(filter,stride);
+      const size_t numUnits = numBytes/unit;
+      memcpy(dst+unit*numUnits,src+unit*numUnits,numBytes-unit*numUnits);
+      for (size_t b=0;b<unit;b++)
+        for (size_t i=0;i<numUnits;i++)
+          dst[unit*i+b] = *src++;
+      if (filter == DELTA_SHUFFLE)
+        undoDelta<uint32_t>(dst,numUnits,stride);
+      else if (filter == DELTA16_SHUFFLE)
+        undoDelta<uint16_t>(dst,numUnits*stride,stride);
+    }
+
+    // ==================================================================
+    // bundled LZ codec (LZ4 block format)
+    // ==================================================================
+
+    inline uint32_t read32(const uint8_t *ptr)
+    { uint32_t v; memcpy(&v,ptr,4); return v; }
+    
+    inline void writeLength(std::vector<uint8_t> &out, size_t length)
+    {
+      for (;length >= 255;length -= 255)
+        out.push_back(255);
+      out.push_back((uint8_t)length);
+    }
+    
+    std::vector<uint8_t> lzCompress(const uint8_t *src, size_t numBytes)
+    {
+      // the LZ4 format requires the last 5 bytes to be literals, and
+      // the last match to start at least 12 bytes before the end
+      const size_t MIN_MATCH   = 4;
+      const size_t MAX_OFFSET  = 65535;
+      const int    HASH_BITS   = 16;
+      const uint32_t NO_ENTRY  = uint32_t(-1);
+      
+      std::vector<uint8_t> out;
+      out.reserve(numBytes + numBytes/255 + 16);
+      std::vector<uint32_t> hashTable(1<<HASH_BITS,NO_ENTRY);
+      auto hash = [](uint32_t seq)
+        { return (seq * 2654435761U) >> (32-HASH_BITS); };
+
+      size_t anchor = 0;
+      size_t ip = 0;
+      if (numBytes > 12) {
+        const size_t matchStartLimit = numBytes-12;
+        const size_t matchEndLimit   = numBytes-5;
+        size_t numMisses = 0;
+        while (ip < matchStartLimit) {
+          const uint32_t seq = read32(src+ip);
+          const uint32_t h   = hash(seq);
+          size_t ref = hashTable[h];
+          hashTable[h] = (uint32_t)ip;
+          if (ref == NO_ENTRY || ip-ref > MAX_OFFSET || read32(src+ref) != seq) {
+            // skip faster through data that doesn't compress
+            ip += 1+(numMisses++ >> 6);
+            continue;
+          }
+          numMisses = 0;
+          // extend the match backwards ...
+          while (ip > anchor && ref > 0 && src[ip-1] == src[ref-1]) { ip--; ref--; }
+          // ... and forwards
+          size_t matchLength = MIN_MATCH;
+          while (ip+matchLength < matchEndLimit && src[ref+matchLength] == src[ip+matchLength])
+            matchLength++;
+
+          // emit the sequence: token, literals, offset, match length
+          const size_t numLiterals = ip-anchor;
+          const size_t tokenPos = out.size();
+          out.push_back(0);
+          uint8_t token = 0;
+          if (numLiterals >= 15) { token = 15<<4; writeLength(out,numLiterals-15); }
+          else token = uint8_t(numLiterals<<4);
+          out.insert(out.end(),src+anchor,src+ip);
+          const size_t offset = ip-ref;
+          out.push_back(uint8_t(offset & 0xff));
+          out.push_back(uint8_t(offset >> 8));
+          const size_t extraLength = matchLength-MIN_MATCH;
+          if (extraLength >= 15) { token |= 15; writeLength(out,extraLength-15); }
+          else token |= uint8_t(extraLength);
+          out[tokenPos] = token;
+
+          ip += matchLength;
+          anchor = ip;
+          if (ip < matchStartLimit)
+            hashTable[hash(read32(src+ip-2))] = uint32_t(ip-2);
+        }
+      }
+      // last literals
+      const size_t numLiterals = numBytes-anchor;
+      if (numLiterals >= 15) { out.push_back(15<<4); writeLength(out,numLiterals-15); }
+      else out.push_back(uint8_t(numLiterals<<4));
+      out.insert(out.end(),src+anchor,src+numBytes);
+      return out;
+    }
+
+    void lzDecompress(const uint8_t *src, size_t srcSize,
+                      uint8_t *dst, size_t numBytes)
+    {
+      const char *corrupt = "corrupt LZ-compressed data block";
+      size_t ip = 0, op = 0;
+      auto readLength = [&](size_t length) {
+        if (length != 15) return length;
+        uint8_t b;
+        do {
+          if (ip >= srcSize) throw std::runtime_error(corrupt);
+          b = src[ip++];
+          length += b;
+        } while (b == 255);
+        return length;
+      };
+      while (true) {
+        if (ip >= srcSize) throw std::runtime_error(corrupt);
+        const uint8_t token = src[ip++];
+        const size_t numLiterals = readLength(token >> 4);
+        if (numLiterals > srcSize-ip || numLiterals > numBytes-op)
+          throw std::runtime_error(corrupt);
+        memcpy(dst+op,src+ip,numLiterals);
+        ip += numLiterals;
+        op += numLiterals;
+        if (ip == srcSize)
+          // last sequence has no match
+          break;
+        
+        if (srcSize-ip < 2) throw std::runtime_error(corrupt);
+        const size_t offset = src[ip] | (size_t(src[ip+1]) << 8);
+        ip += 2;
+        const size_t matchLength = readLength(token & 15)+4;
+        if (offset == 0 || offset > op || matchLength > numBytes-op)
+          throw std::runtime_error(corrupt);
+        const uint8_t *match = dst+op-offset;
+        if (offset >= matchLength)
+          memcpy(dst+op,match,matchLength);
+        else
+          // overlapping match, ie, a repeating pattern
+          for (size_t i=0;i<matchLength;i++)
+            dst[op+i] = match[i];
+        op += matchLength;
+      }
+      if (op != numBytes)
+        throw std::runtime_error(corrupt);
+    }
+
+    // ==================================================================
+    // blocks
+    // ==================================================================
+
+    /*! compresses a single chunk of (already filtered) data; returns
+        an empty vector if compressing didn't work */
+    std::vector<uint8_t> compressChunk(Codec codec, const uint8_t *src, size_t numBytes)
+    {
+      if (codec == LZ)
+        return lzCompress(src,numBytes);
+#if MINI_HAVE_ZLIB
+      if (codec == DEFLATE) {
+        uLongf compressedSize = compressBound((uLong)numBytes);
+        std::vector<uint8_t> compressed(compressedSize);
+        if (compress2(compressed.data(),&compressedSize,src,(uLong)numBytes,
+                      Z_DEFAULT_COMPRESSION) != Z_OK)
+          throw std::runtime_error("zlib compression failed");
+        compressed.resize(compressedSize);
+        return compressed;
+      }
+#endif
+      return {};
+    }
+
+    void decompressChunk(Codec codec, const uint8_t *src, size_t srcSize,
+                         uint8_t *dst, size_t numBytes)
+    {
+      if (codec == LZ) {
+        lzDecompress(src,srcSize,dst,numBytes);
+        return;
+      }
+#if MINI_HAVE_ZLIB
+      if (codec == DEFLATE) {
+        uLongf uncompressedSize = (uLongf)numBytes;
+        if (uncompress(dst,&uncompressedSize,src,(uLong)srcSize) != Z_OK
+            || uncompressedSize != numBytes)
+          throw std::runtime_error("corrupt deflate-compressed data block");
+        return;
+      }
+#endif
+      throw std::runtime_error("corrupt data block");
+    }
+    
+    void encodeBlock(std::vector<uint8_t> &out,
+                     const void *data, size_t numBytes,
+                     Codec codec, Filter filter, int stride,
+                     int wordSize)
+    {
+      if (!isSupported(codec))
+        throw std::runtime_error("compression codec #"+std::to_string((int)codec)
+                                 +" not supported in this build");
+      BlockHeader header;
+      header.codec         = codec;
+      header.filter        = filter;
+      header.stride        = (uint8_t)std::max(1,std::min(stride,255));
+      header.chunkSizeLog2 = DEFAULT_CHUNK_SIZE_LOG2;
+      
+      const size_t chunkSize = size_t(1) << header.chunkSizeLog2;
+      const size_t numChunks = (numBytes+chunkSize-1)/chunkSize;
+      std::vector<std::vector<uint8_t>> chunks(numChunks);
+      size_t compressedSize = numChunks*sizeof(uint32_t);
+      if (codec != NONE && numBytes > 0 && filter == AUTO_FILTER) {
+        // pick whichever filter works best on (the start of) the
+        // data; the delta filters get tried relative to both the
+        // previous element and the one before that, since, e.g., the
+        // two triangles of a quad usually have very similar indices
+        const size_t sampleSize = std::min(numBytes,size_t(64*1024));
+        std::vector<uint8_t> sample(sampleSize);
+        size_t bestSize = size_t(-1);
+        const Filter delta = (wordSize == 2) ? DELTA16_SHUFFLE : DELTA_SHUFFLE;
+        const int    elementStride = header.stride;
+        const std::pair<Filter,int> candidates[] = {
+          { NO_FILTER,0 },
+          { SHUFFLE,0 },
+          { delta,elementStride },
+          { delta,std::min(2*elementStride,255) }
+        };
+        for (auto candidate : candidates) {
+          const uint8_t *src = (const uint8_t *)data;
+          if (candidate.first != NO_FILTER) {
+            applyFilter(candidate.first,std::max(candidate.second,1),
+                        src,sample.data(),sampleSize);
+            src = sample.data();
+          }
+          const size_t candidateSize = compressChunk(codec,src,sampleSize).size();
+          if (candidateSize < bestSize) {
+            bestSize = candidateSize;
+            filter   = candidate.first;
+            if (candidate.second) header.stride = (uint8_t)candidate.second;
+          }
+        }
+        header.filter = filter;
+      }
+      if (codec != NONE && numBytes > 0) {
+        const uint8_t *src = (const uint8_t *)data;
+        std::vector<uint8_t> filtered;
+        if (filter != NO_FILTER) {
+          filtered.resize(numBytes);
+          applyFilter(filter,header.stride,src,filtered.data(),numBytes);
+          src = filtered.data();
+        }
+        parallel_for
+          (numChunks,
+           [&](size_t chunkID) {
+             const size_t begin = chunkID*chunkSize;
+             const size_t end   = std::min(begin+chunkSize,numBytes);
+             chunks[chunkID] = compressChunk(codec,src+begin,end-begin);
+           });
+        for (auto &chunk : chunks)
+          compressedSize += chunk.size();
+      }
+      
+      if (codec == NONE || numBytes == 0
+          || compressedSize+sizeof(compressedSize) >= numBytes) {
+        // not worth it (or not asked for) - store as is
+        header.codec  = NONE;
+        header.filter = NO_FILTER;
+        const uint8_t *bytes = (const uint8_t *)&header;
+        out.insert(out.end(),bytes,bytes+sizeof(header));
+        out.insert(out.end(),(const uint8_t *)data,(const uint8_t *)data+numBytes);
+        return;
+      }
+      const uint8_t *bytes = (const uint8_t *)&header;
+      out.insert(out.end(),bytes,bytes+sizeof(header));
+      bytes = (const uint8_t *)&compressedSize;
+      out.insert(out.end(),bytes,bytes+sizeof(compressedSize));
+      // chunk table, then all the chunks
+      for (auto &chunk : chunks) {
+        const uint32_t chunkBytes = (uint32_t)chunk.size();
+        bytes = (const uint8_t *)&chunkBytes;
+        out.insert(out.end(),bytes,bytes+sizeof(chunkBytes));
+      }
+      for (auto &chunk : chunks)
+        out.insert(out.end(),chunk.begin(),chunk.end());
+    }
+
+    void decodeBlock(const BlockHeader &header,
+                     const uint8_t *compressed, size_t compressedSize,
+                     void *dst, size_t numBytes)
+    {
+      if (!isSupported(header.codec))
+        throw std::runtime_error
+          ("file uses compression codec #"+std::to_string((int)header.codec)
+           +", which is not supported in this build"
+           +(header.codec == DEFLATE ? " (rebuild with MINI_USE_ZLIB)" : ""));
+      if (header.filter > DELTA16_SHUFFLE || header.chunkSizeLog2 >= 8*sizeof(size_t)-1)
+        throw std::runtime_error("corrupt data block header");
+      if (header.codec == NONE) {
+        if (compressedSize != numBytes)
+          throw std::runtime_error("corrupt data block");
+        memcpy(dst,compressed,numBytes);
+        return;
+      }
+      
+      const size_t chunkSize = size_t(1) << header.chunkSizeLog2;
+      const size_t numChunks = (numBytes+chunkSize-1)/chunkSize;
+      if (compressedSize < numChunks*sizeof(uint32_t))
+        throw std::runtime_error("corrupt data block");
+      std::vector<size_t> chunkBegin(numChunks+1);
+      chunkBegin[0] = numChunks*sizeof(uint32_t);
+      for (size_t i=0;i<numChunks;i++) {
+        uint32_t chunkBytes;
+        memcpy(&chunkBytes,compressed+i*sizeof(uint32_t),sizeof(chunkBytes));
+        chunkBegin[i+1] = chunkBegin[i]+chunkBytes;
+      }
+      if (chunkBegin[numChunks] != compressedSize)
+        throw std::runtime_error("corrupt data block");
+      
+      std::vector<uint8_t> unfiltered;
+      uint8_t *out = (uint8_t *)dst;
+      if (header.filter != NO_FILTER) {
+        unfiltered.resize(numBytes);
+        out = unfiltered.data();
+      }
+      parallel_for
+        (numChunks,
+         [&](size_t chunkID) {
+           const size_t begin = chunkID*chunkSize;
+           const size_t end   = std::min(begin+chunkSize,numBytes);
+           decompressChunk(header.codec,
+                           compressed+chunkBegin[chunkID],
+                           chunkBegin[chunkID+1]-chunkBegin[chunkID],
+                           out+begin,end-begin);
+         });
+      if (header.filter != NO_FILTER)
+        undoFilter(header.filter,std::max<int>(header.stride,1),
+                   unfiltered.data(),(uint8_t *)dst,numBytes);
+    }
+    
+  } // ::mini::compression
+} // ::mini
@@ -0,0 +1,112 @@
+// ======================================================================== //
+// Copyright 2018-2020 Ingo Wald                                            //
+//                                                                          //
+// Licensed under the Apache License, Version 2.0 (the "License");          //
+// you may not use this file except in compliance with the License.         //
+// You may obtain a copy of the License at                                  //
+//                                                                          //
+//     http://www.apache.org/licenses/LICENSE-2.0                           //
+//                                                                          //
+// Unless required by applicable law or agreed to in writing, software      //
+// distributed under the License is distributed on an "AS IS" BASIS,        //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. //
+// See the License for the specific language governing permissions and      //
+// limitations under the License.                                           //
+// ======================================================================== //
+
+#pragma once
+
+#include "miniScene/common.h"
+
+namespace mini {
+  namespace compression {
+
+    /*! the (lossless) codecs a data block in a .mini file can be
+        compressed with */
+    typedef enum : uint8_t {
+      /*! not compressed at all */
+      NONE = 0,
+      /*! the bundled LZ77-style codec (using the LZ4 block format);
+          fast to compress, and very fast to decompress */
+      LZ,
+      /*! zlib's deflate; better compression, but slower. Only
+          available if miniScene was built with MINI_USE_ZLIB */
+      DEFLATE
+    } Codec;
+
+    /*! (reversible) transforms that get applied to a block's data
+        before compressing it, to make it more compressible. All but
+        DELTA16_SHUFFLE work on 4-byte words (ie, floats or ints) */
+    typedef enum : uint8_t {
+      NO_FILTER = 0,
+      /*! "byte shuffle": first all the words' first bytes, then all
+          their second bytes, etc; groups the (highly correlated)
+          sign/exponent bytes of float arrays */
+      SHUFFLE,
+      /*! replaces each word with the difference to the same component
+          of the previous element (e.g., x-x, y-y, z-z for vec3f's),
+          then byte-shuffles the result; particularly good for index
+          arrays, and for vertex arrays with some spatial coherence */
+      DELTA_SHUFFLE,
+      /*! like DELTA_SHUFFLE, but on 2-byte words; for arrays of
+          16-bit components (quantized positions, octahedral normals,
+          half-float texcoords, 16-bit indices). Version 22+ only */
+      DELTA16_SHUFFLE,
+      /*! not an actual filter (and never stored in a file): asks
+          encodeBlock() to try all filters on a sample of the data,
+          and use whichever compresses best */
+      AUTO_FILTER = 0xff
+    } Filter;
+
+    /*! returns whether the given codec is available in this build */
+    bool isSupported(Codec codec);
+    
+    /*! the header that gets written before every (possibly
+        compressed) block's data */
+    struct BlockHeader {
+      Codec   codec;
+      Filter  filter;
+      /*! number of words per element, for DELTA_SHUFFLE (4-byte
+          words) and DELTA16_SHUFFLE (2-byte words) */
+      uint8_t stride;
+      /*! compressed blocks consist of independently compressed
+          chunks of (1<<chunkSizeLog2) bytes each, which can get
+          compressed and decompressed in parallel */
+      uint8_t chunkSizeLog2;
+    };
+
+    enum { DEFAULT_CHUNK_SIZE_LOG2 = 22 };
+    
+    /*! encodes the given 'numBytes' bytes at 'data' with given codec
+        and filter, and appends the block header, the compressed size
+        (if compressed), and the compressed data (a table of
+        compressed chunk sizes, followed by those chunks) to 'out'. If
+        compression does not reduce the size, the block gets stored
+        uncompressed (with codec NONE) instead. 'wordSize' is the size
+        of the data's components (2 or 4 bytes), and 'stride' the
+        number of components per element; with AUTO_FILTER these
+        decide which of DELTA_SHUFFLE and DELTA16_SHUFFLE gets tried */
+    void encodeBlock(std::vector<uint8_t> &out,
+                     const void *data, size_t numBytes,
+                     Codec codec, Filter filter, int stride,
+                     int wordSize);
+
+    /*! decodes a compressed block's data (the part following the
+        block header and compressed size) into exactly 'numBytes'
+        bytes at 'dst', decompressing its chunks in parallel; throws
+        a std::runtime_error if the data is corrupt */
+    void decodeBlock(const BlockHeader &header,
+                     const uint8_t *compressed, size_t compressedSize,
+                     void *dst, size_t numBytes);
+
+    /*! compresses 'numBytes' bytes with the bundled LZ codec;
+        returns the compressed data */
+    std::vector<uint8_t> lzCompress(const uint8_t *src, size_t numBytes);
+    
+    /*! decompresses LZ-compressed data into exactly 'numBytes' bytes
+        at 'dst'; throws a std::runtime_error if the data is corrupt */
+    void lzDecompress(const uint8_t *src, size_t srcSize,
+                      uint8_t *dst, size_t numBytes);
+    
+  } // ::mini::compression
+} // ::mini
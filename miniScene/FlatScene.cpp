@@ -0,0 +1,135 @@
+// ======================================================================== //
+// Copyright 2018-2020 Ingo Wald                                            //
+//                                                                          //
+// Licensed under the Apache License, Version 2.0 (the "License");          //
+// you may not use this file except in compliance with the License.         //
+// You may obtain a copy of the License at                                  //
+//                                                                          //
+//     http://www.apache.org/licenses/LICENSE-2.0                           //
+//                                                                          //
+// Unless required by applicable law or agreed to in writing, software      //
+// distributed under the License is distributed on an "AS IS" BASIS,        //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. //
+// See the License for the specific language governing permissions and      //
+// limitations under the License.                                           //
+// ======================================================================== //
+
+#include "miniScene/FlatScene.h"
+#include "miniScene/Serialized.h"
+
+namespace mini {
+
+  FlatScene::SP FlatScene::fromObjects(const std::vector<Object::SP> &objects)
+  {
+    SerializedScene serialized(objects);
+    SP flat = create();
+
+    flat->meshes    = serialized.meshes.list;
+    flat->materials = serialized.materials.list;
+    // (skip the null texture that SerializedScene always registers first)
+    flat->textures.assign(serialized.textures.list.begin()+1,
+                          serialized.textures.list.end());
+    
+    flat->meshMaterials.resize(flat->meshes.size());
+    parallel_for_blocked
+      (0,flat->meshes.size(),4096,
+       [&](size_t begin, size_t end) {
+         for (size_t i=begin;i<end;i++)
+           flat->meshMaterials[i]
+             = serialized.materials.getID(flat->meshes[i]->material);
+       });
+
+    for (auto &object : objects) {
+      if (object)
+        for (auto &mesh : object->meshes) {
+          if (!mesh) continue;
+          flat->objectMeshes.push_back(serialized.meshes.getID(mesh));
+        }
+      flat->objectMeshBegin.push_back((uint32_t)flat->objectMeshes.size());
+    }
+    return flat;
+  }
+  
+  FlatScene::SP FlatScene::fromScene(const Scene *scene)
+  {
+    SerializedScene serialized(scene);
+    SP flat = fromObjects(serialized.objects.list);
+
+    flat->quadLights  = scene->quadLights;
+    flat->dirLights   = scene->dirLights;
+    flat->envMapLight = scene->envMapLight;
+
+    const size_t numInstances = scene->instances.size();
+    flat->instanceXfms.resize(numInstances);
+    flat->instanceObjects.resize(numInstances);
+    parallel_for_blocked
+      (0,numInstances,16*1024,
+       [&](size_t begin, size_t end) {
+         for (size_t i=begin;i<end;i++) {
+           const Instance::SP &inst = scene->instances[i];
+           if (inst && inst->object) {
+             flat->instanceXfms[i]    = inst->xfm;
+             flat->instanceObjects[i] = serialized.objects.getID(inst->object);
+           } else {
+             flat->instanceXfms[i]    = affine3f();
+             flat->instanceObjects[i] = -1;
+           }
+         }
+       });
+    return flat;
+  }
+
+  std::vector<Object::SP> FlatScene::createObjects() const
+  {
+    std::vector<Object::SP> objects(getNumObjects());
+    parallel_for_blocked
+      (0,objects.size(),1024,
+       [&](size_t begin, size_t end) {
+         for (size_t i=begin;i<end;i++) {
+           Object::SP object = Object::create();
+           for (uint32_t j=objectMeshBegin[i];j<objectMeshBegin[i+1];j++)
+             object->meshes.push_back(meshes[objectMeshes[j]]);
+           objects[i] = object;
+         }
+       });
+    return objects;
+  }
+  
+  Scene::SP FlatScene::toScene() const
+  {
+    std::vector<Object::SP> objects = createObjects();
+    Scene::SP scene = Scene::create();
+    scene->quadLights  = quadLights;
+    scene->dirLights   = dirLights;
+    scene->envMapLight = envMapLight;
+
+    scene->instances.resize(getNumInstances());
+    parallel_for_blocked
+      (0,getNumInstances(),16*1024,
+       [&](size_t begin, size_t end) {
+         for (size_t i=begin;i<end;i++) {
+           const int objectID = instanceObjects[i];
+           if (objectID >= 0)
+             scene->instances[i] = Instance::create(objects[objectID],instanceXfms[i]);
+         }
+       });
+    return scene;
+  }
+
+  void FlatScene::save(const std::string &fileName,
+                       const SaveOptions &options) const
+  {
+    // a scene that carries only the lights; the instances get
+    // written directly from our arrays
+    Scene lights;
+    lights.quadLights  = quadLights;
+    lights.dirLights   = dirLights;
+    lights.envMapLight = envMapLight;
+    
+    SceneWriter writer(fileName,&lights,createObjects(),options);
+    for (size_t i=0;i<getNumInstances();i++)
+      writer.write(instanceXfms[i],instanceObjects[i]);
+    writer.close();
+  }
+  
+} // ::mini
@@ -0,0 +1,94 @@
+// ======================================================================== //
+// Copyright 2018-2020 Ingo Wald                                            //
+//                                                                          //
+// Licensed under the Apache License, Version 2.0 (the "License");          //
+// you may not use this file except in compliance with the License.         //
+// You may obtain a copy of the License at                                  //
+//                                                                          //
+//     http://www.apache.org/licenses/LICENSE-2.0                           //
+//                                                                          //
+// Unless required by applicable law or agreed to in writing, software      //
+// distributed under the License is distributed on an "AS IS" BASIS,        //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. //
+// See the License for the specific language governing permissions and      //
+// limitations under the License.                                           //
+// ======================================================================== //
+
+#pragma once
+
+#include "miniScene/Scene.h"
+
+namespace mini {
+
+  /*! a "flat" version of a mini::Scene, in which instances, objects,
+      meshes, and materials refer to each other through integer IDs
+      in contiguous arrays, rather than through shared pointers. An
+      instance costs only its transform and an object ID (no heap
+      allocation, no ref-counting), and the arrays can get uploaded
+      to a renderer as they are. Meshes, materials, and textures
+      themselves are the same (shared) ones as in a Scene.
+
+      Unlike a Scene, a FlatScene does not carry any BVHs */
+  struct FlatScene {
+    typedef std::shared_ptr<FlatScene> SP;
+
+    inline static SP create() { return std::make_shared<FlatScene>(); }
+    
+    /*! creates a flat scene with the same lights, instances, objects
+        and meshes as the given one; objects and meshes get numbered
+        in the same order as when saving that scene */
+    static SP fromScene(const Scene *scene);
+
+    /*! creates a flat scene with the given objects - numbered in
+        exactly that order - and their meshes, materials, and
+        textures, but without any instances or lights */
+    static SP fromObjects(const std::vector<Object::SP> &objects);
+    
+    /*! creates a new Scene (with new instances and objects, but the
+        same meshes) from this flat scene */
+    Scene::SP toScene() const;
+
+    /*! loads a ".mini" file directly into a flat scene, without
+        creating any Instance or Object (for version 13+ files; older
+        ones get loaded as a Scene, and converted) */
+    static SP load(const std::string &fileName,
+                   const LoadOptions &options = LoadOptions());
+
+    /*! saves this scene, in the same format as Scene::save() */
+    void save(const std::string &fileName,
+              const SaveOptions &options = SaveOptions()) const;
+
+    /*! creates a (new) Object for each of this scene's objects */
+    std::vector<Object::SP> createObjects() const;
+    
+    inline size_t getNumInstances() const { return instanceObjects.size(); }
+    inline size_t getNumObjects()   const
+    { return objectMeshBegin.empty() ? 0 : objectMeshBegin.size()-1; }
+    
+    std::vector<QuadLight>    quadLights;
+    std::vector<DirLight>     dirLights;
+    EnvMapLight::SP           envMapLight;
+
+    /*! transform of each instance */
+    std::vector<affine3f>     instanceXfms;
+    /*! object ID of each instance; -1 for null instances */
+    std::vector<int>          instanceObjects;
+    
+    /*! object #i's meshes are objectMeshes[objectMeshBegin[i]] up to
+        (excluding) objectMeshes[objectMeshBegin[i+1]]; ie, this has
+        one entry more than there are objects */
+    std::vector<uint32_t>     objectMeshBegin { 0 };
+    /*! mesh IDs of all objects' meshes */
+    std::vector<int>          objectMeshes;
+
+    /*! all meshes, each one once */
+    std::vector<Mesh::SP>     meshes;
+    /*! ID (in 'materials') of each mesh's material; always the same
+        as that mesh's 'material' */
+    std::vector<int>          meshMaterials;
+    std::vector<Material::SP> materials;
+    /*! all textures the materials use (not incl. the env-map's) */
+    std::vector<Texture::SP>  textures;
+  };
+
+} // ::mini
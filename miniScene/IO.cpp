@@ -0,0 +1,364 @@
+// ======================================================================== //
+// Copyright 2018++ Ingo Wald                                               //
+//                                                                          //
+// Licensed under the Apache License, Version 2.0 (the "License");          //
+// you may not use this file except in compliance with the License.         //
+// You may obtain a copy of the License at                                  //
+//                                                                          //
+//     http://www.apache.org/licenses/LICENSE-2.0                           //
+//                                                                          //
+// Unless required by applicable law or agreed to in writing, software      //
+// distributed under the License is distributed on an "AS IS" BASIS,        //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. //
+// See the License for the specific language governing permissions and      //
+// limitations under the License.                                           //
+// ======================================================================== //
+
+#include "miniScene/IO.h"
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <mutex>
+#include <thread>
+#ifdef _WIN32
+# include <windows.h>
+#else
+# include <sys/stat.h>
+# include <fcntl.h>
+# include <unistd.h>
+#endif
+
+namespace mini {
+  namespace io {
+
+#ifdef _WIN32
+    RandomAccessFile::RandomAccessFile(const std::string &fileName)
+    {
+      fileHandle = CreateFileA(fileName.c_str(),GENERIC_READ,FILE_SHARE_READ,
+                               nullptr,OPEN_EXISTING,FILE_ATTRIBUTE_NORMAL,
+                               nullptr);
+      if (fileHandle == INVALID_HANDLE_VALUE)
+        throw std::runtime_error("could not open file '"+fileName+"'");
+      LARGE_INTEGER fileSize;
+      if (!GetFileSizeEx((HANDLE)fileHandle,&fileSize)) {
+        CloseHandle((HANDLE)fileHandle);
+        throw std::runtime_error("could not query size of file '"+fileName+"'");
+      }
+      numBytes = (size_t)fileSize.QuadPart;
+    }
+    
+    RandomAccessFile::~RandomAccessFile()
+    {
+      CloseHandle((HANDLE)fileHandle);
+    }
+
+    void RandomAccessFile::readAt(size_t offset, void *dst, size_t numBytes) const
+    {
+      uint8_t *ptr = (uint8_t *)dst;
+      while (numBytes > 0) {
+        OVERLAPPED ov = {};
+        ov.Offset     = (DWORD)(offset & 0xffffffffull);
+        ov.OffsetHigh = (DWORD)(offset >> 32);
+        DWORD numRead = 0;
+        DWORD toRead  = (DWORD)std::min(numBytes,size_t(1<<30));
+        if (!ReadFile((HANDLE)fileHandle,ptr,toRead,&numRead,&ov) || numRead == 0)
+          throw std::runtime_error("partial read");
+        ptr      += numRead;
+        offset   += numRead;
+        numBytes -= numRead;
+      }
+    }
+#else
+    RandomAccessFile::RandomAccessFile(const std::string &fileName)
+    {
+      fd = ::open(fileName.c_str(),O_RDONLY);
+      if (fd < 0)
+        throw std::runtime_error("could not open file '"+fileName+"'");
+      struct stat st;
+      if (fstat(fd,&st) != 0) {
+        ::close(fd);
+        throw std::runtime_error("could not query size of file '"+fileName+"'");
+      }
+      numBytes = (size_t)st.st_size;
+    }
+    
+    RandomAccessFile::~RandomAccessFile()
+    {
+      ::close(fd);
+    }
+
+    void RandomAccessFile::readAt(size_t offset, void *dst, size_t numBytes) const
+    {
+      uint8_t *ptr = (uint8_t *)dst;
+      while (numBytes > 0) {
+        ssize_t numRead = ::pread(fd,ptr,std::min(numBytes,size_t(1<<30)),(off_t)offset);
+        if (numRead <= 0)
+          throw std::runtime_error("partial read");
+        ptr      += numRead;
+        offset   += numRead;
+        numBytes -= numRead;
+      }
+    }
+#endif
+    
+    // ------------------------------------------------------------------
+    /*! the background thread (and its queue of full buffers) of a
+        FileWriter that got created with writeInBackground=true */
+    struct FileWriter::BackgroundWriter {
+      struct Block {
+        size_t               offset;
+        std::vector<uint8_t> data;
+        size_t               numBytes;
+      };
+
+      BackgroundWriter(FileWriter *owner, size_t bufferSize, int maxQueuedBuffers)
+        : owner(owner),
+          bufferSize(bufferSize),
+          maxQueuedBuffers(std::max(maxQueuedBuffers,1))
+      { thread = std::thread([this](){ run(); }); }
+
+      /*! takes a full buffer (and replaces it with an empty one);
+          blocks while the queue is full */
+      void push(size_t offset, std::vector<uint8_t> &buffer, size_t numBytes)
+      {
+        std::unique_lock<std::mutex> lock(mutex);
+        cv.wait(lock,[&](){ return error || queue.size() < (size_t)maxQueuedBuffers; });
+        if (error) std::rethrow_exception(error);
+        queue.push_back({offset,std::move(buffer),numBytes});
+        if (freeBuffers.empty())
+          buffer.resize(bufferSize);
+        else {
+          buffer = std::move(freeBuffers.back());
+          freeBuffers.pop_back();
+        }
+        cv.notify_all();
+      }
+
+      /*! waits until all queued buffers got written */
+      void waitIdle()
+      {
+        std::unique_lock<std::mutex> lock(mutex);
+        cv.wait(lock,[&](){ return queue.empty() && !busy; });
+        if (error) std::rethrow_exception(error);
+      }
+      
+      void stop()
+      {
+        {
+          std::lock_guard<std::mutex> lock(mutex);
+          stopped = true;
+          cv.notify_all();
+        }
+        thread.join();
+      }
+      
+    private:
+      void run()
+      {
+        std::unique_lock<std::mutex> lock(mutex);
+        while (true) {
+          cv.wait(lock,[&](){ return stopped || !queue.empty(); });
+          if (queue.empty()) break;
+          Block block = std::move(queue.front());
+          queue.pop_front();
+          busy = true;
+          if (!error) {
+            lock.unlock();
+            std::exception_ptr blockError;
+            try {
+              owner->writeToFile(block.offset,block.data.data(),block.numBytes);
+            } catch (...) {
+              blockError = std::current_exception();
+            }
+            lock.lock();
+            if (blockError) error = blockError;
+          }
+          busy = false;
+          freeBuffers.push_back(std::move(block.data));
+          cv.notify_all();
+        }
+      }
+
+      FileWriter *const                 owner;
+      const size_t                      bufferSize;
+      const int                         maxQueuedBuffers;
+      std::thread                       thread;
+      std::mutex                        mutex;
+      std::condition_variable           cv;
+      std::deque<Block>                 queue;
+      std::vector<std::vector<uint8_t>> freeBuffers;
+      bool                              busy    = false;
+      bool                              stopped = false;
+      std::exception_ptr                error;
+    };
+    
+    FileWriter::FileWriter(const std::string &fileName,
+                           size_t bufferSize,
+                           bool writeInBackground,
+                           int maxQueuedBuffers)
+      : fileName(fileName), buffer(std::max(bufferSize,size_t(1)))
+    {
+#ifdef _WIN32
+      fileHandle = CreateFileA(fileName.c_str(),GENERIC_WRITE,0,
+                               nullptr,CREATE_ALWAYS,
+                               FILE_ATTRIBUTE_NORMAL|FILE_FLAG_SEQUENTIAL_SCAN,
+                               nullptr);
+      if (fileHandle == INVALID_HANDLE_VALUE) {
+        fileHandle = nullptr;
+        throw std::runtime_error("could not open file '"+fileName+"'");
+      }
+#else
+      fd = ::open(fileName.c_str(),O_WRONLY|O_CREAT|O_TRUNC,0644);
+      if (fd < 0)
+        throw std::runtime_error("could not open file '"+fileName+"'");
+#endif
+      if (writeInBackground)
+        background.reset(new BackgroundWriter(this,buffer.size(),maxQueuedBuffers));
+    }
+    
+    FileWriter::~FileWriter()
+    {
+      try { close(); } catch (...) {}
+    }
+
+    void FileWriter::writeSlow(const void *src, size_t numBytes)
+    {
+      if (background) {
+        // the background thread writes whole buffers, so large writes
+        // get split up into those, too
+        const uint8_t *ptr = (const uint8_t *)src;
+        while (numBytes > 0) {
+          const size_t numCopied = std::min(numBytes,buffer.size()-bufferPos);
+          memcpy(buffer.data()+bufferPos,ptr,numCopied);
+          bufferPos += numCopied;
+          ptr       += numCopied;
+          numBytes  -= numCopied;
+          if (bufferPos == buffer.size())
+            flush();
+        }
+        return;
+      }
+      
+      flush();
+      if (numBytes >= buffer.size()) {
+        writeToFile(filePos,src,numBytes);
+        filePos += numBytes;
+      } else {
+        memcpy(buffer.data(),src,numBytes);
+        bufferPos = numBytes;
+      }
+    }
+
+    void FileWriter::writeAt(size_t offset, const void *src, size_t numBytes)
+    {
+      if (offset+numBytes > tell())
+        throw std::runtime_error("FileWriter::writeAt() past the end of what was written");
+      if (background && offset < filePos) {
+        // make sure the background thread won't overwrite this later on
+        flush();
+        background->waitIdle();
+      }
+      if (offset < filePos) {
+        // (part of it) already is in the file
+        const size_t inFile = std::min(numBytes,filePos-offset);
+        writeToFile(offset,src,inFile);
+        offset   += inFile;
+        src       = (const uint8_t *)src+inFile;
+        numBytes -= inFile;
+      }
+      if (numBytes)
+        memcpy(buffer.data()+(offset-filePos),src,numBytes);
+    }
+    
+    void FileWriter::flush()
+    {
+      if (bufferPos == 0) return;
+      if (background)
+        background->push(filePos,buffer,bufferPos);
+      else
+        writeToFile(filePos,buffer.data(),bufferPos);
+      filePos  += bufferPos;
+      bufferPos = 0;
+    }
+
+    void FileWriter::close()
+    {
+#ifdef _WIN32
+      if (!fileHandle) return;
+#else
+      if (fd < 0) return;
+#endif
+      std::exception_ptr error;
+      try {
+        flush();
+        if (background) background->waitIdle();
+      } catch (...) {
+        error = std::current_exception();
+      }
+      if (background) {
+        background->stop();
+        background.reset();
+      }
+      try {
+        closeFile();
+      } catch (...) {
+        if (!error) error = std::current_exception();
+      }
+      if (error)
+        std::rethrow_exception(error);
+    }
+    
+#ifdef _WIN32
+    void FileWriter::writeToFile(size_t offset, const void *src, size_t numBytes)
+    {
+      if (!fileHandle)
+        throw std::runtime_error("write to closed file '"+fileName+"'");
+      const uint8_t *ptr = (const uint8_t *)src;
+      while (numBytes > 0) {
+        OVERLAPPED ov = {};
+        ov.Offset     = (DWORD)(offset & 0xffffffffull);
+        ov.OffsetHigh = (DWORD)(offset >> 32);
+        DWORD numWritten = 0;
+        DWORD toWrite    = (DWORD)std::min(numBytes,size_t(1<<30));
+        if (!WriteFile((HANDLE)fileHandle,ptr,toWrite,&numWritten,&ov) || numWritten == 0)
+          throw std::runtime_error("error writing to file '"+fileName+"'");
+        ptr      += numWritten;
+        offset   += numWritten;
+        numBytes -= numWritten;
+      }
+    }
+
+    void FileWriter::closeFile()
+    {
+      const bool ok = CloseHandle((HANDLE)fileHandle);
+      fileHandle = nullptr;
+      if (!ok)
+        throw std::runtime_error("error closing file '"+fileName+"'");
+    }
+#else
+    void FileWriter::writeToFile(size_t offset, const void *src, size_t numBytes)
+    {
+      if (fd < 0)
+        throw std::runtime_error("write to closed file '"+fileName+"'");
+      const uint8_t *ptr = (const uint8_t *)src;
+      while (numBytes > 0) {
+        ssize_t numWritten = ::pwrite(fd,ptr,std::min(numBytes,size_t(1<<30)),(off_t)offset);
+        if (numWritten <= 0)
+          throw std::runtime_error("error writing to file '"+fileName+"'");
+        ptr      += numWritten;
+        offset   += numWritten;
+        numBytes -= numWritten;
+      }
+    }
+
+    void FileWriter::closeFile()
+    {
+      const int rc = ::close(fd);
+      fd = -1;
+      if (rc != 0)
+        throw std::runtime_error("error closing file '"+fileName+"'");
+    }
+#endif
+    
+  } // ::mini::io
+} // ::mini
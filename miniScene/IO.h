@@ -19,6 +19,7 @@
 #include "miniScene/common.h"
 // std
 #include <fstream>
+#include <streambuf>
 
 namespace mini {
     namespace io {
@@ -128,5 +129,344 @@ namespace mini {
         return s;
       }
 
+      /*! common base class for all non-std::istream readers (CRTP
+          style, to avoid virtual calls per element); each 'Derived'
+          has to provide a read(void*,size_t) method, and then gets
+          the same readElement()/readVector() interface as a
+          std::istream */
+      template<typename Derived>
+      struct Reader {
+        inline Derived &self() { return *static_cast<Derived*>(this); }
+      };
+      
+      template<typename Derived, typename T>
+      inline void readElement(Reader<Derived> &in, T &t)
+      { in.self().read(&t,sizeof(t)); }
+
+      template<typename T, typename Derived>
+      inline T readElement(Reader<Derived> &in)
+      {
+        T t;
+        in.self().read(&t,sizeof(t));
+        return t;
+      }
+
+      template<typename Derived, typename T>
+      inline void readArray(Reader<Derived> &in, T *t, size_t N)
+      { in.self().read(t,N*sizeof(T)); }
+
+      template<typename Derived, typename T>
+      inline void readVector(Reader<Derived> &in,
+                             std::vector<T> &t,
+                             const std::string &/*description*/="<no description>")
+      {
+        size_t N;
+        readElement(in,N);
+        t.resize(N);
+        if (safe_to_copy_binary<T>())
+          in.self().read((void*)t.data(),N*sizeof(t[0]));
+        else
+          for (size_t i=0;i<N;i++)
+            readElement(in,t[i]);
+      }
+      
+      /*! a reader that reads sequentially from a given range of
+          memory */
+      struct MemoryReader : public Reader<MemoryReader> {
+        MemoryReader(const uint8_t *begin, const uint8_t *end)
+          : begin(begin), ptr(begin), end(end)
+        {}
+
+        inline void read(void *dst, size_t numBytes)
+        {
+          if (numBytes > size_t(end-ptr))
+            throw std::runtime_error("partial read");
+          memcpy(dst,ptr,numBytes);
+          ptr += numBytes;
+        }
+        
+        inline void skip(size_t numBytes)
+        {
+          if (numBytes > size_t(end-ptr))
+            throw std::runtime_error("partial read");
+          ptr += numBytes;
+        }
+        
+        /*! current read position, relative to the beginning */
+        inline size_t tell() const { return size_t(ptr-begin); }
+        
+        const uint8_t *const begin;
+        const uint8_t       *ptr;
+        const uint8_t *const end;
+      };
+
+      /*! a std::streambuf that reads from a given range of memory;
+          allows for handing in-memory data to code that can only read
+          from a std::istream */
+      struct MemoryStreamBuf : public std::streambuf {
+        MemoryStreamBuf(const uint8_t *begin, const uint8_t *end)
+        { setg((char*)begin,(char*)begin,(char*)end); }
+        
+      protected:
+        pos_type seekoff(off_type ofs,
+                         std::ios_base::seekdir dir,
+                         std::ios_base::openmode /*which*/) override
+        {
+          char *pos
+            = (dir == std::ios_base::beg) ? eback()+ofs
+            : (dir == std::ios_base::cur) ? gptr()+ofs
+            : egptr()+ofs;
+          if (pos < eback() || pos > egptr())
+            return pos_type(off_type(-1));
+          setg(eback(),pos,egptr());
+          return pos_type(off_type(pos-eback()));
+        }
+        
+        pos_type seekpos(pos_type pos,
+                         std::ios_base::openmode /*which*/) override
+        { return seekoff(off_type(pos),std::ios_base::beg,std::ios_base::in); }
+      };
+      
+      // ==================================================================
+      // random-access (positional) file reading
+      // ==================================================================
+
+      /*! a read-only file that allows for reading at arbitrary
+          offsets (pread() on posix), without any shared file
+          position; ie, multiple threads can concurrently read
+          different parts of the same file */
+      struct RandomAccessFile {
+        typedef std::shared_ptr<RandomAccessFile> SP;
+
+        /*! opens the file of given name; throws a std::runtime_error
+            if the file could not be opened */
+        static SP open(const std::string &fileName)
+        { return std::make_shared<RandomAccessFile>(fileName); }
+        
+        RandomAccessFile(const std::string &fileName);
+        ~RandomAccessFile();
+
+        /*! reads exactly numBytes bytes starting at given offset;
+            throws if that is not possible */
+        void readAt(size_t offset, void *dst, size_t numBytes) const;
+        
+        inline size_t size() const { return numBytes; }
+        
+      private:
+        size_t numBytes = 0;
+#ifdef _WIN32
+        void  *fileHandle = nullptr;
+#else
+        int    fd         = -1;
+#endif
+      };
+
+      /*! a reader that reads sequentially from a RandomAccessFile,
+          starting at a given offset; small reads get served from a
+          (lazily allocated) read-ahead buffer, large ones go straight
+          into the destination. Each thread should use its own
+          FileReader, but any number of those can read from the same
+          file */
+      struct FileReader : public Reader<FileReader> {
+        FileReader(RandomAccessFile::SP file,
+                   size_t offset,
+                   size_t bufferSize=64*1024)
+          : file(file), filePos(offset), bufferSize(bufferSize)
+        {}
+
+        inline void read(void *_dst, size_t numBytes)
+        {
+          uint8_t *dst = (uint8_t*)_dst;
+          size_t inBuffer = buffer.size()-bufferPos;
+          if (numBytes <= inBuffer) {
+            memcpy(dst,buffer.data()+bufferPos,numBytes);
+            bufferPos += numBytes;
+            return;
+          }
+          memcpy(dst,buffer.data()+bufferPos,inBuffer);
+          dst      += inBuffer;
+          numBytes -= inBuffer;
+          buffer.clear();
+          bufferPos = 0;
+          if (numBytes >= bufferSize) {
+            file->readAt(filePos,dst,numBytes);
+            filePos += numBytes;
+            return;
+          }
+          size_t numRead = std::min(bufferSize,file->size()-std::min(filePos,file->size()));
+          if (numRead < numBytes)
+            throw std::runtime_error("partial read");
+          buffer.resize(numRead);
+          file->readAt(filePos,buffer.data(),numRead);
+          filePos += numRead;
+          memcpy(dst,buffer.data(),numBytes);
+          bufferPos = numBytes;
+        }
+
+        inline void skip(size_t numBytes)
+        {
+          size_t inBuffer = buffer.size()-bufferPos;
+          if (numBytes <= inBuffer) {
+            bufferPos += numBytes;
+            return;
+          }
+          numBytes -= inBuffer;
+          buffer.clear();
+          bufferPos = 0;
+          if (numBytes > file->size()-std::min(filePos,file->size()))
+            throw std::runtime_error("partial read");
+          filePos += numBytes;
+        }
+        
+        /*! current read position, in bytes from the start of the file */
+        inline size_t tell() const { return filePos-(buffer.size()-bufferPos); }
+        
+        RandomAccessFile::SP const file;
+      private:
+        /*! file position of the first byte _after_ the buffer */
+        size_t               filePos;
+        const size_t         bufferSize;
+        std::vector<uint8_t> buffer;
+        size_t               bufferPos = 0;
+      };
+      
+      // ==================================================================
+      // buffered file writing
+      // ==================================================================
+
+      /*! common base class for all non-std::ostream writers (CRTP
+          style, same as Reader); each 'Derived' has to provide a
+          write(const void*,size_t) method */
+      template<typename Derived>
+      struct Writer {
+        inline Derived &self() { return *static_cast<Derived*>(this); }
+      };
+      
+      template<typename Derived, typename T>
+      inline void writeElement(Writer<Derived> &out, const T &t)
+      { out.self().write(&t,sizeof(t)); }
+
+      template<typename Derived, typename T>
+      inline void writeArray(Writer<Derived> &out, const T *t, size_t N)
+      {
+        if (safe_to_copy_binary<T>())
+          out.self().write(t,N*sizeof(T));
+        else
+          for (size_t i=0;i<N;i++)
+            writeElement(out,t[i]);
+      }
+
+      template<typename Derived, typename T>
+      inline void writeVector(Writer<Derived> &out, const std::vector<T> &vt)
+      {
+        size_t N = vt.size();
+        writeElement(out,N);
+        writeArray(out,vt.data(),N);
+      }
+      
+      /*! a writer that appends everything to a std::vector<uint8_t>;
+          e.g., for encoding some data in parallel before it gets
+          written to a file in order */
+      struct VectorWriter : public Writer<VectorWriter> {
+        VectorWriter(std::vector<uint8_t> &bytes) : bytes(bytes) {}
+        
+        inline void write(const void *src, size_t numBytes)
+        { bytes.insert(bytes.end(),(const uint8_t*)src,(const uint8_t*)src+numBytes); }
+        
+        inline size_t tell() const { return bytes.size(); }
+        
+        std::vector<uint8_t> &bytes;
+      };
+      
+      /*! a write-only file that gets written through a large
+          user-space buffer: small writes only get copied into the
+          buffer, and the file only sees one large write every
+          'bufferSize' bytes (writes that are larger than the buffer
+          go straight to the file). Throws a std::runtime_error if
+          anything goes wrong.
+
+          If 'writeInBackground' is set, full buffers do not get
+          written by the calling thread, but get handed to a
+          background thread (through a queue of at most
+          'maxQueuedBuffers' buffers, after which the caller has to
+          wait), so producing the data and writing it to disk
+          overlap; in that mode, errors that happen on the writer
+          thread get re-thrown by the next flush() or close() */
+      struct FileWriter : public Writer<FileWriter> {
+        FileWriter(const std::string &fileName,
+                   size_t bufferSize=4<<20,
+                   bool writeInBackground=false,
+                   int maxQueuedBuffers=4);
+        /*! closes the file (if not done already), but - as it cannot
+            throw - silently ignores any errors; call close() to
+            check those */
+        ~FileWriter();
+
+        inline void write(const void *src, size_t numBytes)
+        {
+          if (numBytes <= buffer.size()-bufferPos) {
+            memcpy(buffer.data()+bufferPos,src,numBytes);
+            bufferPos += numBytes;
+            return;
+          }
+          writeSlow(src,numBytes);
+        }
+
+        /*! (over-)writes some already written bytes, starting at given
+            file offset (e.g., for patching in a count that wasn't
+            known when writing it) */
+        void writeAt(size_t offset, const void *src, size_t numBytes);
+        
+        /*! number of bytes written so far */
+        inline size_t tell() const { return filePos+bufferPos; }
+
+        /*! writes out whatever is still in the buffer */
+        void flush();
+        
+        /*! flushes and closes the file */
+        void close();
+        
+      private:
+        struct BackgroundWriter;
+        
+        void writeSlow(const void *src, size_t numBytes);
+        void writeToFile(size_t offset, const void *src, size_t numBytes);
+        void closeFile();
+        
+        const std::string    fileName;
+        std::unique_ptr<BackgroundWriter> background;
+        std::vector<uint8_t> buffer;
+        size_t               bufferPos = 0;
+        /*! file position of the first byte in the buffer */
+        size_t               filePos   = 0;
+#ifdef _WIN32
+        void  *fileHandle = nullptr;
+#else
+        int    fd         = -1;
+#endif
+      };
+
+      /*! a std::streambuf that forwards everything written to it to a
+          FileWriter; allows for handing a FileWriter to code that can
+          only write to a std::ostream */
+      struct FileWriterStreamBuf : public std::streambuf {
+        FileWriterStreamBuf(FileWriter &writer) : writer(writer) {}
+        
+      protected:
+        std::streamsize xsputn(const char *s, std::streamsize n) override
+        { writer.write(s,(size_t)n); return n; }
+        
+        int_type overflow(int_type c) override
+        {
+          if (traits_type::eq_int_type(c,traits_type::eof()))
+            return traits_type::not_eof(c);
+          const char ch = traits_type::to_char_type(c);
+          writer.write(&ch,1);
+          return c;
+        }
+        
+        FileWriter &writer;
+      };
+      
     } // ::mini::io
 } // ::mini
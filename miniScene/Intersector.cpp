@@ -0,0 +1,466 @@
+// ======================================================================== //
+// Copyright 2018-2020 Ingo Wald                                            //
+//                                                                          //
+// Licensed under the Apache License, Version 2.0 (the "License");          //
+// you may not use this file except in compliance with the License.         //
+// You may obtain a copy of the License at                                  //
+//                                                                          //
+//     http://www.apache.org/licenses/LICENSE-2.0                           //
+//                                                                          //
+// Unless required by applicable law or agreed to in writing, software      //
+// distributed under the License is distributed on an "AS IS" BASIS,        //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. //
+// See the License for the specific language governing permissions and      //
+// limitations under the License.                                           //
+// ======================================================================== //
+
+#include "miniScene/Intersector.h"
+#include "miniScene/Serialized.h"
+#include <algorithm>
+
+namespace mini {
+
+  /*! a packet of N rays, in SoA layout, such that the per-lane loops
+      below can get vectorized by the compiler */
+  template<int N>
+  struct RayPacket {
+    float org[3][N];
+    float dir[3][N];
+    float rcpDir[3][N];
+    float tMin[N];
+    float tMax[N];
+    /*! lanes that are not active (padding lanes, rays that are
+        already known to be occluded) get ignored; 0 or 1 (int, rather
+        than bool, so lane loops vectorize) */
+    int   active[N];
+
+    inline bool anyActive() const
+    {
+      int any = 0;
+      for (int i=0;i<N;i++) any |= active[i];
+      return any;
+    }
+    
+    /*! reciprocal of a direction component; avoiding infinities
+        (and 0*inf=NaN's in the slab test) for axis-parallel rays */
+    static inline float safeRcp(float d)
+    { return 1.f/(fabsf(d) > 1e-20f ? d : (d < 0.f ? -1e-20f : 1e-20f)); }
+    
+    inline void set(int i, const vec3f &o, const vec3f &d)
+    {
+      org[0][i] = o.x; org[1][i] = o.y; org[2][i] = o.z;
+      dir[0][i] = d.x; dir[1][i] = d.y; dir[2][i] = d.z;
+      for (int a=0;a<3;a++)
+        rcpDir[a][i] = safeRcp(dir[a][i]);
+    }
+
+    /*! sets this packet to the given one, transformed by the given
+        affine transform (which does not change the rays' t's) */
+    inline void setTransformed(const RayPacket &rays, const affine3f &xfm)
+    {
+      const linear3f &l = xfm.l;
+      for (int i=0;i<N;i++) {
+        const float ox = rays.org[0][i], oy = rays.org[1][i], oz = rays.org[2][i];
+        const float dx = rays.dir[0][i], dy = rays.dir[1][i], dz = rays.dir[2][i];
+        org[0][i] = l.vx.x*ox + l.vy.x*oy + l.vz.x*oz + xfm.p.x;
+        org[1][i] = l.vx.y*ox + l.vy.y*oy + l.vz.y*oz + xfm.p.y;
+        org[2][i] = l.vx.z*ox + l.vy.z*oy + l.vz.z*oz + xfm.p.z;
+        dir[0][i] = l.vx.x*dx + l.vy.x*dy + l.vz.x*dz;
+        dir[1][i] = l.vx.y*dx + l.vy.y*dy + l.vz.y*dz;
+        dir[2][i] = l.vx.z*dx + l.vy.z*dy + l.vz.z*dz;
+        rcpDir[0][i] = safeRcp(dir[0][i]);
+        rcpDir[1][i] = safeRcp(dir[1][i]);
+        rcpDir[2][i] = safeRcp(dir[2][i]);
+        tMin[i]   = rays.tMin[i];
+        tMax[i]   = rays.tMax[i];
+        active[i] = rays.active[i];
+      }
+    }
+  };
+
+  template<int N>
+  struct HitPacket {
+    float u[N], v[N];
+    int   instID[N], meshID[N], primID[N];
+  };
+
+  struct Intersector::Impl {
+    /*! per-object traversal data */
+    struct ObjectData {
+      const BVH *bvh = nullptr;
+      std::vector<const Mesh *> meshes;
+      /*! primBegin[meshID] is the ID (in the object's BVH) of that
+          mesh's first triangle; with one additional entry for the
+          total number of triangles */
+      std::vector<size_t> primBegin;
+    };
+    /*! per-instance traversal data */
+    struct InstanceData {
+      affine3f          worldToObject;
+      const ObjectData *object = nullptr;
+    };
+    /*! traversal stack; spills into a vector for (rare) very deep
+        BVHs */
+    struct Stack {
+      enum { SIZE = 64 };
+      inline bool empty() const { return top == 0 && overflow.empty(); }
+      inline void push(uint32_t nodeID)
+      {
+        if (top < SIZE) entries[top++] = nodeID;
+        else overflow.push_back(nodeID);
+      }
+      inline uint32_t pop()
+      {
+        if (!overflow.empty()) {
+          uint32_t nodeID = overflow.back();
+          overflow.pop_back();
+          return nodeID;
+        }
+        return entries[--top];
+      }
+      uint32_t entries[SIZE];
+      int      top = 0;
+      std::vector<uint32_t> overflow;
+    };
+    
+    Impl(Scene::SP scene, const BVH::BuildConfig &config);
+
+    /*! tests all active lanes of the packet against the given box;
+        returns whether any lane hit it, and (in tNear) the smallest
+        entry distance of all lanes that did */
+    template<int N>
+    static inline bool intersectBox(const RayPacket<N> &rays,
+                                    const box3f &box,
+                                    float &tNear)
+    {
+      float laneNear[N];
+      int   laneHit[N];
+      for (int i=0;i<N;i++) {
+        const float tLoX = (box.lower.x-rays.org[0][i])*rays.rcpDir[0][i];
+        const float tHiX = (box.upper.x-rays.org[0][i])*rays.rcpDir[0][i];
+        const float tLoY = (box.lower.y-rays.org[1][i])*rays.rcpDir[1][i];
+        const float tHiY = (box.upper.y-rays.org[1][i])*rays.rcpDir[1][i];
+        const float tLoZ = (box.lower.z-rays.org[2][i])*rays.rcpDir[2][i];
+        const float tHiZ = (box.upper.z-rays.org[2][i])*rays.rcpDir[2][i];
+        const float t0
+          = std::max(std::max(rays.tMin[i],std::min(tLoX,tHiX)),
+                     std::max(std::min(tLoY,tHiY),std::min(tLoZ,tHiZ)));
+        const float t1
+          = std::min(std::min(rays.tMax[i],std::max(tLoX,tHiX)),
+                     std::min(std::max(tLoY,tHiY),std::max(tLoZ,tHiZ)));
+        laneHit[i]  = rays.active[i] & (t0 <= t1);
+        laneNear[i] = laneHit[i] ? t0 : std::numeric_limits<float>::infinity();
+      }
+      int anyHit = 0;
+      tNear = std::numeric_limits<float>::infinity();
+      for (int i=0;i<N;i++) {
+        anyHit |= laneHit[i];
+        tNear = std::min(tNear,laneNear[i]);
+      }
+      return anyHit != 0;
+    }
+
+    /*! traverses the given BVH with the given packet (front to back,
+        ordered by the packet's closest entry distance into the two
+        children), calling 'leaf(begin,count)' for every leaf any
+        active lane hits. Terminates once no lane is active any
+        more */
+    template<int N, typename Leaf>
+    static inline void traverse(const BVH &bvh,
+                                RayPacket<N> &rays,
+                                const Leaf &leaf)
+    {
+      if (bvh.nodes.empty()) return;
+      float tRoot;
+      if (!intersectBox(rays,bvh.nodes[0].bounds,tRoot)) return;
+      
+      Stack stack;
+      uint32_t nodeID = 0;
+      while (true) {
+        const BVH::Node &node = bvh.nodes[nodeID];
+        if (node.isLeaf()) {
+          leaf(node.offset,node.count);
+          if (!rays.anyActive()) return;
+        } else {
+          float tNear0, tNear1;
+          const bool hit0 = intersectBox(rays,bvh.nodes[node.offset+0].bounds,tNear0);
+          const bool hit1 = intersectBox(rays,bvh.nodes[node.offset+1].bounds,tNear1);
+          if (hit0 && hit1) {
+            if (tNear0 <= tNear1) {
+              stack.push(node.offset+1);
+              nodeID = node.offset+0;
+            } else {
+              stack.push(node.offset+0);
+              nodeID = node.offset+1;
+            }
+            continue;
+          }
+          if (hit0) { nodeID = node.offset+0; continue; }
+          if (hit1) { nodeID = node.offset+1; continue; }
+        }
+        if (stack.empty()) return;
+        nodeID = stack.pop();
+      }
+    }
+
+    /*! intersects all active lanes with one triangle (Moeller-Trumbore);
+        for ANY_HIT, lanes that hit get deactivated, otherwise the
+        hits get recorded and tMax shortened */
+    template<int N, bool ANY_HIT>
+    static inline void intersectTriangle(RayPacket<N> &rays,
+                                         HitPacket<N> &hits,
+                                         const vec3f &v0,
+                                         const vec3f &v1,
+                                         const vec3f &v2,
+                                         int meshID, int primID)
+    {
+      const vec3f e1 = v1-v0;
+      const vec3f e2 = v2-v0;
+      // (branch-free over the lanes, so this vectorizes)
+      for (int i=0;i<N;i++) {
+        const float dx = rays.dir[0][i], dy = rays.dir[1][i], dz = rays.dir[2][i];
+        const float sx = rays.org[0][i]-v0.x;
+        const float sy = rays.org[1][i]-v0.y;
+        const float sz = rays.org[2][i]-v0.z;
+        // p = cross(dir,e2), q = cross(s,e1)
+        const float px = dy*e2.z-dz*e2.y;
+        const float py = dz*e2.x-dx*e2.z;
+        const float pz = dx*e2.y-dy*e2.x;
+        const float qx = sy*e1.z-sz*e1.y;
+        const float qy = sz*e1.x-sx*e1.z;
+        const float qz = sx*e1.y-sy*e1.x;
+        const float det = e1.x*px+e1.y*py+e1.z*pz;
+        // (for det==0 this yields inf's or NaN's, which fail the
+        // tests below)
+        const float rcpDet = 1.f/det;
+        const float u = (sx*px+sy*py+sz*pz)*rcpDet;
+        const float v = (dx*qx+dy*qy+dz*qz)*rcpDet;
+        const float t = (e2.x*qx+e2.y*qy+e2.z*qz)*rcpDet;
+        const int hit
+          = rays.active[i]
+          & (u >= 0.f) & (v >= 0.f) & (u+v <= 1.f)
+          & (t >= rays.tMin[i]) & (t < rays.tMax[i]);
+        if (ANY_HIT) {
+          rays.active[i] = rays.active[i] & (1-hit);
+        } else {
+          // (instID gets set by the caller)
+          rays.tMax[i]   = hit ? t      : rays.tMax[i];
+          hits.u[i]      = hit ? u      : hits.u[i];
+          hits.v[i]      = hit ? v      : hits.v[i];
+          hits.meshID[i] = hit ? meshID : hits.meshID[i];
+          hits.primID[i] = hit ? primID : hits.primID[i];
+        }
+      }
+    }
+
+    /*! traces one packet through the two-level BVH */
+    template<int N, bool ANY_HIT>
+    void trace(RayPacket<N> &rays, HitPacket<N> &hits) const
+    {
+      if (!bvh) return;
+      traverse
+        (*bvh,rays,
+         [&](uint32_t begin, uint32_t count) {
+           for (uint32_t i=begin;i<begin+count;i++) {
+             const int instID = (int)bvh->primIDs[i];
+             const InstanceData &inst = instances[instID];
+             const ObjectData &object = *inst.object;
+             
+             // transform the packet into the object's space; this
+             // keeps t's the same
+             RayPacket<N> objectRays;
+             objectRays.setTransformed(rays,inst.worldToObject);
+             
+             traverse
+               (*object.bvh,objectRays,
+                [&](uint32_t primBegin, uint32_t primCount) {
+                  for (uint32_t j=primBegin;j<primBegin+primCount;j++) {
+                    const size_t globalPrimID = object.bvh->primIDs[j];
+                    const int meshID
+                      = int(std::upper_bound(object.primBegin.begin(),
+                                             object.primBegin.end(),
+                                             globalPrimID)
+                            - object.primBegin.begin()) - 1;
+                    const Mesh *mesh = object.meshes[meshID];
+                    const int primID = int(globalPrimID-object.primBegin[meshID]);
+                    const vec3i idx = mesh->getTriangle(primID);
+                    intersectTriangle<N,ANY_HIT>
+                      (objectRays,hits,
+                       mesh->getVertex(idx.x),
+                       mesh->getVertex(idx.y),
+                       mesh->getVertex(idx.z),
+                       meshID,primID);
+                  }
+                });
+
+             for (int l=0;l<N;l++) {
+               if (ANY_HIT) {
+                 rays.active[l] = objectRays.active[l];
+               } else {
+                 const bool closer = objectRays.tMax[l] < rays.tMax[l];
+                 rays.tMax[l]   = closer ? objectRays.tMax[l] : rays.tMax[l];
+                 hits.instID[l] = closer ? instID : hits.instID[l];
+               }
+             }
+             if (!rays.anyActive()) return;
+           }
+         });
+    }
+
+    /*! traces rays[begin..end) (with end-begin <= N) as one packet */
+    template<int N, bool ANY_HIT>
+    void tracePacket(const Ray *rays, size_t count,
+                     RayPacket<N> &packet, HitPacket<N> &hits) const
+    {
+      for (int l=0;l<N;l++) {
+        if (l < (int)count) {
+          packet.set(l,rays[l].origin,rays[l].direction);
+          packet.tMin[l]   = rays[l].tMin;
+          packet.tMax[l]   = rays[l].tMax;
+          packet.active[l] = 1;
+        } else {
+          packet.set(l,vec3f(0.f),vec3f(1.f));
+          packet.tMin[l]   = 0.f;
+          packet.tMax[l]   = 0.f;
+          packet.active[l] = 0;
+        }
+        hits.instID[l] = hits.meshID[l] = hits.primID[l] = -1;
+        hits.u[l] = hits.v[l] = 0.f;
+      }
+      trace<N,ANY_HIT>(packet,hits);
+    }
+    
+    Scene::SP                 scene;
+    const BVH                *bvh = nullptr;
+    std::vector<ObjectData>   objects;
+    std::vector<InstanceData> instances;
+  };
+
+  Intersector::Impl::Impl(Scene::SP scene, const BVH::BuildConfig &config)
+    : scene(scene)
+  {
+    scene->buildBVHs(false,config);
+    bvh = scene->bvh.get();
+
+    SerializedScene serialized(scene.get());
+    objects.resize(serialized.objects.size());
+    parallel_for
+      (serialized.meshes.size(),
+       [&](size_t meshID) { serialized.meshes[(int)meshID]->getArrays(); });
+    parallel_for
+      (objects.size(),
+       [&](size_t objID) {
+         const Object::SP &object = serialized.objects[(int)objID];
+         ObjectData &data = objects[objID];
+         data.bvh = object->bvh.get();
+         for (size_t meshID=0;meshID<object->meshes.size();meshID++) {
+           const Mesh::SP &mesh = object->meshes[meshID];
+           data.meshes.push_back(mesh ? &mesh->getArrays() : nullptr);
+           data.primBegin.push_back(object->getPrimOffset(meshID));
+         }
+         data.primBegin.push_back(object->getPrimOffset(object->meshes.size()));
+       });
+
+    instances.resize(scene->instances.size());
+    parallel_for_blocked
+      (0,instances.size(),1024,
+       [&](size_t begin, size_t end) {
+         for (size_t i=begin;i<end;i++) {
+           const Instance::SP &inst = scene->instances[i];
+           if (!inst || !inst->object) continue;
+           instances[i].worldToObject = rcp(inst->xfm);
+           instances[i].object = &objects[serialized.objects.getID(inst->object)];
+         }
+       });
+  }
+  
+  Intersector::Intersector(Scene::SP scene, const BVH::BuildConfig &config)
+    : impl(new Impl(scene,config))
+  {}
+
+  Intersector::~Intersector()
+  {}
+  
+  Intersector::SP Intersector::create(Scene::SP scene,
+                                      const BVH::BuildConfig &config)
+  {
+    return std::make_shared<Intersector>(scene,config);
+  }
+  
+  Hit Intersector::intersect(const Ray &ray) const
+  {
+    RayPacket<1> packet;
+    HitPacket<1> hits;
+    impl->tracePacket<1,false>(&ray,1,packet,hits);
+    Hit hit;
+    if (hits.instID[0] >= 0) {
+      hit.t      = packet.tMax[0];
+      hit.u      = hits.u[0];
+      hit.v      = hits.v[0];
+      hit.instID = hits.instID[0];
+      hit.meshID = hits.meshID[0];
+      hit.primID = hits.primID[0];
+    }
+    return hit;
+  }
+
+  bool Intersector::occluded(const Ray &ray) const
+  {
+    RayPacket<1> packet;
+    HitPacket<1> hits;
+    impl->tracePacket<1,true>(&ray,1,packet,hits);
+    return !packet.active[0];
+  }
+
+  void Intersector::intersect(const std::vector<Ray> &rays,
+                              std::vector<Hit> &hits) const
+  {
+    const int N = PACKET_SIZE;
+    hits.resize(rays.size());
+    const size_t numPackets = (rays.size()+N-1)/N;
+    parallel_for_blocked
+      (0,numPackets,64,
+       [&](size_t begin, size_t end) {
+         RayPacket<N> packet;
+         HitPacket<N> packetHits;
+         for (size_t packetID=begin;packetID<end;packetID++) {
+           const size_t first = packetID*N;
+           const size_t count = std::min(size_t(N),rays.size()-first);
+           impl->tracePacket<N,false>(rays.data()+first,count,packet,packetHits);
+           for (size_t l=0;l<count;l++) {
+             Hit &hit = hits[first+l];
+             hit = Hit();
+             if (packetHits.instID[l] < 0) continue;
+             hit.t      = packet.tMax[l];
+             hit.u      = packetHits.u[l];
+             hit.v      = packetHits.v[l];
+             hit.instID = packetHits.instID[l];
+             hit.meshID = packetHits.meshID[l];
+             hit.primID = packetHits.primID[l];
+           }
+         }
+       });
+  }
+    
+  void Intersector::occluded(const std::vector<Ray> &rays,
+                             std::vector<uint8_t> &occluded) const
+  {
+    const int N = PACKET_SIZE;
+    occluded.resize(rays.size());
+    const size_t numPackets = (rays.size()+N-1)/N;
+    parallel_for_blocked
+      (0,numPackets,64,
+       [&](size_t begin, size_t end) {
+         RayPacket<N> packet;
+         HitPacket<N> packetHits;
+         for (size_t packetID=begin;packetID<end;packetID++) {
+           const size_t first = packetID*N;
+           const size_t count = std::min(size_t(N),rays.size()-first);
+           impl->tracePacket<N,true>(rays.data()+first,count,packet,packetHits);
+           for (size_t l=0;l<count;l++)
+             occluded[first+l] = !packet.active[l];
+         }
+       });
+  }
+  
+} // ::mini
@@ -0,0 +1,104 @@
+// ======================================================================== //
+// Copyright 2018-2020 Ingo Wald                                            //
+//                                                                          //
+// Licensed under the Apache License, Version 2.0 (the "License");          //
+// you may not use this file except in compliance with the License.         //
+// You may obtain a copy of the License at                                  //
+//                                                                          //
+//     http://www.apache.org/licenses/LICENSE-2.0                           //
+//                                                                          //
+// Unless required by applicable law or agreed to in writing, software      //
+// distributed under the License is distributed on an "AS IS" BASIS,        //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. //
+// See the License for the specific language governing permissions and      //
+// limitations under the License.                                           //
+// ======================================================================== //
+
+#pragma once
+
+#include "miniScene/Scene.h"
+
+namespace mini {
+
+  /*! a ray, for Intersector; the ray's valid interval is
+      [tMin,tMax), in units of 'direction' (which does not have to be
+      normalized) */
+  struct Ray {
+    Ray() = default;
+    Ray(const vec3f &origin, const vec3f &direction,
+        float tMin = 0.f,
+        float tMax = std::numeric_limits<float>::infinity())
+      : origin(origin), direction(direction), tMin(tMin), tMax(tMax)
+    {}
+    
+    vec3f origin;
+    vec3f direction;
+    float tMin = 0.f;
+    float tMax = std::numeric_limits<float>::infinity();
+  };
+
+  /*! result of Intersector::intersect() */
+  struct Hit {
+    inline bool hadHit() const { return instID >= 0; }
+
+    /*! distance along the ray, in units of the ray's direction */
+    float t = std::numeric_limits<float>::infinity();
+    /*! barycentric coordinates of the hit point: the hit point is
+        (1-u-v)*vertex[idx.x] + u*vertex[idx.y] + v*vertex[idx.z] */
+    float u = 0.f, v = 0.f;
+    /*! index of the instance (in the scene's 'instances'), mesh (in
+        that instance's object's 'meshes'), and triangle (in that
+        mesh) that got hit; all -1 if nothing got hit */
+    int   instID = -1;
+    int   meshID = -1;
+    int   primID = -1;
+  };
+  
+  /*! a simple, multi-threaded ray-intersection engine for CPU-side
+      (pre-)processing on a mini::Scene: a two-level BVH - the
+      scene's BVH over all instances, and each object's BVH over its
+      triangles (see Scene::buildBVHs()) - traversed either one ray at
+      a time, or in packets of rays (for the batch queries, which
+      trace coherent groups of rays - e.g., neighboring primary rays -
+      through the BVHs together) */
+  struct Intersector {
+    typedef std::shared_ptr<Intersector> SP;
+
+    /*! creates an intersector for the given scene: builds all
+        missing object BVHs and (re-)builds the scene's instance BVH
+        (storing those in the scene), and makes sure lazily loaded
+        meshes are resident (shared copies that aren't resident get
+        read through their source; see Mesh::getArrays()). The scene must not change while the
+        intersector is in use */
+    static SP create(Scene::SP scene,
+                     const BVH::BuildConfig &config = BVH::BuildConfig());
+
+    Intersector(Scene::SP scene, const BVH::BuildConfig &config);
+    ~Intersector();
+    
+    /*! finds the closest hit along the ray */
+    Hit  intersect(const Ray &ray) const;
+
+    /*! returns whether anything is hit along the ray */
+    bool occluded(const Ray &ray) const;
+
+    /*! finds the closest hit for each of the given rays, in parallel
+        and in packets of consecutive rays */
+    void intersect(const std::vector<Ray> &rays,
+                   std::vector<Hit> &hits) const;
+    
+    /*! determines for each of the given rays whether it is occluded
+        (1) or not (0), in parallel and in packets of consecutive
+        rays */
+    void occluded(const std::vector<Ray> &rays,
+                  std::vector<uint8_t> &occluded) const;
+
+    /*! number of rays traced together in the batch queries */
+    enum { PACKET_SIZE = 8 };
+    
+  private:
+    struct Impl;
+    std::unique_ptr<Impl> impl;
+  };
+  
+} // ::mini
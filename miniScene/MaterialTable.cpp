@@ -0,0 +1,263 @@
+// ======================================================================== //
+// Copyright 2018-2020 Ingo Wald                                            //
+//                                                                          //
+// Licensed under the Apache License, Version 2.0 (the "License");          //
+// you may not use this file except in compliance with the License.         //
+// You may obtain a copy of the License at                                  //
+//                                                                          //
+//     http://www.apache.org/licenses/LICENSE-2.0                           //
+//                                                                          //
+// Unless required by applicable law or agreed to in writing, software      //
+// distributed under the License is distributed on an "AS IS" BASIS,        //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. //
+// See the License for the specific language governing permissions and      //
+// limitations under the License.                                           //
+// ======================================================================== //
+
+#include "miniScene/MaterialTable.h"
+#include "miniScene/Serialized.h"
+
+namespace mini {
+
+  inline void pack(float out[3], const vec3f &v)
+  { out[0] = v.x; out[1] = v.y; out[2] = v.z; }
+
+  inline vec3f unpack(const float in[3])
+  { return vec3f(in[0],in[1],in[2]); }
+  
+  /*! material visitor that packs a material into 'result' */
+  struct MaterialPacker {
+    int textureID(const Texture::SP &texture) const
+    {
+      if (!texture) return -1;
+      const int ID = textures.getID(texture);
+      if (ID < 0)
+        throw std::runtime_error("material refers to a texture that is "
+                                 "not in the list of textures to pack with");
+      return ID;
+    }
+    
+    void operator()(const DisneyMaterial &mat) const
+    {
+      packed::DisneyMaterial &out = result.disney;
+      pack(out.emission,mat.emission);
+      pack(out.baseColor,mat.baseColor);
+      out.metallic     = mat.metallic;
+      out.roughness    = mat.roughness;
+      out.transmission = mat.transmission;
+      out.ior          = mat.ior;
+      out.colorTexture = textureID(mat.colorTexture);
+      out.alphaTexture = textureID(mat.alphaTexture);
+    }
+    void operator()(const BlenderMaterial &mat) const
+    {
+      packed::BlenderMaterial &out = result.blender;
+      pack(out.baseColor,mat.baseColor);
+      out.roughness             = mat.roughness;
+      out.metallic              = mat.metallic;
+      out.specular              = mat.specular;
+      out.specularTint          = mat.specularTint;
+      out.transmission          = mat.transmission;
+      out.transmissionRoughness = mat.transmissionRoughness;
+      out.ior                   = mat.ior;
+      out.alpha                 = mat.alpha;
+      pack(out.subsurfaceRadius,mat.subsurfaceRadius);
+      pack(out.subsurfaceColor,mat.subsurfaceColor);
+      out.subsurface            = mat.subsurface;
+      out.anisotropic           = mat.anisotropic;
+      out.anisotropicRotation   = mat.anisotropicRotation;
+      out.sheen                 = mat.sheen;
+      out.sheenTint             = mat.sheenTint;
+      out.clearcoat             = mat.clearcoat;
+      out.clearcoatRoughness    = mat.clearcoatRoughness;
+      out.baseColorTexture      = textureID(mat.baseColorTexture);
+      out.alphaTexture          = textureID(mat.alphaTexture);
+    }
+    void operator()(const Plastic &mat) const
+    {
+      pack(result.plastic.Ks,mat.Ks);
+      result.plastic.eta = mat.eta;
+      pack(result.plastic.pigmentColor,mat.pigmentColor);
+      result.plastic.roughness = mat.roughness;
+    }
+    void operator()(const Metal &mat) const
+    {
+      pack(result.metal.eta,mat.eta);
+      pack(result.metal.k,mat.k);
+      result.metal.roughness = mat.roughness;
+    }
+    void operator()(const Velvet &mat) const
+    {
+      pack(result.velvet.reflectance,mat.reflectance);
+      pack(result.velvet.horizonScatteringColor,mat.horizonScatteringColor);
+      result.velvet.horizonScatteringFallOff = mat.horizonScatteringFallOff;
+      result.velvet.backScattering = mat.backScattering;
+    }
+    void operator()(const Dielectric &mat) const
+    {
+      result.dielectric.etaInside  = mat.etaInside;
+      result.dielectric.etaOutside = mat.etaOutside;
+      pack(result.dielectric.transmission,mat.transmission);
+    }
+    void operator()(const ThinGlass &mat) const
+    {
+      result.thinGlass.eta       = mat.eta;
+      result.thinGlass.thickness = mat.thickness;
+      pack(result.thinGlass.transmission,mat.transmission);
+    }
+    void operator()(const MetallicPaint &mat) const
+    {
+      result.metallicPaint.eta = mat.eta;
+      pack(result.metallicPaint.glitterColor,mat.glitterColor);
+      result.metallicPaint.glitterSpread = mat.glitterSpread;
+      pack(result.metallicPaint.shadeColor,mat.shadeColor);
+    }
+    void operator()(const Matte &mat) const
+    {
+      pack(result.matte.reflectance,mat.reflectance);
+    }
+    void operator()(const Material &mat) const
+    {
+      throw std::runtime_error("cannot pack material of un-supported type "
+                               +mat.toString());
+    }
+
+    const Serialized<Texture::SP> &textures;
+    PackedMaterial                &result;
+  };
+  
+  std::vector<PackedMaterial>
+  packMaterials(const std::vector<Material::SP> &materials,
+                const std::vector<Texture::SP> &textures)
+  {
+    Serialized<Texture::SP> textureIDs;
+    for (auto &texture : textures)
+      if (texture) textureIDs.add(texture);
+    if (textureIDs.size() != textures.size())
+      throw std::runtime_error("packMaterials: list of textures contains "
+                               "null or duplicate textures");
+    
+    std::vector<PackedMaterial> result(materials.size());
+    parallel_for_blocked
+      (0,materials.size(),1024,
+       [&](size_t begin, size_t end) {
+         for (size_t i=begin;i<end;i++) {
+           PackedMaterial &packed = result[i];
+           memset(&packed,0,sizeof(packed));
+           packed.type = (int32_t)materials[i]->getType();
+           visitMaterial<void>(*materials[i],MaterialPacker{textureIDs,packed});
+         }
+       });
+    return result;
+  }
+
+  std::vector<PackedMaterial> packMaterials(const FlatScene &scene)
+  {
+    return packMaterials(scene.materials,scene.textures);
+  }
+
+  Material::SP unpackMaterial(const PackedMaterial &packed,
+                              const std::vector<Texture::SP> &textures)
+  {
+    auto texture = [&](int32_t ID) -> Texture::SP {
+      if (ID < 0) return {};
+      if (ID >= (int)textures.size())
+        throw std::runtime_error("invalid texture ID in packed material");
+      return textures[ID];
+    };
+    
+    switch (packed.type) {
+    case Material::DISNEY: {
+      const packed::DisneyMaterial &in = packed.disney;
+      DisneyMaterial::SP mat = DisneyMaterial::create();
+      mat->emission     = unpack(in.emission);
+      mat->baseColor    = unpack(in.baseColor);
+      mat->metallic     = in.metallic;
+      mat->roughness    = in.roughness;
+      mat->transmission = in.transmission;
+      mat->ior          = in.ior;
+      mat->colorTexture = texture(in.colorTexture);
+      mat->alphaTexture = texture(in.alphaTexture);
+      return mat;
+    }
+    case Material::BLENDER: {
+      const packed::BlenderMaterial &in = packed.blender;
+      BlenderMaterial::SP mat = BlenderMaterial::create();
+      mat->baseColor             = unpack(in.baseColor);
+      mat->roughness             = in.roughness;
+      mat->metallic              = in.metallic;
+      mat->specular              = in.specular;
+      mat->specularTint          = in.specularTint;
+      mat->transmission          = in.transmission;
+      mat->transmissionRoughness = in.transmissionRoughness;
+      mat->ior                   = in.ior;
+      mat->alpha                 = in.alpha;
+      mat->subsurfaceRadius      = unpack(in.subsurfaceRadius);
+      mat->subsurfaceColor       = unpack(in.subsurfaceColor);
+      mat->subsurface            = in.subsurface;
+      mat->anisotropic           = in.anisotropic;
+      mat->anisotropicRotation   = in.anisotropicRotation;
+      mat->sheen                 = in.sheen;
+      mat->sheenTint             = in.sheenTint;
+      mat->clearcoat             = in.clearcoat;
+      mat->clearcoatRoughness    = in.clearcoatRoughness;
+      mat->baseColorTexture      = texture(in.baseColorTexture);
+      mat->alphaTexture          = texture(in.alphaTexture);
+      return mat;
+    }
+    case Material::PLASTIC: {
+      Plastic::SP mat = Plastic::create();
+      mat->Ks           = unpack(packed.plastic.Ks);
+      mat->eta          = packed.plastic.eta;
+      mat->pigmentColor = unpack(packed.plastic.pigmentColor);
+      mat->roughness    = packed.plastic.roughness;
+      return mat;
+    }
+    case Material::METAL: {
+      Metal::SP mat = Metal::create();
+      mat->eta       = unpack(packed.metal.eta);
+      mat->k         = unpack(packed.metal.k);
+      mat->roughness = packed.metal.roughness;
+      return mat;
+    }
+    case Material::VELVET: {
+      Velvet::SP mat = Velvet::create();
+      mat->reflectance              = unpack(packed.velvet.reflectance);
+      mat->horizonScatteringColor   = unpack(packed.velvet.horizonScatteringColor);
+      mat->horizonScatteringFallOff = packed.velvet.horizonScatteringFallOff;
+      mat->backScattering           = packed.velvet.backScattering;
+      return mat;
+    }
+    case Material::DIELECTRIC: {
+      Dielectric::SP mat = Dielectric::create();
+      mat->etaInside    = packed.dielectric.etaInside;
+      mat->etaOutside   = packed.dielectric.etaOutside;
+      mat->transmission = unpack(packed.dielectric.transmission);
+      return mat;
+    }
+    case Material::THINGLASS: {
+      ThinGlass::SP mat = ThinGlass::create();
+      mat->eta          = packed.thinGlass.eta;
+      mat->thickness    = packed.thinGlass.thickness;
+      mat->transmission = unpack(packed.thinGlass.transmission);
+      return mat;
+    }
+    case Material::METALLICPAINT: {
+      MetallicPaint::SP mat = MetallicPaint::create();
+      mat->eta           = packed.metallicPaint.eta;
+      mat->glitterColor  = unpack(packed.metallicPaint.glitterColor);
+      mat->glitterSpread = packed.metallicPaint.glitterSpread;
+      mat->shadeColor    = unpack(packed.metallicPaint.shadeColor);
+      return mat;
+    }
+    case Material::MATTE: {
+      Matte::SP mat = Matte::create();
+      mat->reflectance = unpack(packed.matte.reflectance);
+      return mat;
+    }
+    }
+    throw std::runtime_error("invalid packed material type "
+                             +std::to_string(packed.type));
+  }
+  
+} // ::mini
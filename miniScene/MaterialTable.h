@@ -0,0 +1,147 @@
+// ======================================================================== //
+// Copyright 2018-2020 Ingo Wald                                            //
+//                                                                          //
+// Licensed under the Apache License, Version 2.0 (the "License");          //
+// you may not use this file except in compliance with the License.         //
+// You may obtain a copy of the License at                                  //
+//                                                                          //
+//     http://www.apache.org/licenses/LICENSE-2.0                           //
+//                                                                          //
+// Unless required by applicable law or agreed to in writing, software      //
+// distributed under the License is distributed on an "AS IS" BASIS,        //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. //
+// See the License for the specific language governing permissions and      //
+// limitations under the License.                                           //
+// ======================================================================== //
+
+#pragma once
+
+#include "miniScene/FlatScene.h"
+
+namespace mini {
+
+  /*! plain-old-data versions of the different material types' data,
+      for use in a PackedMaterial; all vectors are stored as float[3]
+      (without padding), and textures as indices into a list of
+      textures (-1 for none) */
+  namespace packed {
+    struct DisneyMaterial {
+      float   emission[3];
+      float   baseColor[3];
+      float   metallic;
+      float   roughness;
+      float   transmission;
+      float   ior;
+      int32_t colorTexture;
+      int32_t alphaTexture;
+    };
+    struct BlenderMaterial {
+      float   baseColor[3];
+      float   roughness;
+      float   metallic;
+      float   specular;
+      float   specularTint;
+      float   transmission;
+      float   transmissionRoughness;
+      float   ior;
+      float   alpha;
+      float   subsurfaceRadius[3];
+      float   subsurfaceColor[3];
+      float   subsurface;
+      float   anisotropic;
+      float   anisotropicRotation;
+      float   sheen;
+      float   sheenTint;
+      float   clearcoat;
+      float   clearcoatRoughness;
+      int32_t baseColorTexture;
+      int32_t alphaTexture;
+    };
+    struct Plastic {
+      float Ks[3];
+      float eta;
+      float pigmentColor[3];
+      float roughness;
+    };
+    struct Metal {
+      float eta[3];
+      float k[3];
+      float roughness;
+    };
+    struct Velvet {
+      float reflectance[3];
+      float horizonScatteringColor[3];
+      float horizonScatteringFallOff;
+      float backScattering;
+    };
+    struct Dielectric {
+      float etaInside;
+      float etaOutside;
+      float transmission[3];
+    };
+    struct ThinGlass {
+      float eta;
+      float thickness;
+      float transmission[3];
+    };
+    struct MetallicPaint {
+      float eta;
+      float glitterColor[3];
+      float glitterSpread;
+      float shadeColor[3];
+    };
+    struct Matte {
+      float reflectance[3];
+    };
+  }
+  
+  /*! a material of any type as a fixed-size, 16-byte aligned POD
+      struct: a type tag plus a union of the different types' data,
+      with textures referred to by index. An array of these can get
+      uploaded to a GPU as is, and a renderer can switch over 'type'
+      to tell which of the union's members is valid */
+  struct alignas(16) PackedMaterial {
+    /*! a Material::Type */
+    int32_t type;
+    int32_t padding[3];
+    union {
+      packed::DisneyMaterial  disney;
+      packed::BlenderMaterial blender;
+      packed::Plastic         plastic;
+      packed::Metal           metal;
+      packed::Velvet          velvet;
+      packed::Dielectric      dielectric;
+      packed::ThinGlass       thinGlass;
+      packed::MetallicPaint   metallicPaint;
+      packed::Matte           matte;
+    };
+  };
+  static_assert(sizeof(PackedMaterial) % 16 == 0,
+                "PackedMaterial should be a multiple of 16 bytes");
+
+  /*! packs the given materials, in that order; texture references
+      become indices into 'textures' (which has to contain all
+      non-null textures the materials use) */
+  std::vector<PackedMaterial>
+  packMaterials(const std::vector<Material::SP> &materials,
+                const std::vector<Texture::SP> &textures);
+
+  /*! packs the given flat scene's materials; entry #i is
+      scene.materials[i], and textures are indices into
+      scene.textures */
+  std::vector<PackedMaterial> packMaterials(const FlatScene &scene);
+
+  /*! creates a (new) material from a packed one, the inverse of
+      packMaterials() */
+  Material::SP unpackMaterial(const PackedMaterial &packed,
+                              const std::vector<Texture::SP> &textures);
+
+  /*! reads the material table stored in a (version 21+) .mini file
+      that got saved with SaveOptions::storeMaterialTable, without
+      reading (or parsing) anything else; returns an empty table for
+      files that don't have one. Entries and texture indices are in
+      the same order as the materials and textures of the FlatScene
+      that FlatScene::load() reads from that file */
+  std::vector<PackedMaterial> loadMaterialTable(const std::string &fileName);
+  
+} // ::mini
@@ -0,0 +1,295 @@
+// ======================================================================== //
+// Copyright 2018-2020 Ingo Wald                                            //
+//                                                                          //
+// Licensed under the Apache License, Version 2.0 (the "License");          //
+// you may not use this file except in compliance with the License.         //
+// You may obtain a copy of the License at                                  //
+//                                                                          //
+//     http://www.apache.org/licenses/LICENSE-2.0                           //
+//                                                                          //
+// Unless required by applicable law or agreed to in writing, software      //
+// distributed under the License is distributed on an "AS IS" BASIS,        //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. //
+// See the License for the specific language governing permissions and      //
+// limitations under the License.                                           //
+// ======================================================================== //
+
+#include "miniScene/Meshlets.h"
+#include "miniScene/Morton.h"
+#include "miniScene/Scene.h"
+#include "miniScene/Serialized.h"
+#include <algorithm>
+
+namespace mini {
+
+  /*! builds meshlets greedily: each meshlet grows, triangle by
+      triangle, by the not-yet-used triangle adjacent to it that adds
+      the fewest new vertices (ties broken by distance to the
+      meshlet's centroid) - looking at the neighbors of the most
+      recently added triangle first, and of all of the meshlet's
+      vertices only if those are all used. New meshlets (and meshlets
+      whose neighborhood is used up) continue at the next unused
+      triangle in Morton order of the triangles' centroids */
+  struct MeshletBuilder {
+    enum { NOT_IN_MESHLET = 0xffff };
+    
+    MeshletBuilder(const Mesh &mesh, const Meshlets::BuildConfig &config)
+      : mesh(mesh), config(config),
+        numPrims(mesh.getNumPrims()),
+        numVertices(mesh.getNumVertices())
+    {
+      if (config.maxVertices < 3 || config.maxVertices > 256)
+        throw std::runtime_error("invalid meshlet config: maxVertices has to be in [3,256]");
+      if (config.maxTriangles < 1 || config.maxTriangles > 0xffff)
+        throw std::runtime_error("invalid meshlet config: maxTriangles has to be in [1,65535]");
+    }
+
+    inline vec3f centroidOf(uint32_t primID) const
+    {
+      const vec3i idx = mesh.getTriangle(primID);
+      return (mesh.getVertex(idx.x)+mesh.getVertex(idx.y)+mesh.getVertex(idx.z))
+        * (1.f/3.f);
+    }
+
+    /*! number of vertices of the given triangle that are not yet in
+        the current meshlet */
+    inline int newVerticesOf(uint32_t primID) const
+    {
+      const vec3i idx = mesh.getTriangle(primID);
+      return
+        (localID[idx.x] == NOT_IN_MESHLET) +
+        (localID[idx.y] == NOT_IN_MESHLET && idx.y != idx.x) +
+        (localID[idx.z] == NOT_IN_MESHLET && idx.z != idx.x && idx.z != idx.y);
+    }
+
+    void computeAdjacency()
+    {
+      adjBegin.assign(numVertices+1,0);
+      for (size_t i=0;i<numPrims;i++) {
+        const vec3i idx = mesh.getTriangle(i);
+        adjBegin[idx.x+1]++;
+        adjBegin[idx.y+1]++;
+        adjBegin[idx.z+1]++;
+      }
+      for (size_t i=0;i<numVertices;i++)
+        adjBegin[i+1] += adjBegin[i];
+      adjPrims.resize(adjBegin[numVertices]);
+      std::vector<uint32_t> fill(adjBegin.begin(),adjBegin.end()-1);
+      for (size_t i=0;i<numPrims;i++) {
+        const vec3i idx = mesh.getTriangle(i);
+        adjPrims[fill[idx.x]++] = (uint32_t)i;
+        adjPrims[fill[idx.y]++] = (uint32_t)i;
+        adjPrims[fill[idx.z]++] = (uint32_t)i;
+      }
+    }
+
+    void computeMortonOrder()
+    {
+      box3f centBounds;
+      for (size_t i=0;i<numPrims;i++)
+        centBounds.extend(centroidOf((uint32_t)i));
+      const vec3f scale = rcp(max(centBounds.size(),vec3f(1e-20f)));
+      std::vector<uint64_t> keys(numPrims);
+      for (size_t i=0;i<numPrims;i++) {
+        const uint32_t code
+          = mortonCode((centroidOf((uint32_t)i)-centBounds.lower)*scale);
+        keys[i] = (uint64_t(code) << 32) | i;
+      }
+      radixSortUpper32(keys);
+      order.resize(numPrims);
+      for (size_t i=0;i<numPrims;i++)
+        order[i] = (uint32_t)keys[i];
+    }
+
+    /*! considers all unused triangles adjacent to the given vertex
+        as candidates for the current meshlet */
+    inline void considerNeighborsOf(uint32_t vertexID,
+                                    int &bestPrim, int &bestNew,
+                                    float &bestDist) const
+    {
+      for (uint32_t i=adjBegin[vertexID];i<adjBegin[vertexID+1];i++) {
+        const uint32_t primID = adjPrims[i];
+        if (used[primID]) continue;
+        const int numNew = newVerticesOf(primID);
+        if (numNew > bestNew) continue;
+        const vec3f d = centroidOf(primID)-centroidSum*(1.f/current.size());
+        const float dist = dot(d,d);
+        if (numNew < bestNew || dist < bestDist) {
+          bestPrim = (int)primID;
+          bestNew  = numNew;
+          bestDist = dist;
+        }
+      }
+    }
+
+    /*! the best triangle to add to the (non-empty) current meshlet
+        next; -1 if no unused triangle is adjacent to it */
+    int bestCandidate(uint32_t lastPrim) const
+    {
+      int   bestPrim = -1;
+      int   bestNew  = 4;
+      float bestDist = std::numeric_limits<float>::infinity();
+      const vec3i idx = mesh.getTriangle(lastPrim);
+      considerNeighborsOf(idx.x,bestPrim,bestNew,bestDist);
+      considerNeighborsOf(idx.y,bestPrim,bestNew,bestDist);
+      considerNeighborsOf(idx.z,bestPrim,bestNew,bestDist);
+      if (bestPrim < 0)
+        for (auto vertexID : currentVertices)
+          considerNeighborsOf(vertexID,bestPrim,bestNew,bestDist);
+      return bestPrim;
+    }
+
+    inline uint8_t addVertex(uint32_t vertexID)
+    {
+      if (localID[vertexID] == NOT_IN_MESHLET) {
+        localID[vertexID] = (uint16_t)currentVertices.size();
+        currentVertices.push_back(vertexID);
+      }
+      return (uint8_t)localID[vertexID];
+    }
+    
+    void add(uint32_t primID)
+    {
+      const vec3i idx = mesh.getTriangle(primID);
+      currentTriangles.push_back(addVertex(idx.x));
+      currentTriangles.push_back(addVertex(idx.y));
+      currentTriangles.push_back(addVertex(idx.z));
+      current.push_back(primID);
+      centroidSum = centroidSum + centroidOf(primID);
+      used[primID] = true;
+    }
+
+    /*! computes bounds and normal cone of the current meshlet, and
+        appends it to 'result' */
+    void flush()
+    {
+      if (current.empty()) return;
+      Meshlets::Meshlet meshlet;
+      meshlet.vertexBegin   = (uint32_t)result->vertices.size();
+      meshlet.triangleBegin = (uint32_t)(result->triangles.size()/3);
+      meshlet.numVertices   = (uint16_t)currentVertices.size();
+      meshlet.numTriangles  = (uint16_t)current.size();
+      for (auto vertexID : currentVertices)
+        meshlet.bounds.extend(mesh.getVertex(vertexID));
+
+      // normal cone (after meshoptimizer's meshopt_computeMeshletBounds)
+      std::vector<vec3f> normals;
+      std::vector<vec3f> anchors;
+      vec3f normalSum(0.f);
+      for (auto primID : current) {
+        const vec3i idx = mesh.getTriangle(primID);
+        const vec3f v0 = mesh.getVertex(idx.x);
+        const vec3f N = cross(mesh.getVertex(idx.y)-v0,mesh.getVertex(idx.z)-v0);
+        const float lenN = length(N);
+        if (lenN == 0.f) continue;
+        normals.push_back(N*(1.f/lenN));
+        anchors.push_back(v0);
+        normalSum = normalSum + normals.back();
+      }
+      const vec3f center = meshlet.bounds.center();
+      const float lenSum = length(normalSum);
+      meshlet.coneAxis   = lenSum > 0.f ? normalSum*(1.f/lenSum) : vec3f(0.f,0.f,1.f);
+      meshlet.coneApex   = center;
+      meshlet.coneCutoff = 1.f;
+      float minDot = 1.f;
+      for (auto &N : normals)
+        minDot = std::min(minDot,dot(N,meshlet.coneAxis));
+      if (!normals.empty() && lenSum > 0.f && minDot > .1f) {
+        float maxT = 0.f;
+        for (size_t i=0;i<normals.size();i++)
+          maxT = std::max(maxT,
+                          dot(center-anchors[i],normals[i])
+                          /dot(meshlet.coneAxis,normals[i]));
+        meshlet.coneApex   = center-maxT*meshlet.coneAxis;
+        meshlet.coneCutoff = sqrtf(1.f-minDot*minDot);
+      }
+      
+      result->meshlets.push_back(meshlet);
+      result->vertices.insert(result->vertices.end(),
+                              currentVertices.begin(),currentVertices.end());
+      result->triangles.insert(result->triangles.end(),
+                               currentTriangles.begin(),currentTriangles.end());
+      for (auto vertexID : currentVertices)
+        localID[vertexID] = NOT_IN_MESHLET;
+      currentVertices.clear();
+      currentTriangles.clear();
+      current.clear();
+      centroidSum = vec3f(0.f);
+    }
+    
+    Meshlets::SP build()
+    {
+      result = std::make_shared<Meshlets>();
+      if (numPrims == 0) return result;
+      computeAdjacency();
+      computeMortonOrder();
+      used.assign(numPrims,false);
+      localID.assign(numVertices,NOT_IN_MESHLET);
+
+      size_t nextInOrder = 0;
+      int lastPrim = -1;
+      while (true) {
+        int primID = lastPrim < 0 ? -1 : bestCandidate(lastPrim);
+        if (primID < 0) {
+          while (nextInOrder < numPrims && used[order[nextInOrder]])
+            nextInOrder++;
+          if (nextInOrder == numPrims) break;
+          primID = order[nextInOrder];
+        }
+        if (current.size() == (size_t)config.maxTriangles
+            || currentVertices.size()+newVerticesOf(primID) > (size_t)config.maxVertices)
+          flush();
+        add(primID);
+        lastPrim = primID;
+      }
+      flush();
+      return result;
+    }
+    
+    const Mesh                       &mesh;
+    const Meshlets::BuildConfig       config;
+    const size_t                      numPrims;
+    const size_t                      numVertices;
+    /*! the triangles adjacent to vertex #i are
+        adjPrims[adjBegin[i]..adjBegin[i+1]) */
+    std::vector<uint32_t>             adjBegin;
+    std::vector<uint32_t>             adjPrims;
+    /*! all triangles, in Morton order */
+    std::vector<uint32_t>             order;
+    std::vector<bool>                 used;
+    /*! index of each vertex in the current meshlet, or
+        NOT_IN_MESHLET */
+    std::vector<uint16_t>             localID;
+    
+    /*! the meshlet currently being built */
+    std::vector<uint32_t>             current;
+    std::vector<uint32_t>             currentVertices;
+    std::vector<uint8_t>              currentTriangles;
+    vec3f                             centroidSum { 0.f };
+    
+    Meshlets::SP                      result;
+  };
+  
+  Meshlets::SP Meshlets::build(const Mesh &mesh, const BuildConfig &config)
+  {
+    return MeshletBuilder(mesh,config).build();
+  }
+  
+  void Mesh::buildMeshlets(const Meshlets::BuildConfig &config)
+  {
+    meshlets = Meshlets::build(getArrays(),config);
+  }
+  
+  void Scene::buildMeshlets(bool rebuild, const Meshlets::BuildConfig &config)
+  {
+    SerializedScene serialized(this);
+    parallel_for
+      (serialized.meshes.size(),
+       [&](size_t meshID) {
+         const Mesh::SP &mesh = serialized.meshes.list[meshID];
+         if (rebuild || !mesh->meshlets)
+           mesh->buildMeshlets(config);
+       });
+  }
+  
+} // ::mini
@@ -0,0 +1,88 @@
+// ======================================================================== //
+// Copyright 2018-2020 Ingo Wald                                            //
+//                                                                          //
+// Licensed under the Apache License, Version 2.0 (the "License");          //
+// you may not use this file except in compliance with the License.         //
+// You may obtain a copy of the License at                                  //
+//                                                                          //
+//     http://www.apache.org/licenses/LICENSE-2.0                           //
+//                                                                          //
+// Unless required by applicable law or agreed to in writing, software      //
+// distributed under the License is distributed on an "AS IS" BASIS,        //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. //
+// See the License for the specific language governing permissions and      //
+// limitations under the License.                                           //
+// ======================================================================== //
+
+#pragma once
+
+#include "miniScene/common.h"
+
+namespace mini {
+
+  struct Mesh;
+  
+  /*! parameters for building meshlets */
+  struct MeshletBuildConfig {
+    /*! maximum number of (unique) vertices per meshlet; at most 256,
+        since meshlets' triangles use 8-bit local vertex indices */
+    int maxVertices  = 128;
+    /*! maximum number of triangles per meshlet */
+    int maxTriangles = 256;
+  };
+  
+  /*! a partitioning of a mesh's triangles into small, spatially
+      compact clusters ("meshlets"), each with only a few vertices,
+      its own bounding box, and a normal cone, as used by GPU mesh
+      shading pipelines for (cluster-)culling. Meshlets refer to
+      their mesh's vertices through 'vertices', and to those through
+      8-bit local indices in 'triangles' (see getTriangle()); they
+      do not change the mesh itself, but have to be rebuilt whenever
+      its vertices or indices change (see Mesh::buildMeshlets()) */
+  struct Meshlets {
+    typedef std::shared_ptr<Meshlets> SP;
+    typedef MeshletBuildConfig BuildConfig;
+
+    struct Meshlet {
+      /*! this meshlet's vertices are vertices[vertexBegin] up to
+          (excluding) vertices[vertexBegin+numVertices] */
+      uint32_t vertexBegin;
+      /*! this meshlet's triangles are triangles
+          [3*triangleBegin..3*(triangleBegin+numTriangles)) */
+      uint32_t triangleBegin;
+      uint16_t numVertices;
+      uint16_t numTriangles;
+      box3f    bounds;
+      /*! normal cone: none of this meshlet's triangles faces a viewer
+          at 'eye' if dot(normalize(coneApex-eye),coneAxis) >=
+          coneCutoff; coneCutoff is 1 for meshlets whose normals
+          spread too much for that to ever be useful */
+      vec3f    coneApex;
+      vec3f    coneAxis;
+      float    coneCutoff;
+    };
+
+    /*! builds meshlets for the given mesh (which has to be
+        resident), greedily growing each meshlet across triangles that
+        share vertices with it, and starting new meshlets in Morton
+        order of the triangles' centroids */
+    static SP build(const Mesh &mesh, const BuildConfig &config = BuildConfig());
+
+    /*! returns the mesh vertex indices of triangle #triID (relative
+        to the meshlet) of the given meshlet */
+    inline vec3i getTriangle(const Meshlet &meshlet, int triID) const
+    {
+      const uint8_t *local = &triangles[3*(meshlet.triangleBegin+triID)];
+      const uint32_t *vtx  = &vertices[meshlet.vertexBegin];
+      return vec3i(vtx[local[0]],vtx[local[1]],vtx[local[2]]);
+    }
+    
+    std::vector<Meshlet>  meshlets;
+    /*! mesh vertex indices of all meshlets' vertices */
+    std::vector<uint32_t> vertices;
+    /*! three local (ie, relative to the respective meshlet's
+        vertexBegin) vertex indices per triangle */
+    std::vector<uint8_t>  triangles;
+  };
+  
+} // ::mini
@@ -0,0 +1,96 @@
+// ======================================================================== //
+// Copyright 2018-2020 Ingo Wald                                            //
+//                                                                          //
+// Licensed under the Apache License, Version 2.0 (the "License");          //
+// you may not use this file except in compliance with the License.         //
+// You may obtain a copy of the License at                                  //
+//                                                                          //
+//     http://www.apache.org/licenses/LICENSE-2.0                           //
+//                                                                          //
+// Unless required by applicable law or agreed to in writing, software      //
+// distributed under the License is distributed on an "AS IS" BASIS,        //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. //
+// See the License for the specific language governing permissions and      //
+// limitations under the License.                                           //
+// ======================================================================== //
+
+
+#pragma once
+
+#include "miniScene/common.h"
+#include <array>
+#include <vector>
+
+/*! Morton-code helpers for spatially sorting primitives; used by
+    breakMesh() and the meshlet builder */
+
+namespace mini {
+
+  /*! spreads the lower 10 bits of x out to every third bit */
+  inline uint32_t spreadBits(uint32_t x)
+  {
+    x &= 0x3ff;
+    x = (x | (x << 16)) & 0x030000ff;
+    x = (x | (x <<  8)) & 0x0300f00f;
+    x = (x | (x <<  4)) & 0x030c30c3;
+    x = (x | (x <<  2)) & 0x09249249;
+    return x;
+  }
+
+  /*! 30-bit Morton code of a point in [0,1]^3 */
+  inline uint32_t mortonCode(const vec3f &p)
+  {
+    const vec3f cell = min(vec3f(1023.f),max(vec3f(0.f),p*1024.f));
+    return
+      (spreadBits((uint32_t)cell.x) << 2) |
+      (spreadBits((uint32_t)cell.y) << 1) |
+      (spreadBits((uint32_t)cell.z) << 0);
+  }
+
+  /*! sorts the given keys by their upper 32 bits, with a stable,
+      parallel LSD radix sort (8 bits per pass; passes in which all
+      keys have the same digit get skipped) */
+  inline void radixSortUpper32(std::vector<uint64_t> &keys)
+  {
+    const size_t numKeys   = keys.size();
+    const size_t blockSize = 64*1024;
+    const size_t numBlocks = (numKeys+blockSize-1)/blockSize;
+    std::vector<uint64_t> temp(numKeys);
+    std::vector<std::array<size_t,256>> offsets(numBlocks);
+    for (int shift=32;shift<64;shift+=8) {
+      parallel_for
+        (numBlocks,
+         [&](size_t blockID) {
+           std::array<size_t,256> &hist = offsets[blockID];
+           hist.fill(0);
+           const size_t end = std::min(numKeys,(blockID+1)*blockSize);
+           for (size_t i=blockID*blockSize;i<end;i++)
+             hist[(keys[i] >> shift) & 0xff]++;
+         });
+      // turn (per-block) counts into output offsets, digit by digit
+      // and, within each digit, block by block
+      size_t sum = 0;
+      bool   allSame = false;
+      for (int digit=0;digit<256;digit++) {
+        const size_t digitBegin = sum;
+        for (auto &hist : offsets) {
+          const size_t count = hist[digit];
+          hist[digit] = sum;
+          sum += count;
+        }
+        allSame |= (sum-digitBegin == numKeys);
+      }
+      if (allSame) continue;
+      parallel_for
+        (numBlocks,
+         [&](size_t blockID) {
+           std::array<size_t,256> &offset = offsets[blockID];
+           const size_t end = std::min(numKeys,(blockID+1)*blockSize);
+           for (size_t i=blockID*blockSize;i<end;i++)
+             temp[offset[(keys[i] >> shift) & 0xff]++] = keys[i];
+         });
+      keys.swap(temp);
+    }
+  }
+
+} // ::mini
@@ -0,0 +1,296 @@
+// ======================================================================== //
+// Copyright 2018-2020 Ingo Wald                                            //
+//                                                                          //
+// Licensed under the Apache License, Version 2.0 (the "License");          //
+// you may not use this file except in compliance with the License.         //
+// You may obtain a copy of the License at                                  //
+//                                                                          //
+//     http://www.apache.org/licenses/LICENSE-2.0                           //
+//                                                                          //
+// Unless required by applicable law or agreed to in writing, software      //
+// distributed under the License is distributed on an "AS IS" BASIS,        //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. //
+// See the License for the specific language governing permissions and      //
+// limitations under the License.                                           //
+// ======================================================================== //
+
+#include "miniScene/Optimize.h"
+#include "miniScene/Serialized.h"
+#include <algorithm>
+#include <math.h>
+
+namespace mini {
+
+  MeshOrderStats analyzeMeshOrder(const Mesh &meshOrCopy, int cacheSize)
+  {
+    const Mesh &mesh = meshOrCopy.getArrays();
+    MeshOrderStats stats;
+    const size_t numPrims    = mesh.getNumPrims();
+    const size_t numVertices = mesh.getNumVertices();
+    if (numPrims == 0 || numVertices == 0) return stats;
+
+    // FIFO post-transform cache: a vertex is in the cache if fewer
+    // than 'cacheSize' misses happened since it got inserted
+    std::vector<size_t> insertedAt(numVertices,0);
+    size_t numMisses = 0;
+
+    // direct-mapped cache of 64-byte lines for vertex fetches
+    const size_t lineSize = 64, numLines = 256;
+    const size_t stride = mesh.isQuantized() ? sizeof(vec3us) : sizeof(vec3f);
+    std::vector<size_t> lineTags(numLines,size_t(-1));
+    size_t bytesFetched = 0;
+    
+    for (size_t i=0;i<numPrims;i++) {
+      const vec3i idx = mesh.getTriangle(i);
+      for (int k=0;k<3;k++) {
+        const int vertexID = idx[k];
+        if (insertedAt[vertexID] && numMisses+1-insertedAt[vertexID] <= (size_t)cacheSize)
+          continue;
+        insertedAt[vertexID] = ++numMisses;
+        
+        const size_t firstLine = (vertexID*stride)/lineSize;
+        const size_t lastLine  = ((vertexID+1)*stride-1)/lineSize;
+        for (size_t line=firstLine;line<=lastLine;line++) {
+          if (lineTags[line%numLines] == line) continue;
+          lineTags[line%numLines] = line;
+          bytesFetched += lineSize;
+        }
+      }
+    }
+    stats.acmr      = numMisses/double(numPrims);
+    stats.atvr      = numMisses/double(numVertices);
+    stats.overfetch = bytesFetched/double(numVertices*stride);
+    return stats;
+  }
+
+  /*! Tom Forsyth's linear-speed vertex cache optimization: greedily
+      emits the triangle with the highest score, where a triangle's
+      score is the sum of its vertices' scores, which in turn depend
+      on their position in a simulated LRU cache and on how many of
+      their triangles are still to be emitted. Only the scores of
+      triangles that touch the cache change after each step, so the
+      next best triangle is found among those */
+  struct ForsythOptimizer {
+    enum { MAX_CACHE_SIZE = 64, MAX_VALENCE_SCORES = 32 };
+    
+    ForsythOptimizer(const std::vector<vec3i> &triangles,
+                     size_t numVertices,
+                     int cacheSize)
+      : triangles(triangles),
+        numVertices(numVertices),
+        cacheSize(std::max(4,std::min(int(MAX_CACHE_SIZE),cacheSize)))
+    {
+      const float cacheDecayPower   = 1.5f;
+      const float lastTriScore      = .75f;
+      const float valenceBoostScale = 2.f;
+      const float valenceBoostPower = .5f;
+      for (int i=0;i<this->cacheSize;i++)
+        cachePositionScore[i]
+          = (i < 3)
+          ? lastTriScore
+          : powf(1.f-(i-3)/float(this->cacheSize-3),cacheDecayPower);
+      for (int i=0;i<MAX_VALENCE_SCORES;i++)
+        valenceScore[i] = valenceBoostScale*powf(float(std::max(i,1)),-valenceBoostPower);
+    }
+
+    inline float computeVertexScore(uint32_t vertexID) const
+    {
+      const uint32_t numLeft = numActive[vertexID];
+      if (numLeft == 0) return -1.f;
+      const int pos = cachePosition[vertexID];
+      return (pos < 0 ? 0.f : cachePositionScore[pos])
+        + (numLeft < MAX_VALENCE_SCORES
+           ? valenceScore[numLeft]
+           : 2.f*powf(float(numLeft),-.5f));
+    }
+
+    inline float computeTriangleScore(uint32_t primID) const
+    {
+      const vec3i &idx = triangles[primID];
+      return vertexScore[idx.x]+vertexScore[idx.y]+vertexScore[idx.z];
+    }
+
+    /*! removes (one occurrence of) the given triangle from the
+        vertex's list of not-yet-emitted triangles */
+    inline void removeActive(uint32_t vertexID, uint32_t primID)
+    {
+      uint32_t *active = &adjPrims[adjBegin[vertexID]];
+      const uint32_t last = --numActive[vertexID];
+      for (uint32_t i=0;i<=last;i++)
+        if (active[i] == primID) {
+          std::swap(active[i],active[last]);
+          return;
+        }
+    }
+    
+    std::vector<vec3i> run()
+    {
+      const size_t numPrims = triangles.size();
+      std::vector<vec3i> result;
+      result.reserve(numPrims);
+      
+      adjBegin.assign(numVertices+1,0);
+      for (auto &idx : triangles)
+        for (int k=0;k<3;k++)
+          adjBegin[idx[k]+1]++;
+      for (size_t i=0;i<numVertices;i++)
+        adjBegin[i+1] += adjBegin[i];
+      adjPrims.resize(adjBegin[numVertices]);
+      numActive.assign(numVertices,0);
+      for (size_t primID=0;primID<numPrims;primID++)
+        for (int k=0;k<3;k++) {
+          const int vertexID = triangles[primID][k];
+          adjPrims[adjBegin[vertexID]+numActive[vertexID]++] = (uint32_t)primID;
+        }
+      cachePosition.assign(numVertices,-1);
+      vertexScore.resize(numVertices);
+      for (size_t i=0;i<numVertices;i++)
+        vertexScore[i] = computeVertexScore(uint32_t(i));
+      triangleScore.resize(numPrims);
+      std::vector<bool> emitted(numPrims,false);
+
+      int bestPrim = -1;
+      float bestScore = -1.f;
+      for (size_t primID=0;primID<numPrims;primID++) {
+        triangleScore[primID] = computeTriangleScore(uint32_t(primID));
+        if (triangleScore[primID] > bestScore) {
+          bestScore = triangleScore[primID];
+          bestPrim  = (int)primID;
+        }
+      }
+
+      std::vector<uint32_t> cache, newCache;
+      size_t nextUnemitted = 0;
+      while (result.size() < numPrims) {
+        if (bestPrim < 0) {
+          // nothing adjacent to the cache any more - continue with
+          // the first triangle not yet emitted
+          while (emitted[nextUnemitted]) nextUnemitted++;
+          bestPrim = (int)nextUnemitted;
+        }
+        const vec3i idx = triangles[bestPrim];
+        result.push_back(idx);
+        emitted[bestPrim] = true;
+        
+        newCache.clear();
+        for (int k=0;k<3;k++) {
+          removeActive(idx[k],bestPrim);
+          if (std::find(newCache.begin(),newCache.end(),(uint32_t)idx[k]) == newCache.end())
+            newCache.push_back(idx[k]);
+        }
+        const size_t numCorners = newCache.size();
+        for (auto vertexID : cache)
+          if (std::find(newCache.begin(),newCache.begin()+numCorners,vertexID)
+              == newCache.begin()+numCorners)
+            newCache.push_back(vertexID);
+
+        // update the scores of all vertices that are (or just were)
+        // in the cache, and then of their triangles
+        for (size_t i=0;i<newCache.size();i++) {
+          const uint32_t vertexID = newCache[i];
+          cachePosition[vertexID] = (i < (size_t)cacheSize) ? int(i) : -1;
+          vertexScore[vertexID] = computeVertexScore(vertexID);
+        }
+        bestPrim  = -1;
+        bestScore = -1.f;
+        for (auto vertexID : newCache) {
+          for (uint32_t i=0;i<numActive[vertexID];i++) {
+            const uint32_t primID = adjPrims[adjBegin[vertexID]+i];
+            triangleScore[primID] = computeTriangleScore(primID);
+            if (triangleScore[primID] > bestScore) {
+              bestScore = triangleScore[primID];
+              bestPrim  = (int)primID;
+            }
+          }
+        }
+        if (newCache.size() > (size_t)cacheSize)
+          newCache.resize(cacheSize);
+        cache.swap(newCache);
+      }
+      return result;
+    }
+
+    const std::vector<vec3i> &triangles;
+    const size_t              numVertices;
+    const int                 cacheSize;
+    float                     cachePositionScore[MAX_CACHE_SIZE];
+    float                     valenceScore[MAX_VALENCE_SCORES];
+    /*! the triangles of vertex #i are adjPrims[adjBegin[i]..); the
+        first numActive[i] of those are the ones not yet emitted */
+    std::vector<uint32_t>     adjBegin;
+    std::vector<uint32_t>     adjPrims;
+    std::vector<uint32_t>     numActive;
+    std::vector<int>          cachePosition;
+    std::vector<float>        vertexScore;
+    std::vector<float>        triangleScore;
+  };
+  
+  void optimizeVertexCache(Mesh &mesh, int cacheSize)
+  {
+    mesh.ensureLoaded();
+    const bool narrow = !mesh.indices16.empty();
+    mesh.widenIndices();
+    mesh.indices
+      = ForsythOptimizer(mesh.indices,mesh.getNumVertices(),cacheSize).run();
+    if (narrow) mesh.narrowIndices();
+  }
+
+  /*! reorders the elements of 'v' such that element i moves to
+      position newID[i] */
+  template<typename T>
+  void permute(std::vector<T> &v, const std::vector<uint32_t> &newID)
+  {
+    if (v.empty()) return;
+    std::vector<T> permuted(v.size());
+    for (size_t i=0;i<v.size();i++)
+      permuted[newID[i]] = v[i];
+    v.swap(permuted);
+  }
+  
+  void optimizeVertexFetch(Mesh &mesh)
+  {
+    mesh.ensureLoaded();
+    const bool narrow = !mesh.indices16.empty();
+    mesh.widenIndices();
+    
+    const size_t numVertices = mesh.getNumVertices();
+    const uint32_t unused = uint32_t(-1);
+    std::vector<uint32_t> newID(numVertices,unused);
+    uint32_t numUsed = 0;
+    for (auto &idx : mesh.indices)
+      for (int k=0;k<3;k++) {
+        if (newID[idx[k]] == unused) newID[idx[k]] = numUsed++;
+        idx[k] = newID[idx[k]];
+      }
+    for (auto &id : newID)
+      if (id == unused) id = numUsed++;
+
+    permute(mesh.vertices,newID);
+    permute(mesh.normals,newID);
+    permute(mesh.texcoords,newID);
+    permute(mesh.quantized.vertices,newID);
+    permute(mesh.quantized.normals,newID);
+    permute(mesh.quantized.texcoords,newID);
+    if (narrow) mesh.narrowIndices();
+    // (meshlets refer to the old vertex IDs)
+    mesh.meshlets.reset();
+  }
+
+  void optimizeMesh(Mesh &mesh)
+  {
+    optimizeVertexCache(mesh);
+    optimizeVertexFetch(mesh);
+  }
+
+  void optimizeMeshes(Scene::SP scene)
+  {
+    SerializedScene serialized(scene.get());
+    parallel_for
+      (serialized.meshes.size(),
+       [&](size_t meshID) { optimizeMesh(*serialized.meshes.list[meshID]); });
+    for (auto &object : serialized.objects.list)
+      object->bvh.reset();
+    scene->bvh.reset();
+  }
+  
+} // ::mini
@@ -0,0 +1,71 @@
+// ======================================================================== //
+// Copyright 2018-2020 Ingo Wald                                            //
+//                                                                          //
+// Licensed under the Apache License, Version 2.0 (the "License");          //
+// you may not use this file except in compliance with the License.         //
+// You may obtain a copy of the License at                                  //
+//                                                                          //
+//     http://www.apache.org/licenses/LICENSE-2.0                           //
+//                                                                          //
+// Unless required by applicable law or agreed to in writing, software      //
+// distributed under the License is distributed on an "AS IS" BASIS,        //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. //
+// See the License for the specific language governing permissions and      //
+// limitations under the License.                                           //
+// ======================================================================== //
+
+#pragma once
+
+#include "miniScene/Scene.h"
+
+namespace mini {
+
+  /*! how well a mesh's triangle and vertex order suit a GPU's
+      vertex processing; see analyzeMeshOrder() */
+  struct MeshOrderStats {
+    /*! average cache miss ratio: simulated post-transform cache
+        misses (ie, vertex shader invocations) per triangle; ranges
+        from about 0.5 (for large regular meshes) to 3 */
+    double acmr = 0.;
+    /*! average transform to vertex ratio: cache misses per vertex;
+        1 is optimal */
+    double atvr = 0.;
+    /*! bytes of vertex positions read from memory (in 64-byte cache
+        lines, through a simulated 16KB direct-mapped cache) per byte
+        of vertex positions; 1 is optimal */
+    double overfetch = 0.;
+  };
+
+  /*! simulates rendering the given mesh - through a FIFO
+      post-transform cache with the given number of entries, and a
+      small memory cache for vertex fetches - and returns the
+      resulting statistics */
+  MeshOrderStats analyzeMeshOrder(const Mesh &mesh, int cacheSize = 16);
+
+  /*! reorders the mesh's triangles for post-transform vertex cache
+      reuse, using Tom Forsyth's "linear-speed vertex cache
+      optimization" (simulating an LRU cache with the given number of
+      entries, which works well for a wide range of actual cache
+      sizes). Since this changes the mesh's triangle IDs, the BVH of
+      any object that contains this mesh is out of date afterwards
+      (see Object::bvh); meshlets stay valid */
+  void optimizeVertexCache(Mesh &mesh, int cacheSize = 32);
+
+  /*! reorders the mesh's vertices (and normals, texcoords, whether
+      quantized or not) in the order in which its triangles first use
+      them, for locality of vertex fetches; vertices no triangle uses
+      go last. Since this changes the mesh's vertex IDs, it drops the
+      mesh's meshlets */
+  void optimizeVertexFetch(Mesh &mesh);
+
+  /*! optimizeVertexCache() followed by optimizeVertexFetch(); ie,
+      drops the mesh's meshlets, and invalidates the BVHs of the
+      objects that contain it */
+  void optimizeMesh(Mesh &mesh);
+
+  /*! optimizes all meshes of the given scene (in parallel; reading
+      lazily loaded meshes), and drops all BVHs and meshlets, which
+      refer to triangle and vertex IDs */
+  void optimizeMeshes(Scene::SP scene);
+  
+} // ::mini
@@ -0,0 +1,145 @@
+// ======================================================================== //
+// Copyright 2018-2020 Ingo Wald                                            //
+//                                                                          //
+// Licensed under the Apache License, Version 2.0 (the "License");          //
+// you may not use this file except in compliance with the License.         //
+// You may obtain a copy of the License at                                  //
+//                                                                          //
+//     http://www.apache.org/licenses/LICENSE-2.0                           //
+//                                                                          //
+// Unless required by applicable law or agreed to in writing, software      //
+// distributed under the License is distributed on an "AS IS" BASIS,        //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. //
+// See the License for the specific language governing permissions and      //
+// limitations under the License.                                           //
+// ======================================================================== //
+
+#pragma once
+
+#include "miniScene/common.h"
+
+/*! encode/decode helpers for compact (lossy) vertex data; see
+    Mesh::quantize() */
+
+namespace mini {
+
+  /*! converts a float to a IEEE 754 half-precision float (round to
+      nearest even; overflows become +/-inf) */
+  inline uint16_t floatToHalf(float f)
+  {
+    uint32_t bits;
+    memcpy(&bits,&f,sizeof(bits));
+    const uint32_t sign = (bits >> 16) & 0x8000;
+    const uint32_t fexp = (bits >> 23) & 0xff;
+    uint32_t mant = bits & 0x7fffff;
+    if (fexp == 0xff)
+      // inf or nan
+      return uint16_t(sign | 0x7c00 | (mant ? 0x200 : 0));
+    const int exp = int(fexp)-127+15;
+    if (exp >= 31)
+      return uint16_t(sign | 0x7c00);
+    if (exp <= 0) {
+      // becomes a denormal (or zero)
+      if (exp < -10)
+        return uint16_t(sign);
+      mant |= 0x800000;
+      const int shift = 14-exp;
+      uint32_t half = mant >> shift;
+      const uint32_t rest    = mant & ((1u << shift)-1);
+      const uint32_t halfway = 1u << (shift-1);
+      if (rest > halfway || (rest == halfway && (half & 1)))
+        half++;
+      return uint16_t(sign | half);
+    }
+    uint32_t half = sign | (uint32_t(exp) << 10) | (mant >> 13);
+    const uint32_t rest = mant & 0x1fff;
+    if (rest > 0x1000 || (rest == 0x1000 && (half & 1)))
+      // (a carry into the exponent is exactly what we want here)
+      half++;
+    return uint16_t(half);
+  }
+
+  /*! converts a IEEE 754 half-precision float to a float */
+  inline float halfToFloat(uint16_t h)
+  {
+    const uint32_t sign = uint32_t(h & 0x8000) << 16;
+    const uint32_t exp  = (h >> 10) & 0x1f;
+    const uint32_t mant = h & 0x3ff;
+    if (exp == 0) {
+      // zero or denormal
+      const float f = mant * (1.f/16777216.f);
+      return sign ? -f : f;
+    }
+    const uint32_t bits
+      = (exp == 31)
+      ? (sign | 0x7f800000 | (mant << 13))
+      : (sign | ((exp-15+127) << 23) | (mant << 13));
+    float f;
+    memcpy(&f,&bits,sizeof(f));
+    return f;
+  }
+
+  inline vec2us encodeHalf2(const vec2f &v)
+  { return vec2us(floatToHalf(v.x),floatToHalf(v.y)); }
+  
+  inline vec2f decodeHalf2(const vec2us &v)
+  { return vec2f(halfToFloat(v.x),halfToFloat(v.y)); }
+
+  /*! encodes a (unit-length) normal into 32 bits, using an
+      octahedral mapping onto two 16-bit snorm values; zero-length
+      normals become (0,0,1) */
+  inline uint32_t encodeOctahedral(const vec3f &n)
+  {
+    const float sum = fabsf(n.x)+fabsf(n.y)+fabsf(n.z);
+    if (!(sum > 0.f))
+      return encodeOctahedral(vec3f(0.f,0.f,1.f));
+    float u = n.x/sum, v = n.y/sum;
+    if (n.z < 0.f) {
+      const float fu = (1.f-fabsf(v))*(u >= 0.f ? 1.f : -1.f);
+      const float fv = (1.f-fabsf(u))*(v >= 0.f ? 1.f : -1.f);
+      u = fu; v = fv;
+    }
+    auto snorm16 = [](float f) {
+      return uint32_t(uint16_t(int16_t(roundf(std::min(std::max(f,-1.f),1.f)*32767.f))));
+    };
+    return snorm16(u) | (snorm16(v) << 16);
+  }
+
+  /*! decodes a normal encoded with encodeOctahedral() */
+  inline vec3f decodeOctahedral(uint32_t code)
+  {
+    float u = std::max(int16_t(code & 0xffff)/32767.f,-1.f);
+    float v = std::max(int16_t(code >> 16)/32767.f,-1.f);
+    const float z = 1.f-fabsf(u)-fabsf(v);
+    if (z < 0.f) {
+      const float fu = (1.f-fabsf(v))*(u >= 0.f ? 1.f : -1.f);
+      const float fv = (1.f-fabsf(u))*(v >= 0.f ? 1.f : -1.f);
+      u = fu; v = fv;
+    }
+    return normalize(vec3f(u,v,z));
+  }
+
+  /*! quantizes a position to 16 bits per coordinate, relative to
+      the given domain (usually, the bounds of the mesh it belongs
+      to) */
+  inline vec3us quantizePosition(const vec3f &p, const box3f &domain)
+  {
+    vec3us q;
+    for (int i=0;i<3;i++) {
+      const float extent = domain.upper[i]-domain.lower[i];
+      const float t = extent > 0.f ? (p[i]-domain.lower[i])/extent : 0.f;
+      q[i] = uint16_t(roundf(std::min(std::max(t,0.f),1.f)*65535.f));
+    }
+    return q;
+  }
+  
+  /*! inverse of quantizePosition() */
+  inline vec3f dequantizePosition(const vec3us &q, const box3f &domain)
+  {
+    vec3f p;
+    for (int i=0;i<3;i++)
+      p[i] = domain.lower[i]+(q[i]*(1.f/65535.f))*(domain.upper[i]-domain.lower[i]);
+    return p;
+  }
+  
+} // ::mini
@@ -16,13 +16,39 @@
 
 #include "miniScene/Scene.h"
 #include "miniScene/Serialized.h"
+#include "miniScene/FlatScene.h"
+#include "miniScene/MaterialTable.h"
 #include "miniScene/IO.h"
 #include <sstream>
+#include <algorithm>
+#include <iterator>
+#include <list>
+#include <unordered_map>
+#include <unordered_set>
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+# define MINI_HAVE_SSE 1
+# include <immintrin.h>
+#endif
 
 namespace mini {
 
-    enum { FORMAT_VERSION = 12 };
+    enum { FORMAT_VERSION = 22 };
   /* VERSION HISTORY
+     22: data blocks of 16-bit data can use the DELTA16_SHUFFLE
+         filter
+     21: (optional) section with a table of packed materials
+     20: (optional) section with per-mesh meshlets
+     19: (optional) section with per-object and instance BVHs
+     18: scene statistics (SceneInfo) at the start of the section
+         offset table
+     17: mesh indices stored with 16 bits where possible
+     16: meshes can be stored quantized (mesh record flag 2)
+     15: mesh arrays and texture data stored as (optionally
+         compressed) data blocks
+     14: per-mesh and per-object bounding boxes in the section offset
+         table
+     13: section offset table (offsets of each texture, mesh, and
+         section) at the end of the file, for parallel loading
      12: embree-style materials, with virtual material read/write
    */
   
@@ -37,72 +63,112 @@ namespace mini {
       necessarily tight, but definitively a boundning box) */
   inline box3f transformedBoxBounds(const affine3f &xfm,
                                     const box3f &box)
+  {
+    return xfmBox(xfm,box);
+  }
+
+  /*! reduces the per-lane min/max values of a SIMD bounds kernel
+      that processes the (x,y,z,x,y,z,...) float array of a vec3f
+      array; lane 'i' always holds coordinate 'i%3' */
+  template<int NUM_LANES>
+  inline box3f reduceLanes(const float *lo, const float *hi)
   {
     box3f bounds;
-    for (int i=0;i<8;i++) {
-      vec3f corner((i&1?box.lower:box.upper).x,
-                   (i&2?box.lower:box.upper).y,
-                   (i&4?box.lower:box.upper).z);
-      bounds.extend(xfmPoint(xfm,corner));
+    for (int i=0;i<NUM_LANES;i++) {
+      bounds.lower[i%3] = std::min(bounds.lower[i%3],lo[i]);
+      bounds.upper[i%3] = std::max(bounds.upper[i%3],hi[i]);
     }
     return bounds;
   }
-
-
-  typedef enum { INVALID=0,
-    DISNEY,
-    MATTE,
-    PLASTIC,
-    METAL,
-    VELVET,
-    METALLICPAINT,
-    THINGLASS,
-    DIELECTRIC,
-    BLENDER
-  } MaterialTag;
-  
-  MaterialTag materialTagOf(Material::SP mat)
-  {
-    if (mat->as<DisneyMaterial>()) return DISNEY;
-    if (mat->as<BlenderMaterial>()) return BLENDER;
-    if (mat->as<Matte>()) return MATTE;
-    if (mat->as<Metal>()) return METAL;
-    if (mat->as<Velvet>()) return VELVET;
-    if (mat->as<Plastic>()) return PLASTIC;
-    if (mat->as<MetallicPaint>()) return METALLICPAINT;
-    if (mat->as<Dielectric>()) return DIELECTRIC;
-    if (mat->as<ThinGlass>()) return THINGLASS;
-    
-    throw std::runtime_error("un-supported material type "+mat->toString()+" in Scene::save");
+  
+  box3f computeBounds(const vec3f *points, size_t numPoints)
+  {
+    static_assert(sizeof(vec3f) == 3*sizeof(float),
+                  "computeBounds() assumes tightly packed vec3f's");
+    const float *f = (const float *)points;
+    size_t i = 0;
+    box3f bounds;
+    // note: for all min/max's the new value is the _first_ operand:
+    // the SSE/AVX min/max return the second operand if either one is
+    // a NaN, so this way NaN's get ignored (same as box3f::extend())
+#if defined(__AVX__)
+    // 8 points = 24 floats = 3 AVX registers per iteration
+    if (numPoints >= 8) {
+      __m256 lo0 = _mm256_set1_ps(bounds.lower.x), hi0 = _mm256_set1_ps(bounds.upper.x);
+      __m256 lo1 = lo0, lo2 = lo0, hi1 = hi0, hi2 = hi0;
+      for (;i+8<=numPoints;i+=8,f+=24) {
+        const __m256 a = _mm256_loadu_ps(f+0);
+        const __m256 b = _mm256_loadu_ps(f+8);
+        const __m256 c = _mm256_loadu_ps(f+16);
+        lo0 = _mm256_min_ps(a,lo0); hi0 = _mm256_max_ps(a,hi0);
+        lo1 = _mm256_min_ps(b,lo1); hi1 = _mm256_max_ps(b,hi1);
+        lo2 = _mm256_min_ps(c,lo2); hi2 = _mm256_max_ps(c,hi2);
+      }
+      float lo[24], hi[24];
+      _mm256_storeu_ps(lo+0,lo0);  _mm256_storeu_ps(hi+0,hi0);
+      _mm256_storeu_ps(lo+8,lo1);  _mm256_storeu_ps(hi+8,hi1);
+      _mm256_storeu_ps(lo+16,lo2); _mm256_storeu_ps(hi+16,hi2);
+      bounds = reduceLanes<24>(lo,hi);
+    }
+#elif MINI_HAVE_SSE
+    // 4 points = 12 floats = 3 SSE registers per iteration
+    if (numPoints >= 4) {
+      __m128 lo0 = _mm_set1_ps(bounds.lower.x), hi0 = _mm_set1_ps(bounds.upper.x);
+      __m128 lo1 = lo0, lo2 = lo0, hi1 = hi0, hi2 = hi0;
+      for (;i+4<=numPoints;i+=4,f+=12) {
+        const __m128 a = _mm_loadu_ps(f+0);
+        const __m128 b = _mm_loadu_ps(f+4);
+        const __m128 c = _mm_loadu_ps(f+8);
+        lo0 = _mm_min_ps(a,lo0); hi0 = _mm_max_ps(a,hi0);
+        lo1 = _mm_min_ps(b,lo1); hi1 = _mm_max_ps(b,hi1);
+        lo2 = _mm_min_ps(c,lo2); hi2 = _mm_max_ps(c,hi2);
+      }
+      float lo[12], hi[12];
+      _mm_storeu_ps(lo+0,lo0); _mm_storeu_ps(hi+0,hi0);
+      _mm_storeu_ps(lo+4,lo1); _mm_storeu_ps(hi+4,hi1);
+      _mm_storeu_ps(lo+8,lo2); _mm_storeu_ps(hi+8,hi2);
+      bounds = reduceLanes<12>(lo,hi);
+    }
+#endif
+    for (;i<numPoints;i++)
+      bounds.extend(points[i]);
+    return bounds;
+  }
+  
+  /*! returns the type tag to store given material with */
+  inline int materialTagOf(const Material &mat)
+  {
+    if (mat.getType() == Material::INVALID)
+      throw std::runtime_error("un-supported material type "+mat.toString()+" in Scene::save");
+    return (int)mat.getType();
   }
   
-  Material::SP createMaterialFromTag(MaterialTag tag)
+  Material::SP createMaterialFromTag(int tag,
+                                     const Arena::SP &arena = {})
   {
     switch (tag){
-    case DISNEY: return DisneyMaterial::create();
-    case BLENDER: return BlenderMaterial::create();
-    case METAL: return Metal::create();
-    case VELVET: return Velvet::create();
-    case PLASTIC: return Plastic::create();
-    case MATTE: return Matte::create();
-    case DIELECTRIC: return Dielectric::create();
-    case THINGLASS: return ThinGlass::create();
-    case METALLICPAINT: return MetallicPaint::create();
+    case Material::DISNEY: return makeShared<DisneyMaterial>(arena);
+    case Material::BLENDER: return makeShared<BlenderMaterial>(arena);
+    case Material::METAL: return makeShared<Metal>(arena);
+    case Material::VELVET: return makeShared<Velvet>(arena);
+    case Material::PLASTIC: return makeShared<Plastic>(arena);
+    case Material::MATTE: return makeShared<Matte>(arena);
+    case Material::DIELECTRIC: return makeShared<Dielectric>(arena);
+    case Material::THINGLASS: return makeShared<ThinGlass>(arena);
+    case Material::METALLICPAINT: return makeShared<MetallicPaint>(arena);
     }
     throw std::runtime_error("un-supported material tag "+std::to_string((int)tag)+" in Scene::load");
   }
   
-  int getID(Texture::SP texture,
-            const std::map<Texture::SP,int> &serialized)
+  int getID(const Texture::SP &texture,
+            const Serialized<Texture::SP> &serialized)
   {
-    auto it = serialized.find(texture);
-    if (it == serialized.end()) return -1;
-    return it->second;
+    return serialized.getID(texture);
   }
   
   // ------------------------------------------------------------------
-  void BlenderMaterial::write(std::ofstream &out,
-                             const std::map<Texture::SP,int> &textures)
+  void BlenderMaterial::write(std::ostream &out,
+                             const Serialized<Texture::SP> &textures)
   {
     io::writeElement(out,this->baseColor);
     io::writeElement(out,this->roughness);
@@ -128,7 +194,7 @@ namespace mini {
   }
   
 
-  void BlenderMaterial::read(std::ifstream &in,
+  void BlenderMaterial::read(std::istream &in,
                             const std::vector<Texture::SP> &textures)
   {
     io::readElement(in,this->baseColor);
@@ -164,8 +230,8 @@ namespace mini {
   }
   
   // ------------------------------------------------------------------
-  void Plastic::write(std::ofstream &out,
-                      const std::map<Texture::SP,int> &textures)
+  void Plastic::write(std::ostream &out,
+                      const Serialized<Texture::SP> &textures)
   {
     io::writeElement(out,this->Ks);
     io::writeElement(out,this->eta);
@@ -173,7 +239,7 @@ namespace mini {
     io::writeElement(out,this->roughness);
   }
 
-  void Plastic::read(std::ifstream &in,
+  void Plastic::read(std::istream &in,
                      const std::vector<Texture::SP> &textures)
   {
     io::readElement(in,this->Ks);
@@ -183,21 +249,21 @@ namespace mini {
   }
   
   // ------------------------------------------------------------------
-  void Matte::write(std::ofstream &out,
-                             const std::map<Texture::SP,int> &textures)
+  void Matte::write(std::ostream &out,
+                             const Serialized<Texture::SP> &textures)
   {
     io::writeElement(out,this->reflectance);
   }
 
-  void Matte::read(std::ifstream &in,
+  void Matte::read(std::istream &in,
                             const std::vector<Texture::SP> &textures)
   {
     io::readElement(in,this->reflectance);
   }
   
   // ------------------------------------------------------------------
-  void MetallicPaint::write(std::ofstream &out,
-                             const std::map<Texture::SP,int> &textures)
+  void MetallicPaint::write(std::ostream &out,
+                             const Serialized<Texture::SP> &textures)
   {
     io::writeElement(out,this->glitterColor);
     io::writeElement(out,this->glitterSpread);
@@ -205,7 +271,7 @@ namespace mini {
     io::writeElement(out,this->eta);
   }
 
-  void MetallicPaint::read(std::ifstream &in,
+  void MetallicPaint::read(std::istream &in,
                             const std::vector<Texture::SP> &textures)
   {
     io::readElement(in,this->glitterColor);
@@ -215,15 +281,15 @@ namespace mini {
   }
   
   // ------------------------------------------------------------------
-  void ThinGlass::write(std::ofstream &out,
-                             const std::map<Texture::SP,int> &textures)
+  void ThinGlass::write(std::ostream &out,
+                             const Serialized<Texture::SP> &textures)
   {
     io::writeElement(out,this->eta);
     io::writeElement(out,this->thickness);
     io::writeElement(out,this->transmission);
   }
 
-  void ThinGlass::read(std::ifstream &in,
+  void ThinGlass::read(std::istream &in,
                             const std::vector<Texture::SP> &textures)
   {
     io::readElement(in,this->eta);
@@ -232,15 +298,15 @@ namespace mini {
   }
   
   // ------------------------------------------------------------------
-  void Dielectric::write(std::ofstream &out,
-                             const std::map<Texture::SP,int> &textures)
+  void Dielectric::write(std::ostream &out,
+                             const Serialized<Texture::SP> &textures)
   {
     io::writeElement(out,this->etaInside);
     io::writeElement(out,this->etaOutside);
     io::writeElement(out,this->transmission);
   }
 
-  void Dielectric::read(std::ifstream &in,
+  void Dielectric::read(std::istream &in,
                             const std::vector<Texture::SP> &textures)
   {
     io::readElement(in,this->etaInside);
@@ -249,15 +315,15 @@ namespace mini {
   }
   
   // ------------------------------------------------------------------
-  void Metal::write(std::ofstream &out,
-                             const std::map<Texture::SP,int> &textures)
+  void Metal::write(std::ostream &out,
+                             const Serialized<Texture::SP> &textures)
   {
     io::writeElement(out,this->eta);
     io::writeElement(out,this->k);
     io::writeElement(out,this->roughness);
   }
 
-  void Metal::read(std::ifstream &in,
+  void Metal::read(std::istream &in,
                             const std::vector<Texture::SP> &textures)
   {
     io::readElement(in,this->eta);
@@ -266,8 +332,8 @@ namespace mini {
   }
   
   // ------------------------------------------------------------------
-  void Velvet::write(std::ofstream &out,
-                             const std::map<Texture::SP,int> &textures)
+  void Velvet::write(std::ostream &out,
+                             const Serialized<Texture::SP> &textures)
   {
     io::writeElement(out,this->reflectance);
     io::writeElement(out,this->horizonScatteringColor);
@@ -275,7 +341,7 @@ namespace mini {
     io::writeElement(out,this->backScattering);
   }
 
-  void Velvet::read(std::ifstream &in,
+  void Velvet::read(std::istream &in,
                             const std::vector<Texture::SP> &textures)
   {
     io::readElement(in,this->reflectance);
@@ -285,8 +351,8 @@ namespace mini {
   }
   
   // ------------------------------------------------------------------
-  void DisneyMaterial::write(std::ofstream &out,
-                             const std::map<Texture::SP,int> &textures)
+  void DisneyMaterial::write(std::ostream &out,
+                             const Serialized<Texture::SP> &textures)
   {
     io::writeElement(out,this->emission);
     io::writeElement(out,this->baseColor);
@@ -299,7 +365,7 @@ namespace mini {
     io::writeElement(out,getID(this->alphaTexture,textures));
   }
 
-  void DisneyMaterial::read(std::ifstream &in,
+  void DisneyMaterial::read(std::istream &in,
                             const std::vector<Texture::SP> &textures)
   {
     io::readElement(in,this->emission);
@@ -330,131 +396,810 @@ namespace mini {
     return ss.str();
   }
   
+  inline box3f merge(const box3f &a, const box3f &b)
+  { return a.including(b); }
+  
   box3f Mesh::getBounds() const
   {
     box3f bounds;
+    if (cachedBounds.get(bounds))
+      return bounds;
+    const Mesh &m = getArrays();
+    if (m.isQuantized()) {
+      bounds = m.quantized.domain;
+      cachedBounds.set(bounds);
+      return bounds;
+    }
 #if PARALLELILIZE_GETBOUNDS
-    if (vertices.size() > 16*1024) {
-      std::mutex boundsMutex;
-      parallel_for_blocked
-        ((size_t)0,vertices.size(),16*1024,
-         [&](size_t begin, size_t end) {
-           box3f blockBox;
-           for (size_t i=begin;i<end;i++)
-             blockBox.extend(vertices[i]);
-           std::lock_guard<std::mutex> lock(boundsMutex);
-           bounds.extend(blockBox);
-         });
-    } else
+    bounds = parallel_reduce
+      ((size_t)0,m.vertices.size(),16*1024,box3f(),
+       [&](size_t begin, size_t end) {
+         return computeBounds(m.vertices.data()+begin,end-begin);
+       },
+       merge);
+#else
+    bounds = computeBounds(m.vertices.data(),m.vertices.size());
 #endif
-      for (auto vtx : vertices)
-        bounds.extend(vtx);
+    cachedBounds.set(bounds);
     return bounds;
   }
     
+  QuantizedVertices QuantizedVertices::encode(const std::vector<vec3f> &vertices,
+                                              const std::vector<vec3f> &normals,
+                                              const std::vector<vec2f> &texcoords)
+  {
+    QuantizedVertices q;
+    q.domain = computeBounds(vertices.data(),vertices.size());
+    q.vertices.resize(vertices.size());
+    q.normals.resize(normals.size());
+    q.texcoords.resize(texcoords.size());
+    parallel_for_blocked
+      (0,vertices.size(),16*1024,
+       [&](size_t begin, size_t end) {
+         for (size_t i=begin;i<end;i++)
+           q.vertices[i] = quantizePosition(vertices[i],q.domain);
+       });
+    parallel_for_blocked
+      (0,normals.size(),16*1024,
+       [&](size_t begin, size_t end) {
+         for (size_t i=begin;i<end;i++)
+           q.normals[i] = encodeOctahedral(normals[i]);
+       });
+    for (size_t i=0;i<texcoords.size();i++)
+      q.texcoords[i] = encodeHalf2(texcoords[i]);
+    return q;
+  }
+
+  void QuantizedVertices::decode(std::vector<vec3f> &vertices,
+                                 std::vector<vec3f> &normals,
+                                 std::vector<vec2f> &texcoords) const
+  {
+    vertices.resize(this->vertices.size());
+    normals.resize(this->normals.size());
+    texcoords.resize(this->texcoords.size());
+    parallel_for_blocked
+      (0,vertices.size(),16*1024,
+       [&](size_t begin, size_t end) {
+         for (size_t i=begin;i<end;i++)
+           vertices[i] = dequantizePosition(this->vertices[i],domain);
+       });
+    parallel_for_blocked
+      (0,normals.size(),16*1024,
+       [&](size_t begin, size_t end) {
+         for (size_t i=begin;i<end;i++)
+           normals[i] = decodeOctahedral(this->normals[i]);
+       });
+    for (size_t i=0;i<texcoords.size();i++)
+      texcoords[i] = decodeHalf2(this->texcoords[i]);
+  }
+  
+  void Mesh::quantize()
+  {
+    if (isQuantized() || vertices.empty()) return;
+    quantized = QuantizedVertices::encode(vertices,normals,texcoords);
+    std::vector<vec3f>().swap(vertices);
+    std::vector<vec3f>().swap(normals);
+    std::vector<vec2f>().swap(texcoords);
+  }
+  
+  void Mesh::dequantize()
+  {
+    if (!isQuantized()) return;
+    quantized.decode(vertices,normals,texcoords);
+    quantized = QuantizedVertices();
+  }
+  
+  void Mesh::ensureLoaded() const
+  {
+    if (isResident()) return;
+    std::lock_guard<std::mutex> lock(lazy.mutex);
+    if (isResident()) return;
+    lazy.payload->read(const_cast<Mesh &>(*this));
+    lazy.resident.store(true,std::memory_order_release);
+  }
+  
+  const Mesh &Mesh::getArrays() const
+  {
+    if (!isResident()) {
+      // (lazy.payload never changes once set, so this needs no lock)
+      const Mesh *source = lazy.payload->getSource();
+      if (source) return source->getArrays();
+    }
+    ensureLoaded();
+    return *this;
+  }
+  
+  void Mesh::evict()
+  {
+    if (!lazy.payload) return;
+    std::lock_guard<std::mutex> lock(lazy.mutex);
+    if (!isResident()) return;
+    std::vector<vec3i>().swap(indices);
+    std::vector<vec3us>().swap(indices16);
+    std::vector<vec3f>().swap(vertices);
+    std::vector<vec3f>().swap(normals);
+    std::vector<vec2f>().swap(texcoords);
+    quantized = QuantizedVertices();
+    lazy.resident.store(false,std::memory_order_release);
+  }
+  
+  bool Mesh::canUseNarrowIndices() const
+  {
+    if (!indices16.empty()) return true;
+    // reduce over uint8_t rather than bool, so no partial result can
+    // ever end up sharing a (bit-packed) word with another one
+    return parallel_reduce
+      ((size_t)0,indices.size(),64*1024,uint8_t(1),
+       [&](size_t begin, size_t end) -> uint8_t {
+         for (size_t i=begin;i<end;i++)
+           for (int j=0;j<3;j++)
+             if (uint32_t(indices[i][j]) > 0xffffu) return 0;
+         return 1;
+       },
+       [](uint8_t a, uint8_t b) -> uint8_t { return a && b; }) != 0;
+  }
+  
+  bool Mesh::narrowIndices()
+  {
+    if (!indices16.empty()) return true;
+    if (indices.empty() || !canUseNarrowIndices()) return false;
+    indices16.resize(indices.size());
+    for (size_t i=0;i<indices.size();i++)
+      indices16[i] = vec3us(indices[i]);
+    std::vector<vec3i>().swap(indices);
+    return true;
+  }
+  
+  void Mesh::widenIndices()
+  {
+    if (indices16.empty()) return;
+    indices.resize(indices16.size());
+    for (size_t i=0;i<indices16.size();i++)
+      indices[i] = vec3i(indices16[i]);
+    std::vector<vec3us>().swap(indices16);
+  }
+  
   box3f Object::getBounds() const
   {
     box3f bounds;
+    if (cachedBounds.get(bounds))
+      return bounds;
 #if PARALLELILIZE_GETBOUNDS
-    if (meshes.size() > 16*1024) {
-      std::mutex boundsMutex;
-      parallel_for_blocked
-        ((size_t)0,meshes.size(),16*1024,
-         [&](size_t begin, size_t end) {
-           box3f blockBox;
-           for (size_t i=begin;i<end;i++)
-             blockBox.extend(meshes[i]->getBounds());
-           std::lock_guard<std::mutex> lock(boundsMutex);
-           bounds.extend(blockBox);
-         });
-    } else
+    bounds = parallel_reduce
+      ((size_t)0,meshes.size(),16*1024,box3f(),
+       [&](size_t begin, size_t end) {
+         box3f blockBox;
+         for (size_t i=begin;i<end;i++)
+           if (meshes[i]) blockBox.extend(meshes[i]->getBounds());
+         return blockBox;
+       },
+       merge);
+#else
+    for (auto &mesh : meshes)
+      if (mesh) bounds.extend(mesh->getBounds());
 #endif
-    for (auto mesh : meshes)
-      bounds.extend(mesh->getBounds());
+    cachedBounds.set(bounds);
     return bounds;
   }
 
+  void Object::invalidateBounds()
+  {
+    cachedBounds.invalidate();
+    bvh.reset();
+    for (auto &mesh : meshes)
+      if (mesh) mesh->invalidateBounds();
+  }
+
     
   box3f Instance::getBounds() const
   {
     const box3f box = object->getBounds();
     return transformedBoxBounds(xfm,box);
   }
+
+  /*! merges two sorted lists of unique objects */
+  inline std::vector<const Object *> mergeUnique(const std::vector<const Object *> &a,
+                                                 const std::vector<const Object *> &b)
+  {
+    std::vector<const Object *> result;
+    result.reserve(a.size()+b.size());
+    std::set_union(a.begin(),a.end(),b.begin(),b.end(),
+                   std::back_inserter(result));
+    return result;
+  }
   
   box3f Scene::getBounds() const
   {
-    box3f bounds;
 #if PARALLELILIZE_GETBOUNDS
-    std::map<Object::SP,box3f> objectBounds;
-    
     // ------------------------------------------------------------------
-    // first, make a list of all the objects being used in the scene
+    // first, make a (sorted) list of all the unique objects being used
+    // in the scene; each block of instances does its own list, and
+    // those get merged (and de-duplicated) in a tree
     // ------------------------------------------------------------------
-    std::mutex mutex;
-    parallel_for_blocked
-      ((size_t)0,instances.size(),1024,
+    const std::vector<const Object *> uniqueObjects
+      = parallel_reduce
+      ((size_t)0,instances.size(),16*1024,std::vector<const Object *>(),
        [&](size_t begin, size_t end) {
-         std::set<Object::SP> blockObjects;
-         box3f blockBox;
+         std::vector<const Object *> blockObjects;
          for (size_t i=begin;i<end;i++)
-           blockObjects.insert(instances[i]->object);
-         std::lock_guard<std::mutex> lock(mutex);
-         for (auto obj : blockObjects)
-           objectBounds[obj] = box3f();
-       });
+           if (instances[i] && instances[i]->object)
+             blockObjects.push_back(instances[i]->object.get());
+         std::sort(blockObjects.begin(),blockObjects.end());
+         blockObjects.erase(std::unique(blockObjects.begin(),blockObjects.end()),
+                            blockObjects.end());
+         return blockObjects;
+       },
+       mergeUnique);
     
     // ------------------------------------------------------------------
-    // second, make a linear list of all objects, so we can do them in
-    // parallel
-    // ------------------------------------------------------------------
-    std::vector<Object::SP> uniqueObjects;
-    uniqueObjects.reserve(objectBounds.size());
-    for (auto it : objectBounds)
-      uniqueObjects.push_back(it.first);
-    
-    // ------------------------------------------------------------------
-    // third, compute all the object bounds
+    // second, compute all the object bounds, in parallel
     // ------------------------------------------------------------------
+    std::vector<box3f> objectBounds(uniqueObjects.size());
     parallel_for
       (uniqueObjects.size(),
        [&](size_t objID) {
-         auto obj = uniqueObjects[objID];
-         // this parallel access is fine because no new node
-         // will ever get created in the map; they all
-         // already exist, we just find() them here.
-         objectBounds[obj] = obj->getBounds();
+         objectBounds[objID] = uniqueObjects[objID]->getBounds();
        });
     
     // ------------------------------------------------------------------
-    // last, do all the instances in parallel
+    // last, do all the instances in parallel, looking up their
+    // object's bounds through a binary search in that sorted list
     // ------------------------------------------------------------------
-    parallel_for_blocked
-      ((size_t)0,instances.size(),1024,
+    return parallel_reduce
+      ((size_t)0,instances.size(),1024,box3f(),
        [&](size_t begin, size_t end) {
          box3f blockBox;
          for (size_t i=begin;i<end;i++) {
-           auto inst = instances[i];
-           box3f objBounds = objectBounds[inst->object];
-           blockBox.extend(transformedBoxBounds(inst->xfm,objBounds));
+           auto inst = instances[i].get();
+           if (!inst || !inst->object) continue;
+           const size_t objID
+             = std::lower_bound(uniqueObjects.begin(),uniqueObjects.end(),
+                                inst->object.get())
+             - uniqueObjects.begin();
+           blockBox.extend(transformedBoxBounds(inst->xfm,objectBounds[objID]));
          }
-         std::lock_guard<std::mutex> lock(mutex);
-         bounds.extend(blockBox);
-       });
+         return blockBox;
+       },
+       merge);
 #else
-    for (auto inst : instances)
-      bounds.extend(inst->getBounds());
-#endif
+    box3f bounds;
+    for (auto &inst : instances)
+      if (inst && inst->object)
+        bounds.extend(inst->getBounds());
     return bounds;
+#endif
   }
     
     
-  void Scene::save(const std::string &baseName)
+  // ------------------------------------------------------------------
+  // helpers for gathering a SceneInfo (both for Scene::getInfo(), and
+  // for the statistics that SceneWriter stores in the file)
+  // ------------------------------------------------------------------
+
+  void countTextures(SceneInfo &info, const Serialized<Texture::SP> &textures)
+  {
+    for (auto tex : textures.list) {
+      if (!tex) continue;
+      info.numTextures++;
+      if (tex->format == Texture::EMBEDDED_PTEX) {
+        info.numPtexTextures++;
+        info.numPtexBytes += tex->data.size();
+      } else
+        info.numTexelBytes += tex->data.size();
+    }
+  }
+
+  void countLights(SceneInfo &info, const Scene *scene)
+  {
+    info.numQuadLights = scene->quadLights.size();
+    info.numDirLights  = scene->dirLights.size();
+    if (scene->envMapLight && scene->envMapLight->texture)
+      info.envMapSize = scene->envMapLight->texture->size;
+  }
+
+  /*! number of normals of a mesh, quantized or not - and without
+      loading it if it got loaded lazily */
+  inline size_t numNormalsOf(const Mesh &mesh)
+  {
+    if (!mesh.isResident()) return mesh.lazy.payload->numNormals;
+    return mesh.isQuantized() ? mesh.quantized.normals.size() : mesh.normals.size();
+  }
+
+  /*! same as numNormalsOf(), for texcoords */
+  inline size_t numTexcoordsOf(const Mesh &mesh)
+  {
+    if (!mesh.isResident()) return mesh.lazy.payload->numTexcoords;
+    return mesh.isQuantized() ? mesh.quantized.texcoords.size() : mesh.texcoords.size();
+  }
+  
+  /*! the payload of a mesh created with Mesh::createSharedCopy() */
+  struct SharedMeshPayload : public MeshPayload {
+    SharedMeshPayload(const Mesh::SP &source)
+      : source(source)
+    {
+      numPrims     = source->getNumPrims();
+      numVertices  = source->getNumVertices();
+      numNormals   = numNormalsOf(*source);
+      numTexcoords = numTexcoordsOf(*source);
+    }
+    
+    void read(Mesh &mesh) const override
+    {
+      source->ensureLoaded();
+      mesh.indices   = source->indices;
+      mesh.indices16 = source->indices16;
+      mesh.vertices  = source->vertices;
+      mesh.normals   = source->normals;
+      mesh.texcoords = source->texcoords;
+      mesh.quantized = source->quantized;
+    }
+
+    const Mesh *getSource() const override { return source.get(); }
+    
+    const Mesh::SP source;
+  };
+
+  Mesh::SP Mesh::createSharedCopy(const SP &source)
+  {
+    assert(source);
+    // a copy of a (not yet resident) copy shares the original's arrays
+    SP original = source;
+    if (!source->isResident()) {
+      const SharedMeshPayload *shared
+        = dynamic_cast<const SharedMeshPayload *>(source->lazy.payload.get());
+      if (shared) original = shared->source;
+    }
+    SP copy = create(source->material);
+    copy->meshlets = source->meshlets;
+    copy->cachedBounds.set(source->getBounds());
+    copy->lazy.payload = std::make_shared<SharedMeshPayload>(original);
+    copy->lazy.resident.store(false);
+    return copy;
+  }
+
+  void countUniqueMeshes(SceneInfo &info, const Serialized<Mesh::SP> &meshes)
+  {
+    for (auto &mesh : meshes.list) {
+      info.numUniqueMeshes++;
+      info.numUniqueTriangles += mesh->getNumPrims();
+      info.numUniqueVertices  += mesh->getNumVertices();
+    }
+  }
+
+  /*! counts (only) the 'actual' meshes, triangles, etc, of a single
+      instance of the given object */
+  void countActualMeshes(SceneInfo &info, const Object &object)
+  {
+    for (auto &mesh : object.meshes) {
+      if (!mesh) continue;
+      info.numActualMeshes++;
+      info.numActualTriangles += mesh->getNumPrims();
+      info.numActualVertices  += mesh->getNumVertices();
+      info.numActualNormals   += numNormalsOf(*mesh);
+      info.numActualTexcoords += numTexcoordsOf(*mesh);
+    }
+  }
+
+  void addActualMeshes(SceneInfo &info, const SceneInfo &objectCounts)
+  {
+    info.numActualMeshes    += objectCounts.numActualMeshes;
+    info.numActualTriangles += objectCounts.numActualTriangles;
+    info.numActualVertices  += objectCounts.numActualVertices;
+    info.numActualNormals   += objectCounts.numActualNormals;
+    info.numActualTexcoords += objectCounts.numActualTexcoords;
+  }
+
+  SceneInfo Scene::getInfo() const
   {
-    std::ofstream out(baseName,std::ios::binary);
-    if (!out.good())
-      throw std::runtime_error("could not open file '"+baseName+"'");
     SerializedScene serialized(this);
-      
+    SceneInfo info;
+    info.numInstances = instances.size();
+    info.numObjects   = serialized.objects.size();
+    info.numMaterials = serialized.materials.size();
+    countTextures(info,serialized.textures);
+    countLights(info,this);
+    countUniqueMeshes(info,serialized.meshes);
+    std::vector<SceneInfo> objectCounts(serialized.objects.size());
+    for (size_t objID=0;objID<serialized.objects.size();objID++)
+      countActualMeshes(objectCounts[objID],*serialized.objects.list[objID]);
+    for (auto &inst : instances)
+      if (inst && inst->object)
+        addActualMeshes(info,objectCounts[serialized.getID(inst->object)]);
+    info.bounds = getBounds();
+    return info;
+  }
+  
+  /*! number of bytes a SceneInfo takes in the file */
+  enum { SCENE_INFO_SIZE = 17*sizeof(uint64_t) + 2*sizeof(int32_t) + 6*sizeof(float) };
+  
+  /*! writes a SceneInfo field by field, with fixed-width types, so
+      the file format doesn't depend on SceneInfo's in-memory layout.
+      Fields added to SceneInfo in the future have to get written
+      after all others, and read only for files of the format version
+      that introduced them */
+  template<typename Writer>
+  void writeSceneInfo(Writer &out, const SceneInfo &info)
+  {
+    io::writeElement(out,(uint64_t)info.numInstances);
+    io::writeElement(out,(uint64_t)info.numObjects);
+    io::writeElement(out,(uint64_t)info.numUniqueMeshes);
+    io::writeElement(out,(uint64_t)info.numUniqueTriangles);
+    io::writeElement(out,(uint64_t)info.numUniqueVertices);
+    io::writeElement(out,(uint64_t)info.numActualMeshes);
+    io::writeElement(out,(uint64_t)info.numActualTriangles);
+    io::writeElement(out,(uint64_t)info.numActualVertices);
+    io::writeElement(out,(uint64_t)info.numActualNormals);
+    io::writeElement(out,(uint64_t)info.numActualTexcoords);
+    io::writeElement(out,(uint64_t)info.numTextures);
+    io::writeElement(out,(uint64_t)info.numPtexTextures);
+    io::writeElement(out,(uint64_t)info.numPtexBytes);
+    io::writeElement(out,(uint64_t)info.numTexelBytes);
+    io::writeElement(out,(uint64_t)info.numMaterials);
+    io::writeElement(out,(uint64_t)info.numQuadLights);
+    io::writeElement(out,(uint64_t)info.numDirLights);
+    io::writeElement(out,(int32_t)info.envMapSize.x);
+    io::writeElement(out,(int32_t)info.envMapSize.y);
+    io::writeElement(out,info.bounds.lower.x);
+    io::writeElement(out,info.bounds.lower.y);
+    io::writeElement(out,info.bounds.lower.z);
+    io::writeElement(out,info.bounds.upper.x);
+    io::writeElement(out,info.bounds.upper.y);
+    io::writeElement(out,info.bounds.upper.z);
+  }
+
+  /*! reads a SceneInfo written with writeSceneInfo() */
+  template<typename Reader>
+  SceneInfo readSceneInfo(Reader &in, int /*format_version*/)
+  {
+    SceneInfo info;
+    info.numInstances = (size_t)io::readElement<uint64_t>(in);
+    info.numObjects = (size_t)io::readElement<uint64_t>(in);
+    info.numUniqueMeshes = (size_t)io::readElement<uint64_t>(in);
+    info.numUniqueTriangles = (size_t)io::readElement<uint64_t>(in);
+    info.numUniqueVertices = (size_t)io::readElement<uint64_t>(in);
+    info.numActualMeshes = (size_t)io::readElement<uint64_t>(in);
+    info.numActualTriangles = (size_t)io::readElement<uint64_t>(in);
+    info.numActualVertices = (size_t)io::readElement<uint64_t>(in);
+    info.numActualNormals = (size_t)io::readElement<uint64_t>(in);
+    info.numActualTexcoords = (size_t)io::readElement<uint64_t>(in);
+    info.numTextures = (size_t)io::readElement<uint64_t>(in);
+    info.numPtexTextures = (size_t)io::readElement<uint64_t>(in);
+    info.numPtexBytes = (size_t)io::readElement<uint64_t>(in);
+    info.numTexelBytes = (size_t)io::readElement<uint64_t>(in);
+    info.numMaterials = (size_t)io::readElement<uint64_t>(in);
+    info.numQuadLights = (size_t)io::readElement<uint64_t>(in);
+    info.numDirLights = (size_t)io::readElement<uint64_t>(in);
+    info.envMapSize.x = io::readElement<int32_t>(in);
+    info.envMapSize.y = io::readElement<int32_t>(in);
+    io::readElement(in,info.bounds.lower.x);
+    io::readElement(in,info.bounds.lower.y);
+    io::readElement(in,info.bounds.lower.z);
+    io::readElement(in,info.bounds.upper.x);
+    io::readElement(in,info.bounds.upper.y);
+    io::readElement(in,info.bounds.upper.z);
+    return info;
+  }
+  
+  /*! the "section offset table" that - starting with format version
+      13 - gets written to the end of each file (followed by the
+      offset at which this index starts, and the end-of-file
+      magic). Allows a loader to directly locate - and thus, read in
+      parallel - each individual texture and mesh */
+  struct FileIndex {
+    template<typename Reader>
+    void read(Reader &in, int format_version)
+    {
+      if (format_version >= 18)
+        info = readSceneInfo(in,format_version);
+      io::readVector(in,textureOffsets);
+      io::readElement(in,lightsOffset);
+      io::readElement(in,materialsOffset);
+      io::readElement(in,objectsOffset);
+      io::readElement(in,instancesOffset);
+      io::readVector(in,objectMeshBegin);
+      io::readVector(in,meshOffsets);
+      if (format_version >= 14) {
+        io::readVector(in,objectBounds);
+        io::readVector(in,meshBounds);
+      }
+      if (format_version >= 19)
+        io::readElement(in,bvhsOffset);
+      if (format_version >= 20)
+        io::readElement(in,meshletsOffset);
+      if (format_version >= 21)
+        io::readElement(in,materialTableOffset);
+    }
+    
+    template<typename Writer>
+    void write(Writer &out) const
+    {
+      writeSceneInfo(out,info);
+      io::writeVector(out,textureOffsets);
+      io::writeElement(out,lightsOffset);
+      io::writeElement(out,materialsOffset);
+      io::writeElement(out,objectsOffset);
+      io::writeElement(out,instancesOffset);
+      io::writeVector(out,objectMeshBegin);
+      io::writeVector(out,meshOffsets);
+      io::writeVector(out,objectBounds);
+      io::writeVector(out,meshBounds);
+      io::writeElement(out,bvhsOffset);
+      io::writeElement(out,meshletsOffset);
+      io::writeElement(out,materialTableOffset);
+    }
+    
+    /*! (version 18+) summary statistics of the scene; this comes
+        first, so Scene::peekInfo() has to read only this */
+    SceneInfo           info;
+    /*! file offset of each texture's record (incl its 'valid' flag) */
+    std::vector<size_t> textureOffsets;
+    size_t lightsOffset    = 0;
+    size_t materialsOffset = 0;
+    size_t objectsOffset   = 0;
+    size_t instancesOffset = 0;
+    /*! object #i's meshes are meshOffsets[objectMeshBegin[i]] up to
+        (excluding) meshOffsets[objectMeshBegin[i+1]]; ie, this has
+        numObjects+1 entries */
+    std::vector<size_t> objectMeshBegin;
+    /*! file offset of each mesh's record (incl its 'valid' flag),
+        across all objects */
+    std::vector<size_t> meshOffsets;
+    /*! (version 14+) bounding box of each object */
+    std::vector<box3f>  objectBounds;
+    /*! (version 14+) bounding box of each mesh (empty for null
+        meshes), in the same order as meshOffsets */
+    std::vector<box3f>  meshBounds;
+    /*! (version 19+) file offset of the BVHs section; 0 if the file
+        has no BVHs stored */
+    size_t              bvhsOffset = 0;
+    /*! (version 20+) file offset of the meshlets section; 0 if no
+        mesh has meshlets stored */
+    size_t              meshletsOffset = 0;
+    /*! (version 21+) file offset of the packed material table; 0 if
+        the file has none stored */
+    size_t              materialTableOffset = 0;
+  };
+
+  template<typename Writer>
+  void writeBVH(Writer &out, const BVH &bvh)
+  {
+    io::writeVector(out,bvh.nodes);
+    io::writeVector(out,bvh.primIDs);
+  }
+
+  template<typename Reader>
+  BVH::SP readBVH(Reader &in)
+  {
+    BVH::SP bvh = std::make_shared<BVH>();
+    io::readVector(in,bvh->nodes);
+    io::readVector(in,bvh->primIDs);
+    return bvh;
+  }
+
+  /*! writes a mesh's meshlets (if any), incl a 'valid' flag */
+  template<typename Writer>
+  void writeMeshlets(Writer &out, const Mesh::SP &mesh)
+  {
+    if (!mesh || !mesh->meshlets) {
+      io::writeElement(out,int(0));
+      return;
+    }
+    io::writeElement(out,int(1));
+    io::writeVector(out,mesh->meshlets->meshlets);
+    io::writeVector(out,mesh->meshlets->vertices);
+    io::writeVector(out,mesh->meshlets->triangles);
+  }
+
+  template<typename Reader>
+  Meshlets::SP readMeshlets(Reader &in)
+  {
+    if (!io::readElement<int>(in))
+      return {};
+    Meshlets::SP meshlets = std::make_shared<Meshlets>();
+    io::readVector(in,meshlets->meshlets);
+    io::readVector(in,meshlets->vertices);
+    io::readVector(in,meshlets->triangles);
+    return meshlets;
+  }
+
+  /*! writes an array as a data block (version 15+): the number of
+      elements, a block header, and then either the raw data, or the
+      compressed size followed by the compressed data. 'stride' is
+      the number of (equally sized) components per element of T,
+      which the delta filters work on */
+  template<typename Writer, typename T>
+  void writeDataBlock(Writer &out, const std::vector<T> &v,
+                      compression::Codec codec,
+                      compression::Filter filter, int stride)
+  {
+    io::writeElement(out,v.size());
+    if (codec == compression::NONE) {
+      compression::BlockHeader header;
+      header.codec         = compression::NONE;
+      header.filter        = compression::NO_FILTER;
+      header.stride        = 1;
+      header.chunkSizeLog2 = compression::DEFAULT_CHUNK_SIZE_LOG2;
+      io::writeElement(out,header);
+      io::writeArray(out,v.data(),v.size());
+    } else {
+      std::vector<uint8_t> block;
+      // 'stride' is the number of components per element, so this is
+      // the size of one component (2 bytes for, e.g., vec3us)
+      const int wordSize = int(sizeof(T))/std::max(stride,1);
+      compression::encodeBlock(block,v.data(),v.size()*sizeof(T),codec,filter,stride,
+                               wordSize);
+      io::writeArray(out,block.data(),block.size());
+    }
+  }
+
+  /*! reads an array written by writeDataBlock() */
+  template<typename Reader, typename T>
+  void readDataBlock(Reader &in, std::vector<T> &v)
+  {
+    const size_t N = io::readElement<size_t>(in);
+    const compression::BlockHeader header
+      = io::readElement<compression::BlockHeader>(in);
+    v.resize(N);
+    if (header.codec == compression::NONE) {
+      io::readArray(in,v.data(),N);
+      return;
+    }
+    const size_t compressedSize = io::readElement<size_t>(in);
+    std::vector<uint8_t> compressed(compressedSize);
+    io::readArray(in,compressed.data(),compressedSize);
+    compression::decodeBlock(header,compressed.data(),compressedSize,
+                             v.data(),N*sizeof(T));
+  }
+
+  /*! reads an array that got written as a data block in version 15+
+      files, and as a plain vector before that */
+  template<typename Reader, typename T>
+  void readArrayData(Reader &in, std::vector<T> &v, int format_version)
+  {
+    if (format_version >= 15)
+      readDataBlock(in,v);
+    else
+      io::readVector(in,v);
+  }
+  
+  /*! mesh record flags; written in front of each mesh */
+  enum { MESH_NULL = 0, MESH_FULL = 1, MESH_QUANTIZED = 2 };
+  
+  /*! writes a mesh's vertex indices as a width (2 or 4 bytes),
+      followed by a data block of that many bytes per index;
+      meshes whose indices all fit into 16 bits always get them
+      written with 16 bits */
+  template<typename Writer>
+  void writeIndices(Writer &out, const Mesh &mesh, compression::Codec codec)
+  {
+    if (!mesh.indices16.empty()) {
+      io::writeElement(out,int(2));
+      writeDataBlock(out,mesh.indices16,codec,compression::AUTO_FILTER,3);
+    } else if (!mesh.indices.empty() && mesh.canUseNarrowIndices()) {
+      std::vector<vec3us> narrow(mesh.indices.size());
+      for (size_t i=0;i<narrow.size();i++)
+        narrow[i] = vec3us(mesh.indices[i]);
+      io::writeElement(out,int(2));
+      writeDataBlock(out,narrow,codec,compression::AUTO_FILTER,3);
+    } else {
+      io::writeElement(out,int(4));
+      writeDataBlock(out,mesh.indices,codec,compression::AUTO_FILTER,3);
+    }
+  }
+  
+  /*! reads indices written by writeIndices() (or, for pre-v17 files,
+      a plain index array) */
+  template<typename Reader>
+  void readIndices(Reader &in, Mesh &mesh, int format_version,
+                   const LoadOptions &options)
+  {
+    if (format_version < 17) {
+      readArrayData(in,mesh.indices,format_version);
+      return;
+    }
+    const int width = io::readElement<int>(in);
+    if (width == 2) {
+      readDataBlock(in,mesh.indices16);
+      if (!options.keepNarrowIndices)
+        mesh.widenIndices();
+    } else if (width == 4)
+      readDataBlock(in,mesh.indices);
+    else
+      throw std::runtime_error("invalid index width in miniScene/.mini file");
+  }
+  
+  /*! writes a single mesh record (incl 'valid' flag) */
+  template<typename Writer>
+  void writeMesh(Writer &out, const Mesh::SP &mesh, int matID,
+                 const SaveOptions &options)
+  {
+    if (!mesh) { io::writeElement(out,int(MESH_NULL)); return; }
+    
+    const Mesh &m = mesh->getArrays();
+    const compression::Codec codec = options.compression;
+    if (m.isQuantized() || (options.quantizeVertices && !m.vertices.empty())) {
+      QuantizedVertices encoded;
+      const QuantizedVertices &q
+        = m.isQuantized()
+        ? m.quantized
+        : (encoded = QuantizedVertices::encode(m.vertices,m.normals,
+                                               m.texcoords));
+      io::writeElement(out,int(MESH_QUANTIZED));
+      writeIndices(out,m,codec);
+      io::writeElement(out,q.domain);
+      writeDataBlock(out,q.vertices,  codec,compression::AUTO_FILTER,3);
+      writeDataBlock(out,q.normals,   codec,compression::AUTO_FILTER,2);
+      writeDataBlock(out,q.texcoords, codec,compression::AUTO_FILTER,2);
+      assert(matID >= 0);
+      io::writeElement(out,matID);
+      return;
+    }
+    io::writeElement(out,int(MESH_FULL));
+    writeIndices(out,m,codec);
+    writeDataBlock(out,m.vertices, codec,compression::AUTO_FILTER,3);
+    writeDataBlock(out,m.normals,  codec,compression::AUTO_FILTER,3);
+    writeDataBlock(out,m.texcoords,codec,compression::AUTO_FILTER,2);
+    assert(matID >= 0);
+    io::writeElement(out,matID);
+  }
+  
+  struct SceneWriter::Impl {
+    Impl(const std::string &fileName, SerializedScene &&serialized,
+         bool writeInBackground)
+      : out(fileName,4<<20,writeInBackground),
+        serialized(std::move(serialized))
+    {}
+    
+    io::FileWriter  out;
+    SerializedScene serialized;
+    FileIndex       index;
+    /*! where the number of instances got written, so we can patch
+        in the actual number once we know it */
+    size_t          numInstancesOffset = 0;
+    size_t          numInstances = 0;
+    /*! mesh, triangle, vertex, etc counts of each object; get added
+        to the file's SceneInfo for every instance of that object */
+    std::vector<SceneInfo> objectCounts;
+    /*! world-space bounds of all instances written so far; only
+        tracked if we have to store BVHs */
+    bool               storeBVHs = false;
+    /*! whether meshes get quantized on save, in which case the
+        stored BVHs have to be built over the quantized positions */
+    bool               quantizeVertices = false;
+    std::vector<box3f> instanceBounds;
+    bool               storeMaterialTable = false;
+    BVH::BuildConfig   bvhConfig;
+  };
+
+  SceneWriter::SceneWriter(const std::string &fileName, const Scene *scene,
+                           const SaveOptions &options,
+                           bool writeInBackground)
+    : SceneWriter(fileName,scene,SerializedScene(scene),options,writeInBackground)
+  {
+    for (auto &inst : scene->instances)
+      write(inst);
+  }
+
+  SceneWriter::SceneWriter(const std::string &fileName, const Scene *lights,
+                           const std::vector<Object::SP> &objects,
+                           const SaveOptions &options,
+                           bool writeInBackground)
+    : SceneWriter(fileName,lights,SerializedScene(objects),options,writeInBackground)
+  {}
+  
+  SceneWriter::SceneWriter(const std::string &fileName, const Scene *scene,
+                           SerializedScene &&_serialized,
+                           const SaveOptions &options,
+                           bool writeInBackground)
+    : impl(new Impl(fileName,std::move(_serialized),writeInBackground))
+  {
+    io::FileWriter  &out        = impl->out;
+    SerializedScene &serialized = impl->serialized;
+    FileIndex       &index      = impl->index;
+    impl->storeBVHs = options.storeBVHs;
+    impl->quantizeVertices = options.quantizeVertices;
+    impl->storeMaterialTable = options.storeMaterialTable;
+    
     io::writeElement(out,expected_magic);
 
     // ------------------------------------------------------------------
@@ -462,6 +1207,7 @@ namespace mini {
     // ------------------------------------------------------------------
     io::writeElement(out,serialized.textures.list.size());
     for (auto tex : serialized.textures.list) {
+      index.textureOffsets.push_back(out.tell());
       if (/* only first one may/will be null */!tex) {
         io::writeElement(out,int(0));
       } else {
@@ -469,19 +1215,21 @@ namespace mini {
         io::writeElement(out,tex->size);
         io::writeElement(out,tex->format);
         io::writeElement(out,tex->filterMode);
-        io::writeVector(out,tex->data);
+        writeDataBlock(out,tex->data,options.compression,compression::NO_FILTER,1);
       }
     }
+    countTextures(index.info,serialized.textures);
 
     // ------------------------------------------------------------------
     // lights
     // ------------------------------------------------------------------
-    io::writeVector(out,quadLights);
-    io::writeVector(out,dirLights);
-    if (envMapLight) {
+    index.lightsOffset = out.tell();
+    io::writeVector(out,scene->quadLights);
+    io::writeVector(out,scene->dirLights);
+    if (scene->envMapLight) {
       io::writeElement(out,int(1));
-      io::writeElement(out,envMapLight->transform);
-      Texture::SP tex = envMapLight->texture;
+      io::writeElement(out,scene->envMapLight->transform);
+      Texture::SP tex = scene->envMapLight->texture;
       assert(tex);
       io::writeElement(out,tex->size);
       io::writeElement(out,tex->format);
@@ -489,122 +1237,274 @@ namespace mini {
       io::writeVector(out,tex->data);
     } else
       io::writeElement(out,int(0));
+    countLights(index.info,scene);
         
     // ------------------------------------------------------------------
-    // materials
+    // materials (which can only write to a std::ostream)
     // ------------------------------------------------------------------
+    index.materialsOffset = out.tell();
+    index.info.numMaterials = serialized.materials.size();
     io::writeElement(out,serialized.materials.list.size());
-    for (auto mat : serialized.materials.list) {
-      // io::writeElement(out,(MaterialData&)*mat);
-#if 1
-      // version 12
-      int tag = (int)materialTagOf(mat);
-      io::writeElement(out,tag);
-      mat->write(out,serialized.textures.registry);
-#else
-      // old version 11
-      io::writeElement(out,mat->emission);
-      io::writeElement(out,mat->baseColor);
-      io::writeElement(out,mat->metallic);
-      io::writeElement(out,mat->roughness);
-      io::writeElement(out,mat->transmission);
-      io::writeElement(out,mat->ior);
-
-      io::writeElement(out,serialized.getID(mat->colorTexture));
-      io::writeElement(out,serialized.getID(mat->alphaTexture));
-#endif
+    {
+      io::FileWriterStreamBuf streamBuf(out);
+      std::ostream materialStream(&streamBuf);
+      for (auto &mat : serialized.materials.list) {
+        int tag = materialTagOf(*mat);
+        io::writeElement(materialStream,tag);
+        mat->write(materialStream,serialized.textures);
+      }
+      if (!materialStream.good())
+        throw std::runtime_error("error writing materials");
     }
       
     // ------------------------------------------------------------------
     // objects and meshes
     // ------------------------------------------------------------------
+    index.objectsOffset = out.tell();
+    index.objectBounds.resize(serialized.objects.size());
+    parallel_for
+      (serialized.objects.size(),
+       [&](size_t objID) {
+         index.objectBounds[objID] = serialized.objects.list[objID]->getBounds();
+       });
+    // (with compression, we first encode all the meshes of a batch
+    // of objects in parallel, and then write those in order)
+    const bool encodeInParallel = options.compression != compression::NONE;
+    const size_t objectBatchSize = 256;
+    std::vector<std::vector<std::vector<uint8_t>>> encoded;
     io::writeElement(out,serialized.objects.size());
-    for (auto &obj : serialized.objects.list) {
+    for (size_t batchBegin=0;batchBegin<serialized.objects.size();batchBegin+=objectBatchSize) {
+      const size_t batchEnd = std::min(batchBegin+objectBatchSize,serialized.objects.size());
+      if (encodeInParallel) {
+        encoded.clear();
+        encoded.resize(batchEnd-batchBegin);
+        parallel_for
+          (batchEnd-batchBegin,
+           [&](size_t i) {
+             auto &obj = serialized.objects.list[batchBegin+i];
+             encoded[i].resize(obj->meshes.size());
+             parallel_for
+               (obj->meshes.size(),
+                [&](size_t meshID) {
+                  auto mesh = obj->meshes[meshID];
+                  io::VectorWriter meshOut(encoded[i][meshID]);
+                  writeMesh(meshOut,mesh,mesh?serialized.getID(mesh->material):-1,options);
+                });
+           });
+      }
+      for (size_t objID=batchBegin;objID<batchEnd;objID++) {
+        auto &obj = serialized.objects.list[objID];
+        index.objectMeshBegin.push_back(index.meshOffsets.size());
+      
+        io::writeElement(out,obj->meshes.size());
+        for (size_t meshID=0;meshID<obj->meshes.size();meshID++) {
+          auto mesh = obj->meshes[meshID];
+          index.meshOffsets.push_back(out.tell());
+          index.meshBounds.push_back(mesh ? mesh->getBounds() : box3f());
+          if (encodeInParallel) {
+            auto &bytes = encoded[objID-batchBegin][meshID];
+            io::writeArray(out,bytes.data(),bytes.size());
+          } else 
+            writeMesh(out,mesh,mesh?serialized.getID(mesh->material):-1,options);
+        }
+      }
+    }
+    index.objectMeshBegin.push_back(index.meshOffsets.size());
+    index.info.numObjects = serialized.objects.size();
+    impl->objectCounts.resize(serialized.objects.size());
+    for (size_t objID=0;objID<serialized.objects.size();objID++)
+      countActualMeshes(impl->objectCounts[objID],*serialized.objects.list[objID]);
+    countUniqueMeshes(index.info,serialized.meshes);
 
-      io::writeElement(out,obj->meshes.size());
-      for (auto mesh : obj->meshes) {
-        if (!mesh) { io::writeElement(out,int(0)); continue; }
+    // ------------------------------------------------------------------
+    // instances - the count gets patched in by close()
+    // ------------------------------------------------------------------
+    index.instancesOffset = impl->numInstancesOffset = out.tell();
+    io::writeElement(out,size_t(0));
+  }
 
-        io::writeElement(out,int(1));
-        io::writeVector(out,mesh->indices);
-        io::writeVector(out,mesh->vertices);
-        io::writeVector(out,mesh->normals);
-        io::writeVector(out,mesh->texcoords);
-        int matID = serialized.getID(mesh->material);
-        assert(matID >= 0);
-        io::writeElement(out,matID);
-      }
+  SceneWriter::~SceneWriter()
+  {}
+  
+  void SceneWriter::write(const Instance::SP &inst)
+  {
+    if (!inst) {
+      write(affine3f(),-1);
+      return;
     }
+    const int objID = impl ? impl->serialized.getID(inst->object) : -1;
+    if (impl && objID < 0)
+      throw std::runtime_error("SceneWriter: instance refers to an object that was not "
+                               "in the scene the writer was created for");
+    write(inst->xfm,objID);
+  }
+  
+  void SceneWriter::write(const affine3f &xfm, int objID)
+  {
+    if (!impl)
+      throw std::runtime_error("SceneWriter::write() after close()");
+    io::FileWriter &out = impl->out;
+    if (objID < 0) {
+      impl->numInstances++;
+      io::writeElement(out,int(0));
+      if (impl->storeBVHs) impl->instanceBounds.push_back(box3f());
+      return;
+    }
+    if (objID >= (int)impl->serialized.objects.size())
+      throw std::runtime_error("SceneWriter: invalid object ID "+std::to_string(objID));
+    impl->numInstances++;
+    io::writeElement(out,int(1));
+    io::writeElement(out,xfm);
+    io::writeElement(out,objID);
+
+    SceneInfo &info = impl->index.info;
+    addActualMeshes(info,impl->objectCounts[objID]);
+    const box3f instanceBounds
+      = transformedBoxBounds(xfm,impl->index.objectBounds[objID]);
+    info.bounds.extend(instanceBounds);
+    if (impl->storeBVHs)
+      impl->instanceBounds.push_back(instanceBounds);
+  }
+  
+  void SceneWriter::close()
+  {
+    if (!impl)
+      return;
+    io::FileWriter &out = impl->out;
+    out.writeAt(impl->numInstancesOffset,&impl->numInstances,sizeof(size_t));
+    impl->index.info.numInstances = impl->numInstances;
 
     // ------------------------------------------------------------------
-    // instances
+    // BVHs (version 19+): one per object - building the ones that are
+    // missing, in parallel, in batches - and one over all instances.
+    // If meshes get quantized on save, objects' existing BVHs were
+    // built over positions other than those that get written, so
+    // those get rebuilt, over the quantized positions
     // ------------------------------------------------------------------
-    io::writeElement(out,instances.size());
-    for (auto &inst : instances) {
-      if (!inst) { io::writeElement(out,int(0)); continue; }
+    if (impl->storeBVHs) {
+      impl->index.bvhsOffset = out.tell();
+      auto &objects = impl->serialized.objects.list;
+      const size_t batchSize = 256;
+      std::vector<BVH::SP> bvhs;
+      for (size_t batchBegin=0;batchBegin<objects.size();batchBegin+=batchSize) {
+        const size_t batchEnd = std::min(batchBegin+batchSize,objects.size());
+        bvhs.resize(batchEnd-batchBegin);
+        parallel_for
+          (batchEnd-batchBegin,
+           [&](size_t i) {
+             const Object::SP &object = objects[batchBegin+i];
+             bvhs[i]
+               = (object->bvh && !impl->quantizeVertices)
+               ? object->bvh
+               : object->computeBVH(impl->bvhConfig,impl->quantizeVertices);
+           });
+        for (auto &bvh : bvhs)
+          writeBVH(out,*bvh);
+      }
+      writeBVH(out,*BVH::build(impl->instanceBounds,impl->bvhConfig));
+      impl->instanceBounds.clear();
+    }
 
-      io::writeElement(out,int(1));
-      io::writeElement(out,inst->xfm);
-      io::writeElement(out,int(serialized.getID(inst->object)));
+    // ------------------------------------------------------------------
+    // meshlets (version 20+), if any mesh has them: one record per
+    // mesh, in the same order as the meshes' records
+    // ------------------------------------------------------------------
+    bool anyMeshlets = false;
+    for (auto &mesh : impl->serialized.meshes.list)
+      anyMeshlets |= (bool)mesh->meshlets;
+    if (anyMeshlets) {
+      impl->index.meshletsOffset = out.tell();
+      for (auto &object : impl->serialized.objects.list)
+        for (auto &mesh : object->meshes)
+          writeMeshlets(out,mesh);
     }
-      
+    
+    // ------------------------------------------------------------------
+    // packed material table (version 21+), if asked for; texture IDs
+    // in there don't count the null texture the file's list of
+    // textures starts with
+    // ------------------------------------------------------------------
+    if (impl->storeMaterialTable) {
+      impl->index.materialTableOffset = out.tell();
+      const std::vector<Texture::SP> &textures = impl->serialized.textures.list;
+      io::writeVector(out,packMaterials(impl->serialized.materials.list,
+                                        {textures.begin()+1,textures.end()}));
+    }
+    
     // ------------------------------------------------------------------
     // proxies and owner masks
     // ------------------------------------------------------------------
     // io::writeVector(out,proxies);
     // io::writeVector(out,ownedOn);
 
+    // ------------------------------------------------------------------
+    // section offset table (version 13+)
+    // ------------------------------------------------------------------
+    size_t indexOffset = out.tell();
+    impl->index.write(out);
+    io::writeElement(out,indexOffset);
+    
     // ------------------------------------------------------------------
     // wrap-up: write end-of file marker
     // ------------------------------------------------------------------
     io::writeElement(out,expected_magic);
-    if (!out.good())
-      throw std::runtime_error("some error happened while writing '"+baseName+"'");
+    out.close();
+    impl.reset();
   }
-    
-  Scene::SP Scene::load(const std::string &baseName)
+  
+  void Scene::save(const std::string &baseName, const SaveOptions &options)
   {
-    std::ifstream in(baseName,std::ios::binary);
-    if (!in.good())
-      throw std::runtime_error("could not open Scene{"+baseName+"}");
-    Scene::SP scene = std::make_shared<Scene>();
+    // (on a single core, writing in the background would only add
+    // overhead)
+    SceneWriter writer(baseName,this,options,std::thread::hardware_concurrency() > 1);
+    writer.close();
+  }
 
-    size_t magic = io::readElement<size_t>(in);
-    int format_version = 12;
-    if (magic == expected_magic) {
-      // all good, this is our format we'd also write
-    } else if (magic == expected_magic-1) {
-      // version 11 - old mini::Material handling - we should still be able to read this.
-      format_version = 11;
-    } else
+  std::future<void> Scene::saveAsync(const std::string &fileName,
+                                     const SaveOptions &options)
+  {
+    // the snapshot holds references to all objects (and thus all
+    // meshes, materials, and textures), so whatever happens to this
+    // scene those will stay alive until saving is done
+    Scene::SP snapshot = std::make_shared<Scene>(*this);
+    return std::async(std::launch::async,
+                      [snapshot,fileName,options]() {
+                        SceneWriter writer(fileName,snapshot.get(),options,true);
+                        writer.close();
+                      });
+  }
+
+  /*! checks the file magic, and returns the file's format version */
+  int formatVersionOf(size_t magic)
+  {
+    const size_t base_magic = expected_magic-FORMAT_VERSION;
+    if (magic < base_magic+11 || magic > expected_magic)
       throw std::runtime_error("invalid or incompatible 'mini' scene file (wrong file magic) - cannot load");
+    return int(magic-base_magic);
+  }
+  
+  /*! reads a single texture record (incl 'valid' flag); returns a
+      null texture if not valid */
+  template<typename Reader>
+  Texture::SP readTexture(Reader &in, int format_version,
+                          const Arena::SP &arena = {})
+  {
+    int valid;
+    io::readElement(in,valid);
+    if (!valid)
+      return {};
       
-    // ------------------------------------------------------------------
-    // textures
-    // ------------------------------------------------------------------
-    std::vector<Texture::SP> textures;
-    size_t numTextures = io::readElement<size_t>(in);
-    for (int i=0;i<numTextures;i++) {
-      // if (i==0)
-      //   textures.push_back(0); // first one is always 0
-      // else {
-      int valid;
-      io::readElement(in,valid);
-      if (!valid) {
-        textures.push_back({});
-      } else {
-        Texture::SP tex = std::make_shared<Texture>();
-        io::readElement(in,tex->size);
-        io::readElement(in,tex->format);
-        io::readElement(in,tex->filterMode);
-        io::readVector(in,tex->data);
-        textures.push_back(tex);
-      }
-    }
-
-    // ------------------------------------------------------------------
-    // lights
-    // ------------------------------------------------------------------
+    Texture::SP tex = makeShared<Texture>(arena);
+    io::readElement(in,tex->size);
+    io::readElement(in,tex->format);
+    io::readElement(in,tex->filterMode);
+    readArrayData(in,tex->data,format_version);
+    return tex;
+  }
+  
+  template<typename Reader>
+  void readLights(Reader &in, Scene::SP scene)
+  {
     io::readVector(in,scene->quadLights);
     io::readVector(in,scene->dirLights);
     const int hasEnvMap = io::readElement<int>(in);
@@ -617,10 +1517,15 @@ namespace mini {
       io::readElement(in,tex->filterMode);
       io::readVector(in,tex->data);
     }
-    
-    // ------------------------------------------------------------------
-    // materials
-    // ------------------------------------------------------------------
+  }
+  
+  /*! reads the list of all materials (incl. each material's type
+      tag) from a std::istream */
+  std::vector<Material::SP> readMaterials(std::istream &in,
+                                          int format_version,
+                                          const std::vector<Texture::SP> &textures,
+                                          const Arena::SP &arena = {})
+  {
     std::vector<Material::SP> materials;
     size_t numMaterials = io::readElement<size_t>(in);
     for (int i=0;i<numMaterials;i++) {
@@ -629,10 +1534,10 @@ namespace mini {
       int tag;
       if (format_version == 11)
         // "DISNEY" is the direct equivalent to whatever we had before version 11
-        tag = DISNEY;
+        tag = Material::DISNEY;
       else
         io::readElement(in,tag);
-      Material::SP mat = createMaterialFromTag((MaterialTag)tag);
+      Material::SP mat = createMaterialFromTag(tag,arena);
       mat->read(in,textures);
 #else
       Material::SP mat = std::make_shared<Material>();
@@ -657,6 +1562,207 @@ namespace mini {
 #endif
       materials.push_back(mat);
     }
+    return materials;
+  }
+
+  /*! reads the list of all materials from memory; since materials
+      can only read themselves from a std::istream we wrap the
+      remaining memory range into such a stream, and afterwards skip
+      over whatever got consumed */
+  std::vector<Material::SP> readMaterials(io::MemoryReader &in,
+                                          int format_version,
+                                          const std::vector<Texture::SP> &textures,
+                                          const Arena::SP &arena = {})
+  {
+    io::MemoryStreamBuf buf(in.ptr,in.end);
+    std::istream stream(&buf);
+    std::vector<Material::SP> materials
+      = readMaterials(stream,format_version,textures,arena);
+    in.skip((size_t)stream.tellg());
+    return materials;
+  }
+
+  /*! reads the arrays of a (non-null) mesh record with given flag;
+      ie, everything between the flag and the material ID */
+  template<typename Reader>
+  void readMeshArrays(Reader &in, Mesh &mesh, int flag,
+                      int format_version, const LoadOptions &options)
+  {
+    if (flag == MESH_QUANTIZED && format_version >= 16) {
+      readIndices(in,mesh,format_version,options);
+      io::readElement(in,mesh.quantized.domain);
+      readDataBlock(in,mesh.quantized.vertices);
+      readDataBlock(in,mesh.quantized.normals);
+      readDataBlock(in,mesh.quantized.texcoords);
+      if (!options.keepQuantized)
+        mesh.dequantize();
+    } else if (flag == MESH_FULL) {
+      readIndices(in,mesh,format_version,options);
+      readArrayData(in,mesh.vertices,format_version);
+      readArrayData(in,mesh.normals,format_version);
+      readArrayData(in,mesh.texcoords,format_version);
+    } else
+      throw std::runtime_error("invalid mesh record in miniScene/.mini file");
+  }
+
+  /*! skips over an array written by writeDataBlock() (or, before
+      version 15, by writeVector()); returns its number of elements */
+  template<typename T, typename Reader>
+  size_t skipArrayData(Reader &in, int format_version)
+  {
+    const size_t N = io::readElement<size_t>(in);
+    if (format_version < 15) {
+      in.skip(N*sizeof(T));
+      return N;
+    }
+    const compression::BlockHeader header
+      = io::readElement<compression::BlockHeader>(in);
+    if (header.codec == compression::NONE)
+      in.skip(N*sizeof(T));
+    else
+      in.skip(io::readElement<size_t>(in));
+    return N;
+  }
+
+  /*! skips over the arrays of a (non-null) mesh record, only
+      recording its number of triangles and vertices */
+  template<typename Reader>
+  void skipMeshArrays(Reader &in, MeshPayload &payload, int flag,
+                      int format_version)
+  {
+    if (flag != MESH_FULL && !(flag == MESH_QUANTIZED && format_version >= 16))
+      throw std::runtime_error("invalid mesh record in miniScene/.mini file");
+    if (format_version < 17 || io::readElement<int>(in) == 4)
+      payload.numPrims = skipArrayData<vec3i>(in,format_version);
+    else
+      payload.numPrims = skipArrayData<vec3us>(in,format_version);
+    if (flag == MESH_QUANTIZED) {
+      io::readElement<box3f>(in);
+      payload.numVertices  = skipArrayData<vec3us>(in,format_version);
+      payload.numNormals   = skipArrayData<uint32_t>(in,format_version);
+      payload.numTexcoords = skipArrayData<vec2us>(in,format_version);
+    } else {
+      payload.numVertices  = skipArrayData<vec3f>(in,format_version);
+      payload.numNormals   = skipArrayData<vec3f>(in,format_version);
+      payload.numTexcoords = skipArrayData<vec2f>(in,format_version);
+    }
+  }
+  
+  /*! reads a single mesh record (incl 'valid' flag); returns a null
+      mesh if not valid */
+  template<typename Reader>
+  Mesh::SP readMesh(Reader &in, const std::vector<Material::SP> &materials,
+                    int format_version, const LoadOptions &options = LoadOptions())
+  {
+    int flag = io::readElement<int>(in);
+    if (flag == MESH_NULL)
+      return {};
+    
+    Mesh::SP mesh = makeShared<Mesh>(options.arena);
+    readMeshArrays(in,*mesh,flag,format_version,options);
+    int matID = io::readElement<int>(in);
+    assert(matID >= 0);
+    assert(matID < materials.size());
+    mesh->material = materials[matID];
+    return mesh;
+  }
+
+  /*! a mesh payload that re-reads a mesh record at a given offset of
+      a (version 13+) file */
+  template<typename Source>
+  struct FileMeshPayload : public MeshPayload {
+    FileMeshPayload(const Source &source, size_t offset,
+                    int format_version, const LoadOptions &options)
+      : source(source), offset(offset),
+        format_version(format_version), options(options)
+    {}
+
+    void read(Mesh &mesh) const override
+    {
+      auto in = source.readerAt(offset);
+      const int flag = io::readElement<int>(in);
+      readMeshArrays(in,mesh,flag,format_version,options);
+    }
+
+    const Source      source;
+    const size_t      offset;
+    const int         format_version;
+    const LoadOptions options;
+  };
+  
+  /*! same as readMesh(), but only creates a lazily loaded mesh (see
+      LoadOptions::lazyMeshes) that can later read its arrays from
+      the given offset of the given source */
+  template<typename Source>
+  Mesh::SP readMeshLazily(const Source &source, size_t offset,
+                          const std::vector<Material::SP> &materials,
+                          int format_version, const LoadOptions &options)
+  {
+    auto in = source.readerAt(offset,4*1024);
+    int flag = io::readElement<int>(in);
+    if (flag == MESH_NULL)
+      return {};
+
+    std::shared_ptr<MeshPayload> payload
+      = std::make_shared<FileMeshPayload<Source>>(source,offset,format_version,options);
+    skipMeshArrays(in,*payload,flag,format_version);
+    int matID = io::readElement<int>(in);
+    assert(matID >= 0);
+    assert(matID < materials.size());
+    Mesh::SP mesh = makeShared<Mesh>(options.arena,materials[matID]);
+    mesh->lazy.payload = payload;
+    mesh->lazy.resident.store(false);
+    return mesh;
+  }
+  
+  template<typename Reader>
+  void readInstances(Reader &in, Scene::SP scene,
+                     const std::vector<Object::SP> &objects,
+                     const Arena::SP &arena = {})
+  {
+    size_t numInstances = io::readElement<size_t>(in);
+    scene->instances.reserve(numInstances);
+    for (size_t instID=0;instID<numInstances;instID++) {
+      int isValid = io::readElement<int>(in);
+      if (!isValid) {
+        scene->instances.push_back(0);
+        continue;
+      }
+      Instance::SP inst = makeShared<Instance>(arena);
+      io::readElement(in,inst->xfm);
+      inst->object = objects[io::readElement<int>(in)];
+      scene->instances.push_back(inst);
+    }
+  }
+  
+  /*! sequential scene loader for old (version <= 12) files that do
+      not have a section offset table; templated over the kind of
+      reader we read from */
+  template<typename Reader>
+  Scene::SP loadSequential(Reader &in, int format_version,
+                           const LoadOptions &options)
+  {
+    Scene::SP scene = std::make_shared<Scene>();
+    const size_t magic = io::readElement<size_t>(in);
+      
+    // ------------------------------------------------------------------
+    // textures
+    // ------------------------------------------------------------------
+    std::vector<Texture::SP> textures;
+    size_t numTextures = io::readElement<size_t>(in);
+    for (int i=0;i<numTextures;i++)
+      textures.push_back(readTexture(in,format_version,options.arena));
+
+    // ------------------------------------------------------------------
+    // lights
+    // ------------------------------------------------------------------
+    readLights(in,scene);
+    
+    // ------------------------------------------------------------------
+    // materials
+    // ------------------------------------------------------------------
+    std::vector<Material::SP> materials
+      = readMaterials(in,format_version,textures,options.arena);
 
     // ------------------------------------------------------------------
     // objects and meshes
@@ -665,23 +1771,12 @@ namespace mini {
     std::vector<Object::SP> objects;
     for (int objID=0;objID<numObjects;objID++) {
       size_t numMeshes = io::readElement<size_t>(in);
-      Object::SP object = std::make_shared<Object>();
+      Object::SP object = makeShared<Object>(options.arena);
 
       for (int meshID=0;meshID<(int)numMeshes;meshID++) {
-        int isValid = io::readElement<int>(in);
-        if (!isValid) {
-          continue;
-        }
-        Mesh::SP mesh = std::make_shared<Mesh>();
-        io::readVector(in,mesh->indices);
-        io::readVector(in,mesh->vertices);
-        io::readVector(in,mesh->normals);
-        io::readVector(in,mesh->texcoords);
-        int matID = io::readElement<int>(in);
-        assert(matID >= 0);
-        assert(matID < materials.size());
-        mesh->material = materials[matID];
-        object->meshes.push_back(mesh);
+        Mesh::SP mesh = readMesh(in,materials,format_version,options);
+        if (mesh)
+          object->meshes.push_back(mesh);
       }
       objects.push_back(object);
     }
@@ -689,32 +1784,412 @@ namespace mini {
     // ------------------------------------------------------------------
     // instances
     // ------------------------------------------------------------------
-    size_t numInstances = io::readElement<size_t>(in);
-    for (int instID=0;instID<numInstances;instID++) {
-      int isValid = io::readElement<int>(in);
-      if (!isValid) {
-        scene->instances.push_back(0);
-        continue;
-      }
-      Instance::SP inst = std::make_shared<Instance>();
-      io::readElement(in,inst->xfm);
-      inst->object = objects[io::readElement<int>(in)];
-      scene->instances.push_back(inst);
-    }
+    readInstances(in,scene,objects,options.arena);
 
     // ------------------------------------------------------------------
     // wrap-up
     // ------------------------------------------------------------------
 
     size_t magicAtEnd = io::readElement<size_t>(in);
-    if (magicAtEnd != expected_magic
-        &&
-        magicAtEnd != (expected_magic-1)
-        )
+    if (magicAtEnd != magic)
       throw std::runtime_error("incomplete or incompatible miniScene/.mini file - cannot load");
       
     return scene;
   }
 
-} // ::brix
+  /*! a file to read an indexed (version 13+) file from through
+      positional reads, from any number of threads */
+  struct PositionalSource {
+    PositionalSource(const std::string &fileName)
+      : file(io::RandomAccessFile::open(fileName))
+    {}
+    
+    inline size_t size() const { return file->size(); }
+    inline io::FileReader readerAt(size_t offset, size_t bufferSize=64*1024) const
+    { return io::FileReader(file,offset,bufferSize); }
+    
+    io::RandomAccessFile::SP file;
+  };
+  
+  /*! reads (and checks) the trailer of an indexed (version 13+)
+      file, and returns the offset of its section offset table */
+  template<typename Source>
+  size_t indexOffsetOf(const Source &source)
+  {
+    if (source.size() < 3*sizeof(size_t))
+      throw std::runtime_error("incomplete or incompatible miniScene/.mini file - cannot load");
+    auto in = source.readerAt(0,sizeof(size_t));
+    const size_t magic = io::readElement<size_t>(in);
+      
+    auto trailer = source.readerAt(source.size()-2*sizeof(size_t),2*sizeof(size_t));
+    const size_t indexOffset = io::readElement<size_t>(trailer);
+    const size_t magicAtEnd  = io::readElement<size_t>(trailer);
+    if (magicAtEnd != magic || indexOffset >= source.size())
+      throw std::runtime_error("incomplete or incompatible miniScene/.mini file - cannot load");
+    return indexOffset;
+  }
+  
+  /*! loads everything but the instances of a (version 13+) file
+      that has a section offset table, which allows for reading all
+      textures and meshes in parallel; returns a scene with only the
+      lights, plus the file's section offset table and objects */
+  template<typename Source>
+  Scene::SP loadIndexedObjects(const Source &source, int format_version,
+                               const LoadOptions &options,
+                               FileIndex &index,
+                               std::vector<Object::SP> &objects)
+  {
+    Scene::SP scene = std::make_shared<Scene>();
+
+    // ------------------------------------------------------------------
+    // file trailer and section offset table
+    // ------------------------------------------------------------------
+    {
+      auto indexReader = source.readerAt(indexOffsetOf(source));
+      index.read(indexReader,format_version);
+    }
+    
+    // ------------------------------------------------------------------
+    // textures - in parallel
+    // ------------------------------------------------------------------
+    std::vector<Texture::SP> textures(index.textureOffsets.size());
+    parallel_for
+      (textures.size(),
+       [&](size_t texID) {
+         auto in = source.readerAt(index.textureOffsets[texID]);
+         textures[texID] = readTexture(in,format_version,options.arena);
+       });
+
+    // ------------------------------------------------------------------
+    // lights
+    // ------------------------------------------------------------------
+    {
+      auto in = source.readerAt(index.lightsOffset);
+      readLights(in,scene);
+    }
+    
+    // ------------------------------------------------------------------
+    // materials
+    // ------------------------------------------------------------------
+    std::vector<Material::SP> materials;
+    {
+      if (index.objectsOffset < index.materialsOffset)
+        throw std::runtime_error("corrupt section offset table in miniScene/.mini file");
+      std::vector<uint8_t> bytes(index.objectsOffset-index.materialsOffset);
+      source.readerAt(index.materialsOffset).read(bytes.data(),bytes.size());
+      io::MemoryReader in(bytes.data(),bytes.data()+bytes.size());
+      materials = readMaterials(in,format_version,textures,options.arena);
+    }
+
+    // ------------------------------------------------------------------
+    // meshes - in parallel - and objects
+    // ------------------------------------------------------------------
+    std::vector<Mesh::SP> meshes(index.meshOffsets.size());
+    parallel_for
+      (meshes.size(),
+       [&](size_t meshID) {
+         if (options.lazyMeshes)
+           meshes[meshID] = readMeshLazily(source,index.meshOffsets[meshID],
+                                           materials,format_version,options);
+         else {
+           auto in = source.readerAt(index.meshOffsets[meshID],4*1024);
+           meshes[meshID] = readMesh(in,materials,format_version,options);
+         }
+         if (meshes[meshID] && meshID < index.meshBounds.size())
+           meshes[meshID]->cachedBounds.set(index.meshBounds[meshID]);
+       });
+    if (index.meshletsOffset && options.readMeshlets) {
+      auto in = source.readerAt(index.meshletsOffset,1<<20);
+      for (auto &mesh : meshes) {
+        Meshlets::SP meshlets = readMeshlets(in);
+        if (mesh) mesh->meshlets = meshlets;
+      }
+    }
+    
+    if (index.objectMeshBegin.empty())
+      throw std::runtime_error("corrupt section offset table in miniScene/.mini file");
+    const size_t numObjects = index.objectMeshBegin.size()-1;
+    objects.resize(numObjects);
+    for (size_t objID=0;objID<numObjects;objID++) {
+      Object::SP object = makeShared<Object>(options.arena);
+      for (size_t i=index.objectMeshBegin[objID];i<index.objectMeshBegin[objID+1];i++)
+        if (meshes[i])
+          object->meshes.push_back(meshes[i]);
+      if (objID < index.objectBounds.size())
+        object->cachedBounds.set(index.objectBounds[objID]);
+      objects[objID] = object;
+    }
+    return scene;
+  }
+  
+  /*! scene loader for (version 13+) files that have a section offset
+      table */
+  template<typename Source>
+  Scene::SP loadIndexed(const Source &source, int format_version,
+                        const LoadOptions &options)
+  {
+    FileIndex index;
+    std::vector<Object::SP> objects;
+    Scene::SP scene
+      = loadIndexedObjects(source,format_version,options,index,objects);
+    auto in = source.readerAt(index.instancesOffset,1<<20);
+    readInstances(in,scene,objects,options.arena);
+
+    if (index.bvhsOffset && options.readBVHs) {
+      auto in = source.readerAt(index.bvhsOffset,1<<20);
+      for (auto &object : objects)
+        object->bvh = readBVH(in);
+      scene->bvh = readBVH(in);
+    }
+    return scene;
+  }
+
+  /*! returns a copy of the given load options in which 'arena' is
+      the one the loader should allocate from: a new one if the
+      options ask for an arena but do not provide one, and none at
+      all if they do not ask for one */
+  LoadOptions withArena(const LoadOptions &options)
+  {
+    LoadOptions result = options;
+    if (!result.useArena)
+      result.arena = nullptr;
+    else if (!result.arena)
+      result.arena = Arena::create();
+    return result;
+  }
+  
+  Scene::SP Scene::load(const std::string &baseName,
+                        const LoadOptions &_options)
+  {
+    const LoadOptions options = withArena(_options);
+    int format_version;
+    {
+      std::ifstream in(baseName,std::ios::binary);
+      if (!in.good())
+        throw std::runtime_error("could not open Scene{"+baseName+"}");
+      format_version = formatVersionOf(io::readElement<size_t>(in));
+    }
+    if (format_version >= 13)
+      return loadIndexed(PositionalSource(baseName),format_version,options);
+    std::ifstream in(baseName,std::ios::binary);
+    return loadSequential(in,format_version,options);
+  }
+
+  FlatScene::SP FlatScene::load(const std::string &fileName,
+                                const LoadOptions &_options)
+  {
+    const LoadOptions options = withArena(_options);
+    PositionalSource source(fileName);
+    int format_version;
+    {
+      auto in = source.readerAt(0,sizeof(size_t));
+      format_version = formatVersionOf(io::readElement<size_t>(in));
+    }
+    if (format_version < 13)
+      return fromScene(Scene::load(fileName,options).get());
+
+    FileIndex index;
+    std::vector<Object::SP> objects;
+    Scene::SP lights
+      = loadIndexedObjects(source,format_version,options,index,objects);
+    FlatScene::SP flat = fromObjects(objects);
+    flat->quadLights  = lights->quadLights;
+    flat->dirLights   = lights->dirLights;
+    flat->envMapLight = lights->envMapLight;
+
+    // read the instances straight into the flat arrays
+    auto in = source.readerAt(index.instancesOffset,1<<20);
+    const size_t numInstances = io::readElement<size_t>(in);
+    flat->instanceXfms.resize(numInstances);
+    flat->instanceObjects.resize(numInstances);
+    for (size_t instID=0;instID<numInstances;instID++) {
+      if (!io::readElement<int>(in)) {
+        flat->instanceXfms[instID]    = affine3f();
+        flat->instanceObjects[instID] = -1;
+        continue;
+      }
+      io::readElement(in,flat->instanceXfms[instID]);
+      const int objectID = io::readElement<int>(in);
+      if (objectID < 0 || objectID >= (int)objects.size())
+        throw std::runtime_error("invalid object ID in miniScene/.mini file");
+      flat->instanceObjects[instID] = objectID;
+    }
+    return flat;
+  }
+
+  std::vector<PackedMaterial> loadMaterialTable(const std::string &fileName)
+  {
+    PositionalSource source(fileName);
+    auto in = source.readerAt(0,sizeof(size_t));
+    const int format_version = formatVersionOf(io::readElement<size_t>(in));
+    std::vector<PackedMaterial> table;
+    if (format_version < 21)
+      return table;
+    FileIndex index;
+    {
+      auto indexReader = source.readerAt(indexOffsetOf(source));
+      index.read(indexReader,format_version);
+    }
+    if (index.materialTableOffset) {
+      auto tableReader = source.readerAt(index.materialTableOffset);
+      io::readVector(tableReader,table);
+    }
+    return table;
+  }
+  
+  SceneInfo Scene::peekInfo(const std::string &fileName)
+  {
+    PositionalSource source(fileName);
+    auto in = source.readerAt(0,sizeof(size_t));
+    const int format_version = formatVersionOf(io::readElement<size_t>(in));
+    if (format_version >= 18) {
+      auto indexReader = source.readerAt(indexOffsetOf(source),SCENE_INFO_SIZE);
+      return readSceneInfo(indexReader,format_version);
+    }
+    if (format_version >= 13) {
+      LoadOptions options;
+      options.lazyMeshes = true;
+      return loadIndexed(source,format_version,options)->getInfo();
+    }
+    return load(fileName)->getInfo();
+  }
+
+  // ==================================================================
+  // SceneReader
+  // ==================================================================
+
+  /*! bytes of memory taken by a (resident) mesh's arrays */
+  inline size_t residentBytesOf(const Mesh &mesh)
+  {
+    return mesh.indices.size()*sizeof(mesh.indices[0])
+      + mesh.indices16.size()*sizeof(mesh.indices16[0])
+      + mesh.vertices.size()*sizeof(mesh.vertices[0])
+      + mesh.normals.size()*sizeof(mesh.normals[0])
+      + mesh.texcoords.size()*sizeof(mesh.texcoords[0])
+      + mesh.quantized.numBytes();
+  }
+  
+  struct SceneReader::Impl {
+    /*! makes all meshes of the given object resident, and evicts the
+        least recently used other ones while we are over budget */
+    void makeResident(const Object &object)
+    {
+      // the (distinct) meshes this call moved to the front of 'lru';
+      // null meshes and meshes that weren't loaded lazily never are
+      // in 'lru', and a mesh the object uses more than once only
+      // takes one entry there
+      std::unordered_set<const Mesh *> touched;
+      for (auto &mesh : object.meshes) {
+        if (!mesh) continue;
+        auto it = residentMeshes.find(mesh.get());
+        if (it != residentMeshes.end()) {
+          lru.splice(lru.begin(),lru,it->second);
+          touched.insert(mesh.get());
+          continue;
+        }
+        if (!mesh->lazy.payload) continue;
+        mesh->ensureLoaded();
+        residentBytes += residentBytesOf(*mesh);
+        lru.push_front(mesh);
+        residentMeshes[mesh.get()] = lru.begin();
+        touched.insert(mesh.get());
+      }
+      // evict from the back, but never the meshes we just made
+      // resident (which are at the front)
+      const size_t numKept = touched.size();
+      while (residentBytes > maxResidentBytes && lru.size() > numKept) {
+        Mesh::SP victim = lru.back();
+        lru.pop_back();
+        residentMeshes.erase(victim.get());
+        residentBytes -= std::min(residentBytes,residentBytesOf(*victim));
+        victim->evict();
+      }
+    }
+    
+    Scene::SP               lights;
+    std::vector<Object::SP> objects;
+    size_t                  numInstances = 0;
+    size_t                  numInstancesRead = 0;
+    /*! reads the instance records (null for old files, for which we
+        hand out the already-loaded 'fullyLoaded' scene's instances) */
+    std::unique_ptr<io::FileReader> instanceReader;
+    Scene::SP               fullyLoaded;
+    
+    const size_t            maxResidentBytes;
+    size_t                  residentBytes = 0;
+    /*! resident meshes, most recently used first */
+    std::list<Mesh::SP>     lru;
+    std::unordered_map<const Mesh *,std::list<Mesh::SP>::iterator> residentMeshes;
 
+    Impl(size_t maxResidentBytes) : maxResidentBytes(maxResidentBytes) {}
+  };
+
+  SceneReader::SceneReader(const std::string &fileName,
+                           size_t maxResidentBytes,
+                           const LoadOptions &_options)
+    : impl(new Impl(maxResidentBytes))
+  {
+    PositionalSource source(fileName);
+    auto in = source.readerAt(0,sizeof(size_t));
+    const int format_version = formatVersionOf(io::readElement<size_t>(in));
+    if (format_version < 13) {
+      impl->fullyLoaded = Scene::load(fileName,_options);
+      impl->lights = std::make_shared<Scene>();
+      impl->lights->quadLights  = impl->fullyLoaded->quadLights;
+      impl->lights->dirLights   = impl->fullyLoaded->dirLights;
+      impl->lights->envMapLight = impl->fullyLoaded->envMapLight;
+      SerializedScene serialized(impl->fullyLoaded.get());
+      impl->objects = serialized.objects.list;
+      impl->numInstances = impl->fullyLoaded->instances.size();
+      return;
+    }
+    
+    LoadOptions options = withArena(_options);
+    options.lazyMeshes = true;
+    FileIndex index;
+    impl->lights = loadIndexedObjects(source,format_version,options,
+                                      index,impl->objects);
+    impl->instanceReader.reset
+      (new io::FileReader(source.file,index.instancesOffset,1<<20));
+    impl->numInstances = io::readElement<size_t>(*impl->instanceReader);
+  }
+
+  SceneReader::~SceneReader()
+  {}
+  
+  Scene::SP SceneReader::getLights() const
+  { return impl->lights; }
+
+  const std::vector<Object::SP> &SceneReader::getObjects() const
+  { return impl->objects; }
+  
+  size_t SceneReader::getNumInstances() const
+  { return impl->numInstances; }
+
+  bool SceneReader::next(Instance::SP &instance)
+  {
+    if (impl->numInstancesRead >= impl->numInstances)
+      return false;
+    const size_t instID = impl->numInstancesRead++;
+    if (impl->fullyLoaded) {
+      instance = impl->fullyLoaded->instances[instID];
+      return true;
+    }
+    
+    io::FileReader &in = *impl->instanceReader;
+    int isValid = io::readElement<int>(in);
+    if (!isValid) {
+      instance = nullptr;
+      return true;
+    }
+    instance = std::make_shared<Instance>();
+    io::readElement(in,instance->xfm);
+    const int objID = io::readElement<int>(in);
+    if (objID < 0 || objID >= (int)impl->objects.size())
+      throw std::runtime_error("invalid object ID in miniScene/.mini file");
+    instance->object = impl->objects[objID];
+    impl->makeResident(*instance->object);
+    return true;
+  }
+  
+} // ::brix
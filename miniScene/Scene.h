@@ -17,6 +17,14 @@
 #pragma once
 
 #include "miniScene/common.h"
+#include "miniScene/Arena.h"
+#include "miniScene/Compression.h"
+#include "miniScene/Quantization.h"
+#include "miniScene/BVH.h"
+#include "miniScene/Meshlets.h"
+#include <atomic>
+#include <mutex>
+#include <future>
 
 namespace mini {
     
@@ -65,28 +73,68 @@ namespace mini {
     std::vector<uint8_t> data;
   };
 
+  /*! registry of serial IDs for a given kind of object (see
+      miniScene/Serialized.h); materials use this to look up their
+      textures' IDs when writing themselves */
+  template<typename T> struct Serialized;
+  
   struct Material : public std::enable_shared_from_this<Material> {
     typedef std::shared_ptr<Material> SP;
 
+    /*! the actual type of a material, which every material stores
+        (see getType()), so code can tell material types apart
+        without RTTI. These values also are the type tags materials
+        get stored with in .mini files, so must never change */
+    typedef enum {
+      /*! a material type miniScene doesn't know about (which
+          cannot get saved) */
+      INVALID=0,
+      DISNEY,
+      MATTE,
+      PLASTIC,
+      METAL,
+      VELVET,
+      METALLICPAINT,
+      THINGLASS,
+      DIELECTRIC,
+      BLENDER
+    } Type;
+    
     /*! constructs a new Material - note you _probably_ want to use
         Material::create() instead */
-    Material() = default;
+    Material(Type type = INVALID) : type(type) {}
 
     virtual std::string toString() const = 0;
     
-    virtual void write(std::ofstream &out,
-                       const std::map<Texture::SP,int> &textures) = 0;
-    virtual void read(std::ifstream &in,
+    virtual void write(std::ostream &out,
+                       const Serialized<Texture::SP> &textures) = 0;
+    virtual void read(std::istream &in,
                       const std::vector<Texture::SP> &textures) = 0;
     virtual Material::SP clone() const = 0;
 
+    /*! returns this material's actual type */
+    inline Type getType() const { return type; }
+
+    /*! returns whether this material is an 'ActualMaterial' (which
+        has to be one of the material types below) */
+    template<typename ActualMaterial>
+    inline bool is() const { return type == ActualMaterial::TYPE; }
+    
+    /*! returns this material as an 'ActualMaterial' (which has to be
+        one of the material types below), or null if it isn't one */
     template<typename ActualMaterial>
     inline std::shared_ptr<ActualMaterial> as() 
-    { return std::dynamic_pointer_cast<ActualMaterial>(shared_from_this()); }
+    {
+      if (!is<ActualMaterial>()) return {};
+      return std::static_pointer_cast<ActualMaterial>(shared_from_this());
+    }
     
     /*! constructs a new Material - note you _probably_ want to use
         Material::create() instead */
     Material(const Material &) = default;
+
+  private:
+    Type type;
   };
     
   /* blender style principled material - currently filled in with
@@ -94,10 +142,11 @@ namespace mini {
      source code says its material is based off blender's */
   struct BlenderMaterial : public Material {
     typedef std::shared_ptr<BlenderMaterial> SP;
+    static const Type TYPE = BLENDER;
 
     /*! constructs a new Material - note you _probably_ want to use
       Material::create() instead */
-    BlenderMaterial() = default;
+    BlenderMaterial() : Material(TYPE) {}
     
     /*! constructs a new Material - note you _probably_ want to use
       Material::create() instead */
@@ -110,9 +159,9 @@ namespace mini {
     /*! constructs a new Material that is a identical clone of the
       current material */
     Material::SP clone() const override { return std::make_shared<BlenderMaterial>(*this); }
-    void write(std::ofstream &out,
-               const std::map<Texture::SP,int> &textures) override;
-    void read(std::ifstream &in,
+    void write(std::ostream &out,
+               const Serialized<Texture::SP> &textures) override;
+    void read(std::istream &in,
               const std::vector<Texture::SP> &textures) override;
     std::string toString() const override { return "BlenderMaterial"; }
     
@@ -147,10 +196,11 @@ namespace mini {
      models */
   struct DisneyMaterial : public Material {
     typedef std::shared_ptr<DisneyMaterial> SP;
+    static const Type TYPE = DISNEY;
 
     /*! constructs a new Material - note you _probably_ want to use
         Material::create() instead */
-    DisneyMaterial() = default;
+    DisneyMaterial() : Material(TYPE) {}
     
     /*! constructs a new Material - note you _probably_ want to use
         Material::create() instead */
@@ -163,9 +213,9 @@ namespace mini {
     /*! constructs a new Material that is a identical clone of the
         current material */
     Material::SP clone() const override { return std::make_shared<DisneyMaterial>(*this); }
-    void write(std::ofstream &out,
-               const std::map<Texture::SP,int> &textures) override;
-    void read(std::ifstream &in,
+    void write(std::ostream &out,
+               const Serialized<Texture::SP> &textures) override;
+    void read(std::istream &in,
               const std::vector<Texture::SP> &textures) override;
     std::string toString() const override { return "DisneyMaterial"; }
     
@@ -200,10 +250,11 @@ namespace mini {
 
   struct Plastic : public Material {
     typedef std::shared_ptr<Plastic> SP;
+    static const Type TYPE = PLASTIC;
 
     /*! constructs a new Material - note you _probably_ want to use
         Material::create() instead */
-    Plastic() = default;
+    Plastic() : Material(TYPE) {}
     
     /*! constructs a new Material - note you _probably_ want to use
         Material::create() instead */
@@ -216,9 +267,9 @@ namespace mini {
     /*! constructs a new Material that is a identical clone of the
         current material */
     Material::SP clone() const override { return std::make_shared<Plastic>(*this); }
-    void write(std::ofstream &out,
-               const std::map<Texture::SP,int> &textures) override;
-    void read(std::ifstream &in,
+    void write(std::ostream &out,
+               const Serialized<Texture::SP> &textures) override;
+    void read(std::istream &in,
               const std::vector<Texture::SP> &textures) override;
     std::string toString() const override { return "Plastic"; }
 
@@ -231,10 +282,11 @@ namespace mini {
 
   struct Metal : public Material {
     typedef std::shared_ptr<Metal> SP;
+    static const Type TYPE = METAL;
 
     /*! constructs a new Material - note you _probably_ want to use
         Material::create() instead */
-    Metal() = default;
+    Metal() : Material(TYPE) {}
     
     /*! constructs a new Material - note you _probably_ want to use
         Material::create() instead */
@@ -247,9 +299,9 @@ namespace mini {
     /*! constructs a new Material that is a identical clone of the
         current material */
     Material::SP clone() const override { return std::make_shared<Metal>(*this); }
-    void write(std::ofstream &out,
-               const std::map<Texture::SP,int> &textures) override;
-    void read(std::ifstream &in,
+    void write(std::ostream &out,
+               const Serialized<Texture::SP> &textures) override;
+    void read(std::istream &in,
               const std::vector<Texture::SP> &textures) override;
     std::string toString() const override { return "Metal"; }
 
@@ -260,10 +312,11 @@ namespace mini {
 
   struct Velvet : public Material {
     typedef std::shared_ptr<Velvet> SP;
+    static const Type TYPE = VELVET;
 
     /*! constructs a new Material - note you _probably_ want to use
         Material::create() instead */
-    Velvet() = default;
+    Velvet() : Material(TYPE) {}
     
     /*! constructs a new Material - note you _probably_ want to use
         Material::create() instead */
@@ -276,9 +329,9 @@ namespace mini {
     /*! constructs a new Material that is a identical clone of the
         current material */
     Material::SP clone() const override { return std::make_shared<Velvet>(*this); }
-    void write(std::ofstream &out,
-               const std::map<Texture::SP,int> &textures) override;
-    void read(std::ifstream &in,
+    void write(std::ostream &out,
+               const Serialized<Texture::SP> &textures) override;
+    void read(std::istream &in,
               const std::vector<Texture::SP> &textures) override;
     std::string toString() const override { return "Velvet"; }
 
@@ -290,10 +343,11 @@ namespace mini {
 
   struct Dielectric : public Material {
     typedef std::shared_ptr<Dielectric> SP;
+    static const Type TYPE = DIELECTRIC;
 
     /*! constructs a new Material - note you _probably_ want to use
         Material::create() instead */
-    Dielectric() = default;
+    Dielectric() : Material(TYPE) {}
     
     /*! constructs a new Material - note you _probably_ want to use
         Material::create() instead */
@@ -306,9 +360,9 @@ namespace mini {
     /*! constructs a new Material that is a identical clone of the
         current material */
     Material::SP clone() const override { return std::make_shared<Dielectric>(*this); }
-    void write(std::ofstream &out,
-               const std::map<Texture::SP,int> &textures) override;
-    void read(std::ifstream &in,
+    void write(std::ostream &out,
+               const Serialized<Texture::SP> &textures) override;
+    void read(std::istream &in,
               const std::vector<Texture::SP> &textures) override;
     std::string toString() const override { return "Dielectric"; }
 
@@ -318,10 +372,11 @@ namespace mini {
   };
   struct ThinGlass : public Material {
     typedef std::shared_ptr<ThinGlass> SP;
+    static const Type TYPE = THINGLASS;
 
     /*! constructs a new Material - note you _probably_ want to use
         Material::create() instead */
-    ThinGlass() = default;
+    ThinGlass() : Material(TYPE) {}
     
     /*! constructs a new Material - note you _probably_ want to use
         Material::create() instead */
@@ -334,9 +389,9 @@ namespace mini {
     /*! constructs a new Material that is a identical clone of the
         current material */
     Material::SP clone() const override { return std::make_shared<ThinGlass>(*this); }
-    void write(std::ofstream &out,
-               const std::map<Texture::SP,int> &textures) override;
-    void read(std::ifstream &in,
+    void write(std::ostream &out,
+               const Serialized<Texture::SP> &textures) override;
+    void read(std::istream &in,
               const std::vector<Texture::SP> &textures) override;
     std::string toString() const override { return "ThinGlass"; }
     
@@ -346,10 +401,11 @@ namespace mini {
   };
   struct MetallicPaint : public Material {
     typedef std::shared_ptr<MetallicPaint> SP;
+    static const Type TYPE = METALLICPAINT;
 
     /*! constructs a new Material - note you _probably_ want to use
         Material::create() instead */
-    MetallicPaint() = default;
+    MetallicPaint() : Material(TYPE) {}
     
     /*! constructs a new Material - note you _probably_ want to use
         Material::create() instead */
@@ -362,9 +418,9 @@ namespace mini {
     /*! constructs a new Material that is a identical clone of the
         current material */
     Material::SP clone() const override { return std::make_shared<MetallicPaint>(*this); }
-    void write(std::ofstream &out,
-               const std::map<Texture::SP,int> &textures) override;
-    void read(std::ifstream &in,
+    void write(std::ostream &out,
+               const Serialized<Texture::SP> &textures) override;
+    void read(std::istream &in,
               const std::vector<Texture::SP> &textures) override;
     std::string toString() const override { return "MetallicPaint"; }
     
@@ -376,10 +432,11 @@ namespace mini {
 
   struct Matte : public Material {
     typedef std::shared_ptr<Matte> SP;
+    static const Type TYPE = MATTE;
 
     /*! constructs a new Material - note you _probably_ want to use
         Material::create() instead */
-    Matte() = default;
+    Matte() : Material(TYPE) {}
     
     /*! constructs a new Material - note you _probably_ want to use
         Material::create() instead */
@@ -392,15 +449,179 @@ namespace mini {
     /*! constructs a new Material that is a identical clone of the
         current material */
     Material::SP clone() const override { return std::make_shared<Matte>(*this); }
-    void write(std::ofstream &out,
-               const std::map<Texture::SP,int> &textures) override;
-    void read(std::ifstream &in,
+    void write(std::ostream &out,
+               const Serialized<Texture::SP> &textures) override;
+    void read(std::istream &in,
               const std::vector<Texture::SP> &textures) override;
     std::string toString() const override { return "Matte"; }
     
     vec3f reflectance { 0.5f,0.5f,0.5f };
   };
 
+  /*! 'T', but const if 'Like' is const */
+  template<typename Like, typename T>
+  using SameConstAs
+  = typename std::conditional<std::is_const<Like>::value,const T,T>::type;
+  
+  /*! calls 'visitor' with the given material, cast to its actual
+      type (ie, with a DisneyMaterial &, Metal &, etc), by switching
+      over the material's type rather than through RTTI; returns
+      whatever that call returns. The visitor needs to be callable
+      with every material type; overloads for the types it cares
+      about plus one taking a (const) Material & - which also is
+      what materials of type INVALID get passed to - are an easy way
+      to achieve that */
+  template<typename Result, typename MaterialT, typename Visitor>
+  inline Result visitMaterial(MaterialT &material, Visitor &&visitor)
+  {
+    SameConstAs<MaterialT,Material> &base = material;
+    switch (base.getType()) {
+    case Material::DISNEY:
+      return visitor(static_cast<SameConstAs<MaterialT,DisneyMaterial> &>(base));
+    case Material::BLENDER:
+      return visitor(static_cast<SameConstAs<MaterialT,BlenderMaterial> &>(base));
+    case Material::MATTE:
+      return visitor(static_cast<SameConstAs<MaterialT,Matte> &>(base));
+    case Material::PLASTIC:
+      return visitor(static_cast<SameConstAs<MaterialT,Plastic> &>(base));
+    case Material::METAL:
+      return visitor(static_cast<SameConstAs<MaterialT,Metal> &>(base));
+    case Material::VELVET:
+      return visitor(static_cast<SameConstAs<MaterialT,Velvet> &>(base));
+    case Material::METALLICPAINT:
+      return visitor(static_cast<SameConstAs<MaterialT,MetallicPaint> &>(base));
+    case Material::DIELECTRIC:
+      return visitor(static_cast<SameConstAs<MaterialT,Dielectric> &>(base));
+    case Material::THINGLASS:
+      return visitor(static_cast<SameConstAs<MaterialT,ThinGlass> &>(base));
+    default:
+      return visitor(base);
+    }
+  }
+
+  
+  /*! a bounding box that gets computed once (on first use) and then
+      cached, until its owner explicitly invalidates it. Computing and
+      querying the cached value is thread-safe; invalidating it is
+      not (whoever modifies the data the box was computed from has to
+      make sure nobody else is using that data at the same time,
+      anyway) */
+  struct CachedBounds {
+    CachedBounds() = default;
+    CachedBounds(const CachedBounds &other) { *this = other; }
+    CachedBounds &operator=(const CachedBounds &other)
+    {
+      box3f otherBox;
+      if (other.get(otherBox)) set(otherBox); else invalidate();
+      return *this;
+    }
+
+    /*! returns true - and the cached box - if the cache is valid */
+    inline bool get(box3f &result) const
+    {
+      if (state.load(std::memory_order_acquire) != VALID) return false;
+      result = box;
+      return true;
+    }
+
+    /*! stores a (newly computed) box; if multiple threads try to set
+        the box at the same time only the first one will succeed (the
+        others will have computed the same box, anyway) */
+    inline void set(const box3f &newBox) const
+    {
+      int expected = INVALID;
+      if (!state.compare_exchange_strong(expected,WRITING,std::memory_order_acquire))
+        return;
+      box = newBox;
+      state.store(VALID,std::memory_order_release);
+    }
+
+    inline void invalidate() { state.store(INVALID,std::memory_order_release); }
+    
+  private:
+    enum { INVALID=0, WRITING, VALID };
+    mutable std::atomic<int> state { INVALID };
+    mutable box3f            box;
+  };
+  
+  /*! compact (and lossy) storage of a mesh's per-vertex data:
+      positions quantized to 16 bits per coordinate relative to the
+      mesh's bounds, octahedral-encoded 32-bit normals, and
+      half-float texture coordinates - 12 rather than 32 bytes per
+      vertex. See Mesh::quantize() */
+  struct QuantizedVertices {
+    /*! encodes the given (full-precision) vertex arrays */
+    static QuantizedVertices encode(const std::vector<vec3f> &vertices,
+                                    const std::vector<vec3f> &normals,
+                                    const std::vector<vec2f> &texcoords);
+
+    /*! decodes into the given (full-precision) vertex arrays */
+    void decode(std::vector<vec3f> &vertices,
+                std::vector<vec3f> &normals,
+                std::vector<vec2f> &texcoords) const;
+
+    size_t numBytes() const
+    {
+      return vertices.size()*sizeof(vertices[0])
+        + normals.size()*sizeof(normals[0])
+        + texcoords.size()*sizeof(texcoords[0]);
+    }
+    
+    /*! the box the vertices are quantized relative to; this is the
+        bounding box of the original vertices */
+    box3f                 domain;
+    /*! see quantizePosition() */
+    std::vector<vec3us>   vertices;
+    /*! see encodeOctahedral(); or empty */
+    std::vector<uint32_t> normals;
+    /*! see encodeHalf2(); or empty */
+    std::vector<vec2us>   texcoords;
+  };
+  
+  struct Mesh;
+  
+  /*! where a lazily loaded mesh (see LoadOptions::lazyMeshes) reads
+      its arrays from - in practice, a file and an offset into it */
+  struct MeshPayload {
+    typedef std::shared_ptr<MeshPayload> SP;
+
+    virtual ~MeshPayload() {}
+    
+    /*! reads the mesh's indices, vertices, normals, and texcoords
+        into the given mesh */
+    virtual void read(Mesh &mesh) const = 0;
+
+    /*! the (in-memory) mesh whose arrays this payload reads, if any
+        - ie, the source of a shared copy (see
+        Mesh::createSharedCopy()); null for payloads that read from a
+        file */
+    virtual const Mesh *getSource() const { return nullptr; }
+
+    /*! number of triangles and vertices of the mesh (so these can
+        be queried without reading the mesh) */
+    size_t numPrims    = 0;
+    size_t numVertices = 0;
+    size_t numNormals   = 0;
+    size_t numTexcoords = 0;
+  };
+
+  /*! residency state of a mesh that may have been loaded lazily;
+      thread-safe. Copies share the payload, but not the lock */
+  struct LazyMeshState {
+    LazyMeshState() = default;
+    LazyMeshState(const LazyMeshState &other) { *this = other; }
+    LazyMeshState &operator=(const LazyMeshState &other)
+    {
+      payload = other.payload;
+      resident.store(other.resident.load());
+      return *this;
+    }
+
+    /*! null unless the mesh was loaded lazily */
+    MeshPayload::SP   payload;
+    std::atomic<bool> resident { true };
+    std::mutex        mutex;
+  };
   
   /*! a typical triangle mesh that mesh embree and optix mesh requirements */
   struct Mesh {
@@ -412,13 +633,130 @@ namespace mini {
 
     inline static SP create(Material::SP material = {})
     { return std::make_shared<Mesh>(material); }
+
+    /*! creates a copy of the given mesh (with the same material,
+        meshlets, and bounds) that shares that mesh's arrays rather
+        than copying them: the copy starts out not resident (see
+        isResident()), and only gets arrays of its own - copies of
+        the source's - once ensureLoaded() gets called on it, which
+        code that _modifies_ the copy's arrays has to do first. Code
+        that only reads them should go through getArrays() instead,
+        which hands out the source's arrays without copying them;
+        getTriangle(), getVertex(), getBounds(), saving, BVHs,
+        meshlets, and the Intersector all do, so many copies of a mesh
+        cost hardly more memory than the mesh itself as long as they
+        don't get modified. (Until a copy is resident its own public
+        arrays are empty.) evict() drops the copy's own arrays again
+        (along with any changes made to them). The source must not be
+        modified while it has copies that aren't resident */
+    static SP createSharedCopy(const SP &source);
     
     // bool   isEmissive() const { return material->isEmissive(); }
-    size_t getNumPrims() const { return indices.size(); }
-
-    /*! computes a bounding box over all the triangles in this mesh */
+    size_t getNumPrims() const
+    {
+      if (!isResident()) return lazy.payload->numPrims;
+      return indices.empty() ? indices16.size() : indices.size();
+    }
+
+    /*! returns the number of vertices, whether quantized (or even
+        loaded) or not */
+    size_t getNumVertices() const
+    {
+      if (!isResident()) return lazy.payload->numVertices;
+      return vertices.empty() ? quantized.vertices.size() : vertices.size();
+    }
+
+    /*! returns the vertex indices of given triangle, whether this
+        mesh uses 16- or 32-bit indices (and whether it is resident
+        or not; see getArrays()) */
+    inline vec3i getTriangle(size_t primID) const
+    {
+      if (!isResident()) return getArrays().getTriangle(primID);
+      return indices.empty() ? vec3i(indices16[primID]) : indices[primID];
+    }
+
+    /*! returns given vertex, whether quantized or not (and whether
+        resident or not; see getArrays()) */
+    inline vec3f getVertex(size_t vertexID) const
+    {
+      if (!isResident()) return getArrays().getVertex(vertexID);
+      return vertices.empty()
+        ? dequantizePosition(quantized.vertices[vertexID],quantized.domain)
+        : vertices[vertexID];
+    }
+    
+    /*! returns whether this mesh's arrays are in memory. This always
+        is the case except for meshes loaded with
+        LoadOptions::lazyMeshes, whose arrays only get read by
+        ensureLoaded() - and released again by evict() */
+    bool isResident() const
+    { return lazy.resident.load(std::memory_order_acquire); }
+    
+    /*! makes sure this mesh's arrays are in memory, reading them from
+        its file if required. Has to be called before accessing the
+        arrays of a lazily loaded mesh; thread-safe (this is 'const'
+        since it doesn't change the mesh's logical content) */
+    void ensureLoaded() const;
+
+    /*! returns the mesh whose arrays hold this mesh's data, for
+        read-only access: the source of a shared copy that isn't
+        resident (see createSharedCopy()), without giving the copy
+        arrays of its own; or else this mesh itself, after
+        ensureLoaded(). Thread-safe */
+    const Mesh &getArrays() const;
+
+    /*! releases the arrays of a lazily loaded mesh or shared copy
+        (a no-op for any other mesh), until the next ensureLoaded(),
+        which re-reads them from the mesh's file or source. This
+        _discards_ any changes made to the arrays since they got
+        loaded, so do not evict meshes that got modified. Must not be
+        called while any other thread may be accessing this mesh's
+        arrays */
+    void evict();
+
+    /*! returns the bounding box over all the vertices in this mesh;
+        computed on first use, then cached (also see
+        invalidateBounds()) */
     box3f getBounds() const;
 
+    /*! marks this mesh's cached bounds as out of date; _has_ to be
+        called after modifying a mesh's vertices once getBounds() has
+        been called on it (or after it was loaded from a file, which
+        sets the cached bounds) */
+    void invalidateBounds() { cachedBounds.invalidate(); }
+
+    /*! builds meshlets for this mesh (see 'meshlets'); reads a
+        lazily loaded mesh */
+    void buildMeshlets(const Meshlets::BuildConfig &config
+                       = Meshlets::BuildConfig());
+    
+    /*! returns whether this mesh's vertex data currently lives in
+        'quantized' (in which case 'vertices', 'normals', and
+        'texcoords' are empty) */
+    bool isQuantized() const
+    { return !quantized.vertices.empty() && vertices.empty(); }
+    
+    /*! converts this mesh's vertices, normals, and texcoords to the
+        compact representation in 'quantized', and releases the
+        full-precision arrays. Note this is lossy */
+    void quantize();
+    
+    /*! converts a quantized mesh back to full-precision vertices,
+        normals, and texcoords (a no-op if the mesh isn't quantized) */
+    void dequantize();
+
+    /*! returns whether all of this mesh's vertex indices fit into 16
+        bits */
+    bool canUseNarrowIndices() const;
+    
+    /*! moves this mesh's 'indices' into (16-bit) 'indices16', if
+        canUseNarrowIndices(); returns whether it did */
+    bool narrowIndices();
+    
+    /*! moves 'indices16' back into (32-bit) 'indices' (a no-op if
+        the mesh doesn't use narrow indices) */
+    void widenIndices();
+    
     /*! array of vertices */
     std::vector<vec3f> vertices;
 
@@ -431,8 +769,30 @@ namespace mini {
     /*! the vector containing the triangles' vertex indices */
     std::vector<vec3i> indices;
 
+    /*! 16-bit vertex indices; used _instead_ of 'indices' (which
+        then is empty) for meshes that got loaded with
+        LoadOptions::keepNarrowIndices, or that narrowIndices() got
+        called on. Empty otherwise */
+    std::vector<vec3us> indices16;
+
     /*! the material to be applied to this mesh */
     Material::SP       material;
+
+    /*! compact vertex data of a quantized mesh; empty otherwise */
+    QuantizedVertices  quantized;
+
+    /*! (optional) partitioning of this mesh's triangles into
+        meshlets. Null unless built with buildMeshlets() (or read from
+        a file that has meshlets stored); has to be rebuilt after
+        changing the mesh's vertices or indices. Always gets stored
+        in the file if present */
+    Meshlets::SP       meshlets;
+    
+    /*! cached result of getBounds() */
+    CachedBounds       cachedBounds;
+
+    /*! see isResident() */
+    mutable LazyMeshState lazy;
   };
 
   /*! an object is a collection of one or more meshes. note it is
@@ -461,8 +821,33 @@ namespace mini {
     
     /*! computes and returns the bounding box of this object, which is
         the bounding box over all the mshes that this object
-        contains */
+        contains; computed on first use, then cached (also see
+        invalidateBounds()) */
     box3f getBounds() const;
+
+    /*! marks the cached bounds of this object _and_ all its meshes as
+        out of date (and drops this object's BVH); has to be called
+        after modifying this object's list of meshes, or any of its
+        meshes' vertices */
+    void invalidateBounds();
+
+    /*! builds this object's BVH over the triangles of all its meshes
+        (see 'bvh'); reads lazily loaded meshes */
+    void buildBVH(const BVH::BuildConfig &config = BVH::BuildConfig());
+
+    /*! same as buildBVH(), but only returns the BVH, without storing
+        it in this object. If 'asQuantized' is set, the BVH gets built
+        over the positions that meshes which aren't quantized yet
+        would have after quantize() - ie, over what gets read back
+        from a file saved with SaveOptions::quantizeVertices, which
+        can be off by up to half a quantization step */
+    BVH::SP computeBVH(const BVH::BuildConfig &config = BVH::BuildConfig(),
+                       bool asQuantized = false) const;
+    
+    /*! returns the number of triangles in all meshes before the
+        given one; ie, the prim ID (in 'bvh') of mesh #meshID's first
+        triangle */
+    size_t getPrimOffset(size_t meshID) const;
     
     /*! list of all geometries in this object. if this object is in
       a partial scene / extracted sub-scene this array will
@@ -470,6 +855,15 @@ namespace mini {
       was extracted from, just some of its elements might be
       empty */
     std::vector<Mesh::SP> meshes;
+
+    /*! cached result of getBounds() */
+    CachedBounds          cachedBounds;
+
+    /*! (optional) BVH over the triangles of this object's meshes;
+        prim IDs number the triangles of all meshes consecutively,
+        mesh by mesh (see getPrimOffset()). Null unless built with
+        buildBVH(), or read from a file that had BVHs stored */
+    BVH::SP               bvh;
   };
 
   /*! represents instances of objects, with an affine transformation matrix */
@@ -483,7 +877,8 @@ namespace mini {
     inline static SP create(Object::SP object = 0, const affine3f &xfm = affine3f())
     { return std::make_shared<Instance>(object,xfm); }
 
-    /*! computes and returns the world-space bounding box of this instance */
+    /*! computes and returns the world-space bounding box of this
+        instance (from the object's cached bounds) */
     box3f getBounds() const;
     
     affine3f   xfm;
@@ -551,6 +946,108 @@ namespace mini {
     affine3f    transform;
   };
 
+  /*! options for how Scene::save() (or a SceneWriter) stores a
+      scene */
+  struct SaveOptions {
+    /*! codec to compress all mesh arrays and texture data with (each
+        array gets compressed individually, in independent chunks,
+        so loading can decompress in parallel); NONE stores all data
+        uncompressed */
+    compression::Codec compression = compression::NONE;
+
+    /*! store all meshes in quantized form (see Mesh::quantize()),
+        without modifying the meshes in memory. Meshes that already
+        are quantized always get stored that way */
+    bool quantizeVertices = false;
+
+    /*! store BVHs (see Scene::buildBVHs()) in the file: objects'
+        existing BVHs, plus newly built ones for those that have
+        none, and a BVH over all the instances written to the file */
+    bool storeBVHs = false;
+
+    /*! also store all materials in packed form (see
+        miniScene/MaterialTable.h), which loadMaterialTable() can read
+        without parsing anything else. The regular material records
+        get stored either way */
+    bool storeMaterialTable = false;
+  };
+
+  /*! options for how Scene::load() reads a scene */
+  struct LoadOptions {
+    /*! keep meshes that got stored in quantized form quantized in
+        memory (rather than converting them back to full-precision
+        vertices, which is the default) */
+    bool keepQuantized = false;
+
+    /*! keep the 16-bit indices that meshes with few enough vertices
+        get stored with in Mesh::indices16 (rather than widening them
+        to Mesh::indices, which is the default) */
+    bool keepNarrowIndices = false;
+
+    /*! do not read any mesh's arrays (indices, vertices, etc) when
+        loading; instead, every mesh remembers where in the file its
+        arrays are, and reads them on Mesh::ensureLoaded(). Mesh and
+        object bounds are still available (for version 14+ files)
+        without reading any arrays. Only applies to indexed (version
+        13+) files; while any lazily loaded mesh is alive the file
+        stays open */
+    bool lazyMeshes = false;
+
+    /*! read the BVHs stored in the file (if any) into Object::bvh
+        and Scene::bvh */
+    bool readBVHs = true;
+
+    /*! read the meshlets stored in the file (if any) into
+        Mesh::meshlets; these always get read right away, even for
+        lazily loaded meshes */
+    bool readMeshlets = true;
+
+    /*! allocate the loaded scene's instances, objects, meshes,
+        materials, and textures (but not their arrays) from a single
+        Arena, rather than with one malloc each. Off by default: the
+        arena's memory only gets released in one go once the last of
+        these is gone, so keeping any single one of them (say, one
+        material) alive keeps all of the scene's instances, objects,
+        etc alive, too */
+    bool useArena = false;
+
+    /*! the arena to allocate from if 'useArena' is set; if null (the
+        default), each load creates its own */
+    Arena::SP arena;
+  };
+  
+  /*! summary statistics of a scene; see Scene::getInfo() and
+      Scene::peekInfo() */
+  struct SceneInfo {
+    size_t numInstances       = 0;
+    size_t numObjects         = 0;
+    /*! counts over all _unique_ meshes */
+    size_t numUniqueMeshes    = 0;
+    size_t numUniqueTriangles = 0;
+    size_t numUniqueVertices  = 0;
+    /*! counts over all meshes of all instances; ie, what one would
+        get after flattening the scene */
+    size_t numActualMeshes    = 0;
+    size_t numActualTriangles = 0;
+    size_t numActualVertices  = 0;
+    size_t numActualNormals   = 0;
+    size_t numActualTexcoords = 0;
+    /*! number of (non-null) textures, and how many of those are
+        embedded ptex textures */
+    size_t numTextures        = 0;
+    size_t numPtexTextures    = 0;
+    size_t numPtexBytes       = 0;
+    size_t numTexelBytes      = 0;
+    size_t numMaterials       = 0;
+    size_t numQuadLights      = 0;
+    size_t numDirLights       = 0;
+    /*! resolution of the env-map light's texture; (0,0) if there is
+        no env-map light */
+    vec2i  envMapSize         = vec2i(0);
+    /*! world-space bounds of the scene */
+    box3f  bounds;
+  };
+  
   /*! a complete scene, consisting of a list of instances (may be a
       single one if the scene doesn't use instantiation), and some
       light sources */
@@ -573,37 +1070,196 @@ namespace mini {
         while */
     box3f getBounds() const;
 
+    /*! builds a BVH for every object that doesn't have one yet (or
+        for all objects, if 'rebuildObjectBVHs' is set), and then
+        (re-)builds the scene's BVH over all its instances; objects
+        get built in parallel */
+    void buildBVHs(bool rebuildObjectBVHs = false,
+                   const BVH::BuildConfig &config = BVH::BuildConfig());
+
+    /*! builds meshlets for every mesh that doesn't have them yet (or
+        for all meshes, if 'rebuild' is set), in parallel */
+    void buildMeshlets(bool rebuild = false,
+                       const Meshlets::BuildConfig &config
+                       = Meshlets::BuildConfig());
+    
+    /*! computes summary statistics (number of instances, unique and
+        instantiated triangles, texture sizes, etc) of this scene;
+        works without reading lazily loaded meshes */
+    SceneInfo getInfo() const;
+
+    /*! returns the same statistics as getInfo() would for the scene
+        stored in the given file, but (for version 18+ files) does so
+        by reading only the small block of statistics that gets stored
+        in the file, without loading the scene. For older files this
+        falls back to (lazily) loading the scene */
+    static SceneInfo peekInfo(const std::string &fileName);
+    
     /*! loads a ".mini" file from the given file */
-    static Scene::SP load(const std::string &fileName);
+    static Scene::SP load(const std::string &fileName,
+                          const LoadOptions &options = LoadOptions());
 
     /*! saves the model in file with given name, using a binary file
         format that can be loaded with Scene::load() */
-    void save(const std::string &fileName);
+    void save(const std::string &fileName,
+              const SaveOptions &options = SaveOptions());
+
+    /*! same as save(), but returns right away, and does all the
+        saving in the background; the returned future becomes ready
+        once the file is complete (and re-throws any error that
+        happened while saving). This scene itself can be modified or
+        released right after this call (the save works on a snapshot
+        of its instances and lights), but the objects, meshes,
+        materials, and textures it refers to must not be modified
+        until the future is ready */
+    std::future<void> saveAsync(const std::string &fileName,
+                                const SaveOptions &options = SaveOptions());
       
     std::vector<QuadLight>  quadLights;
     std::vector<DirLight>   dirLights;
     EnvMapLight::SP         envMapLight;
     
     std::vector<Instance::SP> instances;
+
+    /*! (optional) BVH over the world-space bounds of all instances;
+        prim IDs are indices into 'instances'. Null unless built
+        with buildBVHs() (or read from a file with BVHs); has to be
+        rebuilt after changing the instances */
+    BVH::SP                   bvh;
   };
 
+  struct SerializedScene;
+  
+  /*! writes a ".mini" file in a streaming fashion, for scenes that
+      have (many) more instances than one would want to keep in
+      memory at the same time (e.g., in miniReplicate). Creating the
+      writer writes the given scene - its lights, all objects (and
+      meshes, materials, and textures) its instances refer to, and
+      those instances themselves; after that any number of
+      additional instances can be written one by one, as long as
+      they only refer to objects that the initial scene's instances
+      did. The file is complete (and loadable by Scene::load()) only
+      once close() has been called.
+
+      Scene::save(fileName) is the same as creating a SceneWriter
+      for that scene and immediately closing it.
+
+      With 'writeInBackground' the actual file writes happen on a
+      separate thread, overlapping with the serialization of the
+      data that follows */
+  struct SceneWriter {
+    typedef std::shared_ptr<SceneWriter> SP;
+    
+    SceneWriter(const std::string &fileName, const Scene *scene,
+                const SaveOptions &options = SaveOptions(),
+                bool writeInBackground = false);
+    
+    /*! creates a writer that writes the given scene's lights
+        (ignoring its instances) and the given objects - in that
+        order, so instances can then get written by their object's
+        index in 'objects' (see write(xfm,objectID)) - but no
+        instances yet */
+    SceneWriter(const std::string &fileName, const Scene *lights,
+                const std::vector<Object::SP> &objects,
+                const SaveOptions &options = SaveOptions(),
+                bool writeInBackground = false);
+    
+    /*! closes the file if close() wasn't called, ignoring errors */
+    ~SceneWriter();
+    
+    /*! writes an additional instance; throws if this instance's
+        object was not among the initial scene's objects */
+    void write(const Instance::SP &instance);
+
+    /*! writes an additional instance of the object with given ID (in
+        the order the writer's objects got written); -1 writes a
+        null instance */
+    void write(const affine3f &xfm, int objectID);
+    
+    /*! writes the file's section offset table and trailer, and
+        closes the file; throws if anything goes wrong */
+    void close();
+    
+  private:
+    SceneWriter(const std::string &fileName, const Scene *lights,
+                SerializedScene &&serialized,
+                const SaveOptions &options,
+                bool writeInBackground);
+    
+    struct Impl;
+    std::unique_ptr<Impl> impl;
+  };
+  
+  /*! reads a ".mini" file in a streaming fashion, for passes that
+      only need to walk over all instances once (e.g., flattening or
+      exporting a scene) and for scenes whose instantiated geometry
+      would not fit into memory. Creating the reader reads the file's
+      lights, materials, and textures, and all its objects - but
+      with lazily loaded meshes (see LoadOptions::lazyMeshes), so
+      without any of their vertex data; instances then get read one
+      at a time, with next(). The meshes of each instance returned by
+      next() are resident (see Mesh::ensureLoaded()); once the meshes
+      made resident that way exceed a given memory budget, the ones
+      least recently used get evicted again.
+
+      Files older than version 13 do not allow for lazy loading;
+      those get loaded completely */
+  struct SceneReader {
+    typedef std::shared_ptr<SceneReader> SP;
+
+    /*! opens the given file; 'maxResidentBytes' is the memory budget
+        for resident mesh data (the meshes of the current instance
+        always are resident, though) */
+    SceneReader(const std::string &fileName,
+                size_t maxResidentBytes = size_t(1)<<30,
+                const LoadOptions &options = LoadOptions());
+    ~SceneReader();
+
+    /*! the file's lights (and nothing else; in particular, no
+        instances) */
+    Scene::SP getLights() const;
+
+    /*! all the file's objects, with lazily loaded meshes (and
+        without BVHs, even if the file has them stored) */
+    const std::vector<Object::SP> &getObjects() const;
+    
+    /*! the total number of instances in the file */
+    size_t getNumInstances() const;
+    
+    /*! reads the next instance (which can be null, if the file
+        contains null instances); returns false once all instances
+        have been read. All meshes of the returned instance's object
+        are resident until at least the next call to next() */
+    bool next(Instance::SP &instance);
+    
+  private:
+    struct Impl;
+    std::unique_ptr<Impl> impl;
+  };
+  
   /*! helper function for computing the bounding box of an affinely
       transformed box3f; usually used to compute the world-space
       bounding box of an instance (given that instance's affine
       transform matrix and the object-space bounding box of the object
-      being instantiated) */
+      being instantiated). Computes the same box as transforming all
+      eight corners, but directly from the transformed center and
+      the absolute values of the linear transform's columns */
   inline box3f xfmBox(const affine3f &xfm, const box3f &box)
   {
-    box3f result;
-    for (int iz=0;iz<2;iz++)
-      for (int iy=0;iy<2;iy++)
-        for (int ix=0;ix<2;ix++) {
-          vec3f v(ix ? box.upper.x : box.lower.x,
-                  iy ? box.upper.y : box.lower.y,
-                  iz ? box.upper.z : box.lower.z);
-          result.extend(xfmPoint(xfm,v));
-        }
-    return result;
+    if (box.empty())
+      return box3f();
+    const vec3f center   = xfmPoint(xfm,box.center());
+    const vec3f halfSize = .5f*box.size();
+    const vec3f extent
+      = abs(xfm.l.vx)*halfSize.x
+      + abs(xfm.l.vy)*halfSize.y
+      + abs(xfm.l.vz)*halfSize.z;
+    return box3f(center-extent,center+extent);
   }
+
+  /*! computes the bounding box of the given array of points; uses
+      SSE (or AVX, if enabled at compile time) to process multiple
+      points at a time */
+  box3f computeBounds(const vec3f *points, size_t numPoints);
   
 } // ::mini
@@ -17,37 +17,104 @@
 #include "miniScene/Serialized.h"
 
 namespace mini {
-    
-    SerializedScene::SerializedScene(Scene *scene)
-    {
-      textures.add(nullptr);
 
-      for (auto inst : scene->instances) {
-        if (!inst) continue;
+  /*! material visitor that adds (pointers to) a material's
+      textures to 'textures' */
+  struct TexturesOf {
+    void operator()(const DisneyMaterial &disney) const
+    {
+      textures.push_back(&disney.colorTexture);
+      textures.push_back(&disney.alphaTexture);
+    }
+    void operator()(const BlenderMaterial &blender) const
+    {
+      textures.push_back(&blender.baseColorTexture);
+      textures.push_back(&blender.alphaTexture);
+    }
+    void operator()(const Material &) const {}
+    
+    std::vector<const Texture::SP *> &textures;
+  };
+  
+  /*! adds to 'registry' all the children of the given (ordered) list
+      of parents that the registry does not yet know about, in exactly
+      the order in which a serial traversal would first have found
+      them. 'childrenOf(parent,children)' appends (pointers to) a
+      parent's children to 'children'. Each block of parents first
+      builds its own de-duplicated list of new candidates - in
+      parallel - and these lists then get added to the registry in
+      block order */
+  template<typename Child, typename Parent, typename ChildrenOf>
+  void addChildrenInOrder(Serialized<Child> &registry,
+                          const std::vector<Parent> &parents,
+                          const ChildrenOf &childrenOf)
+  {
+    const size_t blockSize = 1024;
+    const size_t numBlocks = (parents.size()+blockSize-1)/blockSize;
+    std::vector<std::vector<Child>> candidates(numBlocks);
+    parallel_for
+      (numBlocks,
+       [&](size_t blockID) {
+         const size_t begin = blockID*blockSize;
+         const size_t end   = std::min(begin+blockSize,parents.size());
+         PointerIDMap seenInBlock;
+         std::vector<const Child *> children;
+         for (size_t i=begin;i<end;i++) {
+           children.clear();
+           childrenOf(parents[i],children);
+           for (auto child : children) {
+             if (registry.wasKnown(*child)) continue;
+             if (seenInBlock.insert(child->get(),0) != 0) continue;
+             // (first time we see this in this block)
+             candidates[blockID].push_back(*child);
+           }
+         }
+       });
+    for (auto &blockCandidates : candidates)
+      for (auto &child : blockCandidates)
+        registry.add(child);
+  }
+  
+  SerializedScene::SerializedScene(const Scene *scene)
+  {
+    textures.add(nullptr);
 
-        auto obj = inst->object;
-        
-        if (!obj || objects.addWasKnown(obj)) continue;
+    addChildrenInOrder
+      (objects,scene->instances,
+       [](const Instance::SP &inst, std::vector<const Object::SP *> &children) {
+         if (inst && inst->object) children.push_back(&inst->object);
+       });
+    addChildrenOfObjects();
+  }
 
-        for (auto mesh : obj->meshes) {
-          if (!mesh || meshes.addWasKnown(mesh)) continue;
-          
-          auto material = mesh->material;
-          assert(material);
-          if (materials.addWasKnown(material)) continue;
+  SerializedScene::SerializedScene(const std::vector<Object::SP> &objects)
+  {
+    textures.add(nullptr);
 
-          DisneyMaterial::SP disney = material->as<DisneyMaterial>();
-          if (disney) {
-            textures.add(disney->colorTexture);
-            textures.add(disney->alphaTexture);
-          }
-          BlenderMaterial::SP blender = material->as<BlenderMaterial>();
-          if (blender) {
-            textures.add(blender->baseColorTexture);
-            textures.add(blender->alphaTexture);
-          }
-        }
-      }
-    }
+    for (auto &object : objects)
+      if (object) this->objects.add(object);
+    addChildrenOfObjects();
+  }
+  
+  void SerializedScene::addChildrenOfObjects()
+  {
+    addChildrenInOrder
+      (meshes,objects.list,
+       [](const Object::SP &obj, std::vector<const Mesh::SP *> &children) {
+         for (auto &mesh : obj->meshes)
+           if (mesh) children.push_back(&mesh);
+       });
+    addChildrenInOrder
+      (materials,meshes.list,
+       [](const Mesh::SP &mesh, std::vector<const Material::SP *> &children) {
+         assert(mesh->material);
+         children.push_back(&mesh->material);
+       });
+    addChildrenInOrder
+      (textures,materials.list,
+       [](const Material::SP &material, std::vector<const Texture::SP *> &children) {
+         visitMaterial<void>(*material,TexturesOf{children});
+       });
+  }
 
 } // ::mini
@@ -20,41 +20,125 @@
 
 namespace mini {
 
+  /*! open-addressing (linear probing) hash map from raw object
+      pointers to integer IDs; used by Serialized<> to look up the ID
+      of a given texture, material, mesh, or object. Unlike a
+      std::map over shared_ptr's this needs neither a tree walk nor
+      any ref-counting per lookup */
+  struct PointerIDMap {
+    /*! returns the ID registered for the given pointer, or -1 if
+        that pointer is not known */
+    inline int find(const void *key) const
+    {
+      if (!key) return nullID;
+      if (keys.empty()) return -1;
+      for (size_t slot = hash(key) & mask();; slot = (slot+1) & mask()) {
+        if (keys[slot] == key) return ids[slot];
+        if (keys[slot] == nullptr) return -1;
+      }
+    }
+
+    /*! registers the given pointer with the given ID, _unless_ that
+        pointer is already known; returns the ID the pointer is
+        registered with after this call */
+    inline int insert(const void *key, int ID)
+    {
+      if (!key) {
+        if (nullID < 0) nullID = ID;
+        return nullID;
+      }
+      if (2*(numKeys+1) > keys.size())
+        rehash(std::max(size_t(64),2*keys.size()));
+      size_t slot = hash(key) & mask();
+      for (;keys[slot] != nullptr; slot = (slot+1) & mask())
+        if (keys[slot] == key) return ids[slot];
+      keys[slot] = key;
+      ids[slot]  = ID;
+      numKeys++;
+      return ID;
+    }
+
+    /*! makes sure that numExpected keys can be inserted without
+        having to rehash */
+    inline void reserve(size_t numExpected)
+    {
+      size_t capacity = 64;
+      while (capacity < 2*numExpected) capacity *= 2;
+      if (capacity > keys.size()) rehash(capacity);
+    }
+
+    inline size_t size() const { return numKeys + (nullID >= 0); }
+    
+  private:
+    inline size_t mask() const { return keys.size()-1; }
+
+    static inline size_t hash(const void *key)
+    {
+      uint64_t h = (uint64_t)(uintptr_t)key;
+      h ^= h >> 33;
+      h *= 0xff51afd7ed558ccdULL;
+      h ^= h >> 33;
+      return (size_t)h;
+    }
+    
+    void rehash(size_t newCapacity)
+    {
+      std::vector<const void *> oldKeys;
+      std::vector<int>          oldIDs;
+      oldKeys.swap(keys);
+      oldIDs.swap(ids);
+      keys.assign(newCapacity,nullptr);
+      ids.assign(newCapacity,-1);
+      for (size_t i=0;i<oldKeys.size();i++) {
+        if (!oldKeys[i]) continue;
+        size_t slot = hash(oldKeys[i]) & mask();
+        while (keys[slot] != nullptr) slot = (slot+1) & mask();
+        keys[slot] = oldKeys[i];
+        ids[slot]  = oldIDs[i];
+      }
+    }
+    
+    std::vector<const void *> keys;
+    std::vector<int>          ids;
+    size_t                    numKeys = 0;
+    /*! the null pointer is a valid key, too (but can't be stored in
+        'keys', where it marks empty slots) */
+    int                       nullID  = -1;
+  };
+  
   /*! helper class that creates a "serialized" registry of a certain
       type of object; allowing to identify and look up objects using
-      numerical IDs */
+      numerical IDs. 'T' has to be a std::shared_ptr<> to that type
+      of object */
   template<typename T>
   struct Serialized {
     inline size_t size() const { return list.size(); }
     inline const T &operator[](int ID) const
     { assert(ID>=0); assert(ID<list.size()); return list[ID]; }
       
-    int getID(T t)
+    inline int getID(const T &t) const
     {
-      if (registry.find(t) == registry.end())
-        return -1;
-
-      return registry[t];
+      return registry.find(t.get());
     }
       
-    inline bool wasKnown(T t) const
+    inline bool wasKnown(const T &t) const
     {
-      return  (registry.find(t) != registry.end());
+      return registry.find(t.get()) >= 0;
     }
 
-    bool addWasKnown(T t)
+    bool addWasKnown(const T &t)
     {
-      if (registry.find(t) != registry.end())
+      const int newID = (int)list.size();
+      if (registry.insert(t.get(),newID) != newID)
         return true;
-
-      registry[t] = (int)list.size();
+      
       list.push_back(t);
       return false;
     }
       
-    void add(T t) { addWasKnown(t); }
+    void add(const T &t) { addWasKnown(t); }
       
-    std::map<T,int> registry;
+    PointerIDMap    registry;
     std::vector<T>  list;
   };
 
@@ -63,7 +147,12 @@ namespace mini {
       references through (and looked up by) serial integer IDs */
   struct SerializedScene {
     SerializedScene() {}
-    SerializedScene(Scene *scene);
+    /*! serializes everything the scene's instances refer to */
+    SerializedScene(const Scene *scene);
+    /*! serializes the given objects - in exactly that order, so an
+        object's ID is its index in 'objects' (unless that list
+        contains duplicates) - and everything they refer to */
+    SerializedScene(const std::vector<Object::SP> &objects);
       
     int getID(Texture::SP t)  { return textures.getID(t); }
     int getID(Material::SP m) { return materials.getID(m); }
@@ -74,6 +163,10 @@ namespace mini {
     Serialized<Material::SP> materials;
     Serialized<Object::SP>   objects;
     Serialized<Mesh::SP>     meshes;
+
+  private:
+    /*! adds all meshes, materials, and textures of 'objects' */
+    void addChildrenOfObjects();
   };
 
 } // ::mini
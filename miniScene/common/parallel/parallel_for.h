@@ -19,7 +19,15 @@
 #pragma once
 
 // std
+#include <algorithm>
+#include <cstdlib>
 #include <mutex>
+#include <atomic>
+#include <condition_variable>
+#include <exception>
+#include <functional>
+#include <thread>
+#include <vector>
 
 #ifdef OWL_DISABLE_TBB
 # undef OWL_HAVE_TBB
@@ -63,12 +71,178 @@ namespace mini {
       }
     }
 #else
-#ifndef OWL_DISABLE_TBB
-// # pragma message("warning: TBB not available, will replace all parallel_for's with serial_for's")
-#endif
+    namespace detail {
+      
+      /*! a simple built-in thread pool that parallel_for uses if TBB
+          is not available. This is a shared-counter pool, not a
+          work-stealing one: each parallel_for becomes a 'job' with a
+          single atomic counter of the next task to be processed, and
+          the calling thread and all idle worker threads keep grabbing
+          chunks of tasks from that counter. Idle workers always pick
+          the most recently added job that still has tasks left. Since
+          the calling thread always keeps working on its own job nested
+          parallel_for's (e.g., Object::getBounds() calling
+          Mesh::getBounds()) cannot dead-lock, even if all workers are
+          busy. Once its job has no tasks left the caller sleeps on the
+          job's condition variable until the workers still running
+          chunks of it are done */
+      struct ThreadPool {
+        struct Job {
+          Job(size_t numTasks, size_t grainSize,
+              const std::function<void(size_t,size_t)> &body)
+            : numTasks(numTasks), grainSize(grainSize), body(body)
+          {}
+          
+          inline bool hasWorkLeft() const { return nextTask < numTasks; }
+
+          /*! grabs and executes chunks of tasks until there's none left */
+          void work()
+          {
+            while (true) {
+              const size_t begin = nextTask.fetch_add(grainSize);
+              if (begin >= numTasks) return;
+              const size_t end = std::min(begin+grainSize,numTasks);
+              try {
+                body(begin,end);
+              } catch (...) {
+                std::lock_guard<std::mutex> lock(exceptionMutex);
+                if (!exception) exception = std::current_exception();
+              }
+            }
+          }
+          
+          const size_t numTasks;
+          const size_t grainSize;
+          const std::function<void(size_t,size_t)> &body;
+          std::atomic<size_t> nextTask { 0 };
+          /*! number of worker threads that currently hold a
+              reference to this job; only decremented with doneMutex
+              held, so the caller can wait for it to drop to zero */
+          std::atomic<int>    numActiveWorkers { 0 };
+          std::mutex          doneMutex;
+          std::condition_variable doneCV;
+          std::mutex          exceptionMutex;
+          std::exception_ptr  exception;
+        };
+
+        static ThreadPool &get() { static ThreadPool pool; return pool; }
+        
+        /*! uses one thread per hardware thread, unless overridden
+            through the MINI_NUM_THREADS environment variable */
+        ThreadPool()
+        {
+          numThreads = std::max(1u,std::thread::hardware_concurrency());
+          if (const char *env = getenv("MINI_NUM_THREADS"))
+            numThreads = std::max(1,atoi(env));
+          for (int i=1;i<numThreads;i++)
+            workers.push_back(std::thread([this](){ workerLoop(); }));
+        }
+        
+        ~ThreadPool()
+        {
+          {
+            std::lock_guard<std::mutex> lock(mutex);
+            stop = true;
+          }
+          cv.notify_all();
+          for (auto &worker : workers) worker.join();
+        }
+
+        /*! runs body(begin,end) for chunks of (at most) grainSize tasks
+            each until all numTasks tasks are done; returns only once
+            every chunk has completed */
+        void run(size_t numTasks, size_t grainSize,
+                 const std::function<void(size_t,size_t)> &body)
+        {
+          Job job(numTasks,grainSize,body);
+          {
+            std::lock_guard<std::mutex> lock(mutex);
+            jobs.push_back(&job);
+          }
+          cv.notify_all();
+          
+          job.work();
+          
+          {
+            std::lock_guard<std::mutex> lock(mutex);
+            jobs.erase(std::find(jobs.begin(),jobs.end(),&job));
+          }
+          // no new worker can pick up this job any more; wait for
+          // those still working on their last chunk of it
+          {
+            std::unique_lock<std::mutex> doneLock(job.doneMutex);
+            job.doneCV.wait(doneLock,[&](){
+                return job.numActiveWorkers == 0;
+              });
+          }
+          if (job.exception)
+            std::rethrow_exception(job.exception);
+        }
+
+        void workerLoop()
+        {
+          std::unique_lock<std::mutex> lock(mutex);
+          while (true) {
+            Job *job = nullptr;
+            cv.wait(lock,[&](){
+                if (stop) return true;
+                for (auto it = jobs.rbegin(); it != jobs.rend(); ++it)
+                  if ((*it)->hasWorkLeft()) { job = *it; return true; }
+                return false;
+              });
+            if (!job) return;
+            
+            job->numActiveWorkers++;
+            lock.unlock();
+            job->work();
+            {
+              // notify while still holding doneMutex: as soon as it
+              // is released the caller may destroy the job
+              std::lock_guard<std::mutex> doneLock(job->doneMutex);
+              if (--job->numActiveWorkers == 0)
+                job->doneCV.notify_all();
+            }
+            lock.lock();
+          }
+        }
+
+        int                      numThreads;
+        std::vector<std::thread> workers;
+        std::mutex               mutex;
+        std::condition_variable  cv;
+        /*! all jobs currently being worked on, in order of creation */
+        std::vector<Job *>       jobs;
+        bool                     stop = false;
+      };
+      
+    } // ::mini::common::detail
+    
     template<typename INDEX_T, typename TASK_T>
     inline void parallel_for(INDEX_T nTasks, TASK_T&& taskFunction, size_t blockSize=1)
-    { serial_for(nTasks,taskFunction); }
+    {
+      if (nTasks == 0) return;
+      if (nTasks == 1) {
+        taskFunction(INDEX_T(0));
+        return;
+      }
+      detail::ThreadPool &pool = detail::ThreadPool::get();
+      if (pool.numThreads == 1) {
+        serial_for(nTasks,taskFunction);
+        return;
+      }
+      // use chunks that are large enough to amortize the cost of
+      // grabbing them, but small enough that every thread gets
+      // several of them (for load balancing)
+      const size_t grainSize
+        = std::max(std::max(blockSize,size_t(1)),
+                   size_t(nTasks)/(16*pool.numThreads));
+      const std::function<void(size_t,size_t)> body
+        = [&](size_t begin, size_t end) {
+            for (size_t i=begin;i<end;i++)
+              taskFunction(INDEX_T(i));
+          };
+      pool.run(size_t(nTasks),grainSize,body);
+    }
 #endif
   
     // template<typename TASK_T>
@@ -103,5 +277,45 @@ namespace mini {
 #endif
     }
   
+    /*! parallel reduction over the range [begin,end): splits the
+        range into blocks of (at most) blockSize elements, computes
+        one partial result per block via blockFunction(blockBegin,
+        blockEnd) - all in parallel, and each into its own slot, so
+        without any locks - and then combines these partial results
+        pairwise in a tree, using combine(a,b). Returns 'identity'
+        for an empty range. Partial results are kept in a wrapper
+        struct, so T=bool does not end up in a bit-packed
+        std::vector<bool>, where concurrent writes to different
+        slots would race on the same word */
+    template<typename T, typename BLOCK_FCT, typename COMBINE_FCT>
+    T parallel_reduce(size_t begin, size_t end, size_t blockSize,
+                      const T &identity,
+                      const BLOCK_FCT &blockFunction,
+                      const COMBINE_FCT &combine)
+    {
+      if (end <= begin) return identity;
+      const size_t numBlocks = (end-begin+blockSize-1)/blockSize;
+      if (numBlocks == 1) return blockFunction(begin,end);
+      
+      struct Partial { T value; };
+      std::vector<Partial> partials(numBlocks,Partial{identity});
+      parallel_for(numBlocks,[&](size_t blockID){
+          size_t block_begin = begin+blockID*blockSize;
+          partials[blockID].value
+            = blockFunction(block_begin,std::min(block_begin+blockSize,end));
+        });
+      for (size_t stride=1;stride<numBlocks;stride*=2) {
+        const size_t numPairs = (numBlocks+2*stride-1)/(2*stride);
+        parallel_for(numPairs,[&](size_t pairID){
+            const size_t a = pairID*2*stride;
+            const size_t b = a+stride;
+            if (b < numBlocks)
+              partials[a].value
+                = combine(partials[a].value,partials[b].value);
+          });
+      }
+      return partials[0].value;
+    }
+    
   } // ::owl::common
 } // ::owl
@@ -0,0 +1,89 @@
+// ======================================================================== //
+// Copyright 2018-2020 Ingo Wald                                            //
+//                                                                          //
+// Licensed under the Apache License, Version 2.0 (the "License");          //
+// you may not use this file except in compliance with the License.         //
+// You may obtain a copy of the License at                                  //
+//                                                                          //
+//     http://www.apache.org/licenses/LICENSE-2.0                           //
+//                                                                          //
+// Unless required by applicable law or agreed to in writing, software      //
+// distributed under the License is distributed on an "AS IS" BASIS,        //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. //
+// See the License for the specific language governing permissions and      //
+// limitations under the License.                                           //
+// ======================================================================== //
+
+
+/* simple benchmark for the cost of loading (and releasing) a given
+   scene, with and without allocating its entities from an Arena (see
+   LoadOptions::useArena); e.g., for a synthetic scene with many
+   instances created with
+
+   ./miniGenScaleTest -ni 1000000 -nbs 100000 -sr 4 -tr 0 -o test.mini
+   ./miniBenchLoad test.mini -n 5
+*/
+
+#include "miniScene/Scene.h"
+
+namespace mini {
+
+  void usage(const std::string &error)
+  {
+    if (!error.empty())
+      std::cerr << MINI_TERMINAL_RED << "Error: " << error
+                << MINI_TERMINAL_DEFAULT << std::endl << std::endl;
+    std::cout << "Usage: ./miniBenchLoad in.mini [-n numRuns]" << std::endl;
+    exit(error.empty()?0:1);
+  }
+  
+  void miniBenchLoad(int ac, char **av)
+  {
+    std::string inFileName = "";
+    int numRuns = 3;
+    for (int i=1;i<ac;i++) {
+      std::string arg = av[i];
+      if (arg == "-n")
+        numRuns = std::stoi(av[++i]);
+      else if (arg == "-h" || arg == "--help")
+        usage("");
+      else if (arg[0] != '-')
+        inFileName = arg;
+      else
+        usage("unknown cmdline argument '"+arg+"'");
+    }
+    if (inFileName.empty())
+      usage("no input file specified");
+
+    for (int useArena=0;useArena<2;useArena++) {
+      LoadOptions options;
+      options.useArena = (useArena != 0);
+      double bestLoad    = std::numeric_limits<double>::infinity();
+      double bestRelease = std::numeric_limits<double>::infinity();
+      for (int run=0;run<numRuns;run++) {
+        double t0 = getCurrentTime();
+        Scene::SP scene = Scene::load(inFileName,options);
+        double t1 = getCurrentTime();
+        const size_t numInstances = scene->instances.size();
+        scene = nullptr;
+        double t2 = getCurrentTime();
+        bestLoad    = std::min(bestLoad,t1-t0);
+        bestRelease = std::min(bestRelease,t2-t1);
+        std::cout << (useArena ? "arena" : "malloc")
+                  << " run #" << run
+                  << ": load " << prettyDouble(t1-t0) << "s"
+                  << ", release " << prettyDouble(t2-t1) << "s"
+                  << " (" << prettyNumber(numInstances) << " instances)"
+                  << std::endl;
+      }
+      std::cout << (useArena ? "arena" : "malloc")
+                << ", best of " << numRuns << ": load "
+                << prettyDouble(bestLoad) << "s, release "
+                << prettyDouble(bestRelease) << "s" << std::endl;
+    }
+  }
+  
+} // ::mini
+
+int main(int ac, char **av)
+{ mini::miniBenchLoad(ac,av); return 0; }
@@ -0,0 +1,94 @@
+// ======================================================================== //
+// Copyright 2018-2020 Ingo Wald                                            //
+//                                                                          //
+// Licensed under the Apache License, Version 2.0 (the "License");          //
+// you may not use this file except in compliance with the License.         //
+// You may obtain a copy of the License at                                  //
+//                                                                          //
+//     http://www.apache.org/licenses/LICENSE-2.0                           //
+//                                                                          //
+// Unless required by applicable law or agreed to in writing, software      //
+// distributed under the License is distributed on an "AS IS" BASIS,        //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. //
+// See the License for the specific language governing permissions and      //
+// limitations under the License.                                           //
+// ======================================================================== //
+
+/* simple benchmark for the cost of serializing (ie, building a
+   SerializedScene for) and saving a given scene; e.g., for a
+   synthetic scene created with
+
+   ./miniGenScaleTest -ni 1000000 -nbs 100000 -sr 4 -tr 0 -o test.mini
+   ./miniBenchSave test.mini -n 5
+*/
+
+#include "miniScene/Scene.h"
+#include "miniScene/Serialized.h"
+
+namespace mini {
+
+  void usage(const std::string &error)
+  {
+    if (!error.empty())
+      std::cerr << MINI_TERMINAL_RED << "Error: " << error
+                << MINI_TERMINAL_DEFAULT << std::endl << std::endl;
+    std::cout << "Usage: ./miniBenchSave in.mini [-n numRuns] [-o tmpOut.mini]" << std::endl;
+    exit(error.empty()?0:1);
+  }
+  
+  void miniBenchSave(int ac, char **av)
+  {
+    std::string inFileName = "";
+    std::string outFileName = "miniBenchSave.tmp.mini";
+    int numRuns = 3;
+    for (int i=1;i<ac;i++) {
+      std::string arg = av[i];
+      if (arg == "-n")
+        numRuns = std::stoi(av[++i]);
+      else if (arg == "-o")
+        outFileName = av[++i];
+      else if (arg == "-h" || arg == "--help")
+        usage("");
+      else if (arg[0] != '-')
+        inFileName = arg;
+      else
+        usage("unknown cmdline argument '"+arg+"'");
+    }
+    if (inFileName.empty())
+      usage("no input file specified");
+
+    std::cout << MINI_TERMINAL_LIGHT_BLUE
+              << "loading mini file from " << inFileName 
+              << MINI_TERMINAL_DEFAULT << std::endl;
+    Scene::SP scene = Scene::load(inFileName);
+    std::cout << MINI_TERMINAL_LIGHT_GREEN
+              << "#miniBenchSave: scene loaded."
+              << MINI_TERMINAL_DEFAULT << std::endl;
+
+    double bestSerialize = std::numeric_limits<double>::infinity();
+    double bestSave      = std::numeric_limits<double>::infinity();
+    for (int run=0;run<numRuns;run++) {
+      double t0 = getCurrentTime();
+      SerializedScene serialized(scene.get());
+      double t1 = getCurrentTime();
+      scene->save(outFileName);
+      double t2 = getCurrentTime();
+      bestSerialize = std::min(bestSerialize,t1-t0);
+      bestSave      = std::min(bestSave,t2-t1);
+      std::cout << "run #" << run
+                << ": serialize " << prettyDouble(t1-t0) << "s"
+                << ", save " << prettyDouble(t2-t1) << "s"
+                << " (" << prettyNumber(serialized.objects.size()) << " objects, "
+                << prettyNumber(serialized.meshes.size()) << " meshes)"
+                << std::endl;
+    }
+    std::remove(outFileName.c_str());
+    std::cout << "best of " << numRuns << ": serialize "
+              << prettyDouble(bestSerialize) << "s, save "
+              << prettyDouble(bestSave) << "s" << std::endl;
+  }
+  
+} // ::mini
+
+int main(int ac, char **av)
+{ mini::miniBenchSave(ac,av); return 0; }
@@ -22,167 +22,11 @@
    based on meshes is not enoguh we will also split large meshes into
    multiple smaller ones until the desired threshold is reached. */
 
-#include "miniScene/Scene.h"
+#include "miniScene/BreakMeshes.h"
 #include "miniScene/Serialized.h"
 
 namespace mini {
 
-  std::string myPretty(size_t n)
-  {
-    if (n < 1024) return "  "+prettyNumber(n);
-
-    return "  "+prettyNumber(n)+"\t("+std::to_string(n)+")";
-  }
-
-  box3f getBounds(Mesh::SP mesh, vec3i idx)
-  {
-    box3f bounds;
-    bounds.extend(mesh->vertices[idx.x]);
-    bounds.extend(mesh->vertices[idx.y]);
-    bounds.extend(mesh->vertices[idx.z]);
-    return bounds;
-  }
-
-  uint32_t findOrExtractVertex(Mesh::SP inMesh,
-                               Mesh::SP outMesh,
-                               uint32_t vtxID,
-                               std::map<uint32_t,uint32_t> &alreadyExtracted)
-  {
-    auto it = alreadyExtracted.find(vtxID);
-    if (it != alreadyExtracted.end())
-      return it->second;
-
-    size_t newID = outMesh->vertices.size();
-    outMesh->vertices.push_back(inMesh->vertices[vtxID]);
-    if (!inMesh->normals.empty())
-      outMesh->normals.push_back(inMesh->normals[vtxID]);
-    if (!inMesh->texcoords.empty())
-      outMesh->texcoords.push_back(inMesh->texcoords[vtxID]);
-    
-    alreadyExtracted[vtxID] = newID;
-    return newID;
-  }
-  
-  Mesh::SP extractMesh(Mesh::SP in, const std::vector<vec3i> &indices)
-  {
-    std::map<uint32_t,uint32_t> alreadyExtracted;
-    Mesh::SP out = Mesh::create(in->material);
-    for (auto idx : indices) {
-      idx.x = findOrExtractVertex(in,out,idx.x,alreadyExtracted);
-      idx.y = findOrExtractVertex(in,out,idx.y,alreadyExtracted);
-      idx.z = findOrExtractVertex(in,out,idx.z,alreadyExtracted);
-      out->indices.push_back(idx);
-    }
-    return out;
-  }
-
-  std::string toString(Mesh::SP mesh)
-  {
-    std::stringstream ss;
-    ss << "#tris = " << prettyNumber(mesh->indices.size())
-       << " #vtx = " << prettyNumber(mesh->vertices.size());
-    return ss.str();
-  }
-  
-  std::vector<Mesh::SP> splitAtCenter(Mesh::SP mesh, int maxSize)
-  {
-    if (mesh->vertices.size() >= (1ull<<31))
-      throw std::runtime_error("invalid input - input mesh is ALREADY overflowing in vertex indices...");
-    std::cout << "splitting mesh w/ " << prettyNumber(mesh->indices.size()) << " triangles ..." << std::endl;
-    box3f centBounds;
-    for (auto idx : mesh->indices)
-      centBounds.extend(getBounds(mesh,idx).center());
-    std::cout << " -> centbounds " << centBounds << std::endl;
-    std::vector<vec3i> lIndices, rIndices;
-    if (centBounds.lower == centBounds.upper) {
-      for (auto idx : mesh->indices)
-        if (lIndices.size() <= rIndices.size())
-          lIndices.push_back(idx);
-        else
-          rIndices.push_back(idx);
-    } else {
-      int dim = arg_max(centBounds.size());
-      float pos = centBounds.center()[dim];
-      std::cout << " -> splitting at " << ('x'+dim) << " = " << pos << std::endl;
-      for (auto idx : mesh->indices)
-        if (getBounds(mesh,idx).center()[dim] < pos)
-          lIndices.push_back(idx);
-        else
-          rIndices.push_back(idx);
-    }
-    Mesh::SP lMesh = extractMesh(mesh,lIndices);
-    Mesh::SP rMesh = extractMesh(mesh,rIndices);
-    std::cout << " > got l = " << toString(lMesh) << std::endl;
-    std::cout << " > got r = " << toString(rMesh) << std::endl;
-    return std::vector<Mesh::SP>{ rMesh,lMesh };
-  }
-  
-  std::vector<Mesh::SP> breakMesh(Mesh::SP mesh, int maxSize)
-  {
-    std::cout << "breaking mesh w/ " << prettyNumber(mesh->indices.size()) << std::endl;
-    if (mesh->indices.size() <= maxSize)
-      return { mesh };
-
-    std::cout << " -> mesh w/ " << prettyNumber(mesh->indices.size()) << " triangles is larger than threshold of " << prettyNumber(maxSize) << " ... breaking it" << std::endl;
-    std::vector<Mesh::SP> halves = splitAtCenter(mesh,maxSize);
-    mesh = {};
-    std::vector<Mesh::SP> result;
-    for (int h = 0; h < 2; h++) {
-      for (auto frag : breakMesh(halves[h],maxSize))
-        result.push_back(frag);
-      halves[h] = 0;
-    }
-    return result;
-  }
-
-  std::vector<Object::SP> breakObject(Object::SP in, int maxSize)
-  {
-    std::vector<Object::SP> out;
-    std::vector<Mesh::SP> meshes;
-    for (auto mesh : in->meshes)
-      for (auto frag : breakMesh(mesh,maxSize))
-        meshes.push_back(frag);
-
-    size_t currentSize = 0;
-    std::vector<Mesh::SP> currentMeshes;
-    for (auto mesh : meshes) {
-      if (currentSize + mesh->indices.size() > maxSize) {
-        out.push_back(Object::create(currentMeshes));
-        currentMeshes.clear();
-        currentSize = 0;
-      } else {
-        currentMeshes.push_back(mesh);
-        currentSize += mesh->indices.size();
-      }
-    }
-    if (!currentMeshes.empty())
-      out.push_back(Object::create(currentMeshes));
-    return out;
-  }
-  
-  Scene::SP breakLargeMeshes(Scene::SP in, size_t maxMeshSize)
-  {
-    Scene::SP out = Scene::create();
-
-    out->quadLights = in->quadLights;
-    out->dirLights = in->dirLights;
-    out->envMapLight = in->envMapLight;
-    
-    std::map<Object::SP,std::vector<Object::SP>> brokenObjects;
-    for (auto inst : in->instances) 
-      brokenObjects[inst->object] = {};
-
-    for (auto &pair : brokenObjects)
-      pair.second = breakObject(pair.first,maxMeshSize);
-
-    for (auto inst : in->instances) {
-      auto &fragments = brokenObjects[inst->object];
-      for (auto frag : fragments)
-        out->instances.push_back(Instance::create(frag,inst->xfm));
-    }
-    return out;
-  }
-  
   void breakLargeMeshes(int ac, char **av)
   {
     std::string outFileName = "";
@@ -211,16 +55,21 @@ namespace mini {
               << MINI_TERMINAL_DEFAULT << std::endl;
     Scene::SP scene = Scene::load(inFileName);
     std::cout << MINI_TERMINAL_LIGHT_GREEN
-              << "#miniSeparateRootMeshes: scene loaded."
+              << "#miniBreakLargeMeshes: scene loaded."
               << MINI_TERMINAL_DEFAULT << std::endl;
     
+    double t0 = getCurrentTime();
     Scene::SP separated = breakLargeMeshes(scene,maxMeshSize);
+    double t1 = getCurrentTime();
+    std::cout << "broke " << prettyNumber(SerializedScene(scene.get()).objects.size())
+              << " objects into " << prettyNumber(SerializedScene(separated.get()).objects.size())
+              << " in " << prettyDouble(t1-t0) << "s" << std::endl;
     std::cout << MINI_TERMINAL_LIGHT_BLUE
               << "done separating; saving to " << outFileName 
               << MINI_TERMINAL_DEFAULT << std::endl;
     separated->save(outFileName);
     std::cout << MINI_TERMINAL_LIGHT_GREEN
-              << "#miniSeparateRootMeshes: scene saved."
+              << "#miniBreakLargeMeshes: scene saved."
               << MINI_TERMINAL_DEFAULT << std::endl;
   }
   
@@ -0,0 +1,106 @@
+// ======================================================================== //
+// Copyright 2018-2020 Ingo Wald                                            //
+//                                                                          //
+// Licensed under the Apache License, Version 2.0 (the "License");          //
+// you may not use this file except in compliance with the License.         //
+// You may obtain a copy of the License at                                  //
+//                                                                          //
+//     http://www.apache.org/licenses/LICENSE-2.0                           //
+//                                                                          //
+// Unless required by applicable law or agreed to in writing, software      //
+// distributed under the License is distributed on an "AS IS" BASIS,        //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. //
+// See the License for the specific language governing permissions and      //
+// limitations under the License.                                           //
+// ======================================================================== //
+
+/* builds BVHs over all objects' triangles and over all the
+   instances of a scene, prints some statistics about them, and
+   (optionally) saves the scene with those BVHs stored in the
+   file */
+
+#include "miniScene/Scene.h"
+#include "miniScene/Serialized.h"
+
+namespace mini {
+
+  void usage(const std::string &error = "")
+  {
+    if (!error.empty())
+      std::cerr << MINI_TERMINAL_RED << "Error: " << error
+                << MINI_TERMINAL_DEFAULT << std::endl << std::endl;
+    std::cout << "Usage: ./miniBuildBVH in.mini [-o out.mini] [--leaf-size N]" << std::endl;
+    exit(error.empty()?0:1);
+  }
+  
+  void miniBuildBVH(int ac, char **av)
+  {
+    std::string inFileName = "";
+    std::string outFileName = "";
+    BVH::BuildConfig config;
+    for (int i=1;i<ac;i++) {
+      std::string arg = av[i];
+      if (arg == "-o")
+        outFileName = av[++i];
+      else if (arg == "--leaf-size")
+        config.maxLeafSize = std::stoi(av[++i]);
+      else if (arg == "-h" || arg == "--help")
+        usage();
+      else if (arg[0] != '-')
+        inFileName = arg;
+      else
+        usage("unknown cmdline argument '"+arg+"'");
+    }
+    if (inFileName.empty())
+      usage("no input file specified");
+
+    std::cout << MINI_TERMINAL_LIGHT_BLUE
+              << "loading mini file from " << inFileName 
+              << MINI_TERMINAL_DEFAULT << std::endl;
+    Scene::SP scene = Scene::load(inFileName);
+    std::cout << MINI_TERMINAL_LIGHT_GREEN
+              << "#miniBuildBVH: scene loaded."
+              << MINI_TERMINAL_DEFAULT << std::endl;
+
+    double t0 = getCurrentTime();
+    scene->buildBVHs(/*rebuild:*/true,config);
+    double t1 = getCurrentTime();
+
+    SerializedScene serialized(scene.get());
+    size_t numObjectNodes = 0;
+    size_t numObjectPrims = 0;
+    double sumObjectCost  = 0.;
+    for (auto object : serialized.objects.list) {
+      numObjectNodes += object->bvh->nodes.size();
+      numObjectPrims += object->bvh->primIDs.size();
+      sumObjectCost  += object->bvh->sahCost(config);
+    }
+    std::cout << "built BVHs in " << prettyDouble(t1-t0) << "s" << std::endl;
+    std::cout << "object BVHs\t: " << prettyNumber(serialized.objects.size())
+              << " BVHs, " << prettyNumber(numObjectNodes) << " nodes over "
+              << prettyNumber(numObjectPrims) << " triangles, avg SAH cost "
+              << prettyDouble(serialized.objects.size()
+                              ? sumObjectCost/serialized.objects.size() : 0.)
+              << std::endl;
+    std::cout << "instance BVH\t: " << prettyNumber(scene->bvh->nodes.size())
+              << " nodes over " << prettyNumber(scene->bvh->primIDs.size())
+              << " instances, SAH cost " << prettyDouble(scene->bvh->sahCost(config))
+              << std::endl;
+
+    if (outFileName.empty())
+      return;
+    std::cout << MINI_TERMINAL_LIGHT_BLUE
+              << "saving to " << outFileName 
+              << MINI_TERMINAL_DEFAULT << std::endl;
+    SaveOptions options;
+    options.storeBVHs = true;
+    scene->save(outFileName,options);
+    std::cout << MINI_TERMINAL_LIGHT_GREEN
+              << "#miniBuildBVH: scene saved (with BVHs)."
+              << MINI_TERMINAL_DEFAULT << std::endl;
+  }
+  
+} // ::mini
+
+int main(int ac, char **av)
+{ mini::miniBuildBVH(ac,av); return 0; }
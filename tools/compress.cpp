@@ -0,0 +1,91 @@
+// ======================================================================== //
+// Copyright 2018-2020 Ingo Wald                                            //
+//                                                                          //
+// Licensed under the Apache License, Version 2.0 (the "License");          //
+// you may not use this file except in compliance with the License.         //
+// You may obtain a copy of the License at                                  //
+//                                                                          //
+//     http://www.apache.org/licenses/LICENSE-2.0                           //
+//                                                                          //
+// Unless required by applicable law or agreed to in writing, software      //
+// distributed under the License is distributed on an "AS IS" BASIS,        //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. //
+// See the License for the specific language governing permissions and      //
+// limitations under the License.                                           //
+// ======================================================================== //
+
+/* re-saves a .mini file with (or without) compressed mesh and
+   texture data, (optionally) quantized mesh vertices, and
+   (optionally) a packed material table */
+
+#include "miniScene/Scene.h"
+
+namespace mini {
+
+  void usage(const std::string &error = "")
+  {
+    if (!error.empty())
+      std::cerr << MINI_TERMINAL_RED << "Error: " << error
+                << MINI_TERMINAL_DEFAULT << std::endl << std::endl;
+    std::cout << "Usage: ./miniCompress in.mini -o out.mini [--codec lz|deflate|none] [--quantize] [--material-table]" << std::endl;
+    exit(error.empty()?0:1);
+  }
+  
+  void miniCompress(int ac, char **av)
+  {
+    std::string inFileName = "";
+    std::string outFileName = "";
+    SaveOptions options;
+    options.compression = compression::LZ;
+    for (int i=1;i<ac;i++) {
+      std::string arg = av[i];
+      if (arg == "-o")
+        outFileName = av[++i];
+      else if (arg == "--codec" || arg == "-c") {
+        std::string codec = av[++i];
+        if (codec == "lz")
+          options.compression = compression::LZ;
+        else if (codec == "deflate")
+          options.compression = compression::DEFLATE;
+        else if (codec == "none")
+          options.compression = compression::NONE;
+        else
+          usage("unknown codec '"+codec+"'");
+      }
+      else if (arg == "--quantize" || arg == "-q")
+        options.quantizeVertices = true;
+      else if (arg == "--material-table")
+        options.storeMaterialTable = true;
+      else if (arg == "-h" || arg == "--help")
+        usage();
+      else if (arg[0] != '-')
+        inFileName = arg;
+      else
+        usage("unknown cmdline argument '"+arg+"'");
+    }
+    if (inFileName.empty())
+      usage("no input file specified");
+    if (outFileName.empty())
+      usage("no output file specified");
+    if (!compression::isSupported(options.compression))
+      usage("requested codec not supported in this build (rebuild with MINI_USE_ZLIB)");
+
+    std::cout << MINI_TERMINAL_LIGHT_BLUE
+              << "loading mini file from " << inFileName 
+              << MINI_TERMINAL_DEFAULT << std::endl;
+    LoadOptions loadOptions;
+    loadOptions.keepQuantized = true;
+    Scene::SP scene = Scene::load(inFileName,loadOptions);
+    std::cout << MINI_TERMINAL_LIGHT_BLUE
+              << "saving to " << outFileName 
+              << MINI_TERMINAL_DEFAULT << std::endl;
+    scene->save(outFileName,options);
+    std::cout << MINI_TERMINAL_LIGHT_GREEN
+              << "#miniCompress: scene saved."
+              << MINI_TERMINAL_DEFAULT << std::endl;
+  }
+  
+} // ::mini
+
+int main(int ac, char **av)
+{ mini::miniCompress(ac,av); return 0; }
@@ -15,7 +15,6 @@
 // ======================================================================== //
 
 #include "miniScene/Scene.h"
-#include "miniScene/Serialized.h"
 #include <fstream>
 
 namespace mini {
@@ -44,16 +43,19 @@ namespace mini {
       throw std::runtime_error("no input file specified");
 
     std::cout << MINI_TERMINAL_LIGHT_BLUE
-              << "loading mini file from " << inFileName 
-              << MINI_TERMINAL_DEFAULT << std::endl;
-    Scene::SP scene = Scene::load(inFileName);
-    std::cout << MINI_TERMINAL_LIGHT_GREEN
-              << "#miniDumpBBs: scene loaded."
+              << "streaming mini file from " << inFileName 
               << MINI_TERMINAL_DEFAULT << std::endl;
+    SceneReader reader(inFileName);
 
+    std::ofstream out(outFileName,std::ios::binary);
     std::vector<box3f> boxes;
-    for (auto inst : scene->instances) {
+    size_t numBoxesWritten = 0;
+    Instance::SP inst;
+    while (reader.next(inst)) {
+      if (!inst) continue;
       for (auto mesh : inst->object->meshes) {
+        mesh->ensureLoaded();
+        boxes.clear();
         for (auto idx : mesh->indices) {
           box3f bb;
           bb.extend(xfmPoint(inst->xfm,mesh->vertices[idx.x]));
@@ -61,14 +63,13 @@ namespace mini {
           bb.extend(xfmPoint(inst->xfm,mesh->vertices[idx.z]));
           boxes.push_back(bb);
         }
+        out.write((const char *)boxes.data(),boxes.size()*sizeof(box3f));
+        numBoxesWritten += boxes.size();
       }
     }
-
-    std::ofstream out(outFileName,std::ios::binary);
-    out.write((const char *)boxes.data(),boxes.size()*sizeof(box3f));
     if (!out.good()) throw std::runtime_error("error in writing array of boxes...");
     std::cout << MINI_TERMINAL_GREEN
-              << "done. written " << prettyNumber(boxes.size())
+              << "done. written " << prettyNumber(numBoxesWritten)
               << " boxes to " << outFileName << MINI_TERMINAL_DEFAULT << std::endl;
   }
   
@@ -15,7 +15,6 @@
 // ======================================================================== //
 
 #include "miniScene/Scene.h"
-#include "miniScene/Serialized.h"
 
 namespace mini {
 
@@ -26,89 +25,46 @@ namespace mini {
     return "  "+prettyNumber(n)+"\t("+std::to_string(n)+")";
   }
   
-  void printInfo(Scene::SP scene)
+  void printInfo(const SceneInfo &info)
   {
-    SerializedScene serialized(scene.get());
     std::cout << "----" << std::endl;
-    std::cout << "num instances\t\t: " << myPretty(scene->instances.size()) << std::endl;
-    std::cout << "num objects\t\t: " << myPretty(serialized.objects.size()) << std::endl;
+    std::cout << "num instances\t\t: " << myPretty(info.numInstances) << std::endl;
+    std::cout << "num objects\t\t: " << myPretty(info.numObjects) << std::endl;
 
-    size_t numUniqueMeshes = 0;
-    size_t numUniqueTriangles = 0;
-    size_t numUniqueVertices = 0;
-    
-    for (auto mesh : serialized.meshes.list) {
-      numUniqueMeshes++;
-      numUniqueTriangles += mesh->indices.size();
-      numUniqueVertices  += mesh->vertices.size();
-    }
     std::cout << "----" << std::endl;
-    std::cout << "num *unique* meshes\t: "    << myPretty(numUniqueMeshes) << std::endl;
-    std::cout << "num *unique* triangles\t: " << myPretty(numUniqueTriangles) << std::endl;
-    std::cout << "num *unique* vertices\t: "  << myPretty(numUniqueVertices) << std::endl;
+    std::cout << "num *unique* meshes\t: "    << myPretty(info.numUniqueMeshes) << std::endl;
+    std::cout << "num *unique* triangles\t: " << myPretty(info.numUniqueTriangles) << std::endl;
+    std::cout << "num *unique* vertices\t: "  << myPretty(info.numUniqueVertices) << std::endl;
 
-    size_t numActualMeshes = 0;
-    size_t numActualTriangles = 0;
-    size_t numActualVertices = 0;
-    size_t numActualNormals = 0;
-    size_t numActualTexcoords = 0;
-    
-    for (auto inst : scene->instances)
-      if (inst && inst->object)
-        for (auto mesh : inst->object->meshes) {
-          numActualMeshes++;
-          numActualTriangles += mesh->indices.size();
-          numActualVertices  += mesh->vertices.size();
-          numActualNormals  += mesh->normals.size();
-          numActualTexcoords  += mesh->texcoords.size();
-        }
-    
     std::cout << "----" << std::endl;
-    std::cout << "num *actual* meshes\t: "    << myPretty(numActualMeshes) << std::endl;
-    std::cout << "num *actual* triangles\t: " << myPretty(numActualTriangles) << std::endl;
-    std::cout << "num *actual* vertices\t: "  << myPretty(numActualVertices) << std::endl;
-    std::cout << "num *actual* normals\t: "  << myPretty(numActualNormals) << std::endl;
-    std::cout << "num *actual* texcoords\t: "  << myPretty(numActualTexcoords) << std::endl;
+    std::cout << "num *actual* meshes\t: "    << myPretty(info.numActualMeshes) << std::endl;
+    std::cout << "num *actual* triangles\t: " << myPretty(info.numActualTriangles) << std::endl;
+    std::cout << "num *actual* vertices\t: "  << myPretty(info.numActualVertices) << std::endl;
+    std::cout << "num *actual* normals\t: "  << myPretty(info.numActualNormals) << std::endl;
+    std::cout << "num *actual* texcoords\t: "  << myPretty(info.numActualTexcoords) << std::endl;
     
 
 
     std::cout << "----" << std::endl;
-    size_t numTextures = 0;
-    size_t numPtex = 0;
-    size_t bytesPtex = 0;
-    size_t bytesTexels = 0;
-    for (auto tex : serialized.textures.list)
-      if (tex) {
-        numTextures++;
-        switch (tex->format) {
-        case mini::Texture::EMBEDDED_PTEX: 
-          numPtex++;
-          bytesPtex += tex->data.size();
-          break;
-        default:
-          bytesTexels += tex->data.size();
-          break;
-        };
-      }
-    std::cout << "num textures\t\t: " << myPretty(numTextures) << std::endl;
-    std::cout << " - num *ptex* textures\t: " << myPretty(numPtex) << std::endl;
-    std::cout << " - num *image* textures\t: " << myPretty(serialized.textures.size()-numPtex) << std::endl;
-    std::cout << "total size of textures\t: " << myPretty(bytesPtex+bytesTexels) << std::endl;
-    std::cout << " - #bytes in ptex\t: " << myPretty(bytesPtex) << std::endl;
-    std::cout << " - #byte in texels\t: " << myPretty(bytesTexels) << std::endl;
-    std::cout << "num materials\t\t: " << myPretty(serialized.materials.size()) << std::endl;
-    std::cout << "num quad lights\t\t: " << myPretty(scene->quadLights.size()) << std::endl;
-    std::cout << "num dir lights\t\t: " << myPretty(scene->dirLights.size()) << std::endl;
-    if (scene->envMapLight)
+    std::cout << "num textures\t\t: " << myPretty(info.numTextures) << std::endl;
+    std::cout << " - num *ptex* textures\t: " << myPretty(info.numPtexTextures) << std::endl;
+    std::cout << " - num *image* textures\t: " << myPretty(info.numTextures-info.numPtexTextures) << std::endl;
+    std::cout << "total size of textures\t: " << myPretty(info.numPtexBytes+info.numTexelBytes) << std::endl;
+    std::cout << " - #bytes in ptex\t: " << myPretty(info.numPtexBytes) << std::endl;
+    std::cout << " - #byte in texels\t: " << myPretty(info.numTexelBytes) << std::endl;
+    std::cout << "num materials\t\t: " << myPretty(info.numMaterials) << std::endl;
+    std::cout << "num quad lights\t\t: " << myPretty(info.numQuadLights) << std::endl;
+    std::cout << "num dir lights\t\t: " << myPretty(info.numDirLights) << std::endl;
+    if (info.envMapSize != vec2i(0))
       std::cout << "has env-map light?\t: yes, with " 
-                << scene->envMapLight->texture->size.x
+                << info.envMapSize.x
                 << "x"
-                << scene->envMapLight->texture->size.y
+                << info.envMapSize.y
                 << " texels" << std::endl;
     else
       std::cout << "has env-map light?\t: no"  << std::endl;
 
-    std::cout << "bounding box\t: " << scene->getBounds() << std::endl;
+    std::cout << "bounding box\t: " << info.bounds << std::endl;
   }
     
   void miniInfo(int ac, char **av)
@@ -125,14 +81,14 @@ namespace mini {
       throw std::runtime_error("no input file specified");
 
     std::cout << MINI_TERMINAL_LIGHT_BLUE
-              << "loading mini file from " << inFileName 
+              << "reading scene info from " << inFileName 
               << MINI_TERMINAL_DEFAULT << std::endl;
-    Scene::SP scene = Scene::load(inFileName);
+    SceneInfo info = Scene::peekInfo(inFileName);
     std::cout << MINI_TERMINAL_LIGHT_GREEN
-              << "#miniInfo: scene loaded."
+              << "#miniInfo: scene info read."
               << MINI_TERMINAL_DEFAULT << std::endl;
 
-    printInfo(scene);
+    printInfo(info);
   }
   
 } // ::mini
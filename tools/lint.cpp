@@ -108,6 +108,7 @@ namespace mini {
           throw std::runtime_error("mesh without material!");
         checkFishy(mesh->material,"material");
 
+        mesh->ensureLoaded();
         if (mesh->vertices.empty())
           throw std::runtime_error("mesh without any vertices!");
         if (mesh->indices.empty())
@@ -71,6 +71,7 @@ namespace mini {
           if (out->instances.size() == 1 && out->instances[0]->xfm == affine3f()) {
             for (auto mesh : inst->object->meshes)
               out->instances[0]->object->meshes.push_back(mesh);
+            out->instances[0]->object->cachedBounds.invalidate();
             continue;
           }
         }
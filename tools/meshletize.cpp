@@ -0,0 +1,122 @@
+// ======================================================================== //
+// Copyright 2018-2020 Ingo Wald                                            //
+//                                                                          //
+// Licensed under the Apache License, Version 2.0 (the "License");          //
+// you may not use this file except in compliance with the License.         //
+// You may obtain a copy of the License at                                  //
+//                                                                          //
+//     http://www.apache.org/licenses/LICENSE-2.0                           //
+//                                                                          //
+// Unless required by applicable law or agreed to in writing, software      //
+// distributed under the License is distributed on an "AS IS" BASIS,        //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. //
+// See the License for the specific language governing permissions and      //
+// limitations under the License.                                           //
+// ======================================================================== //
+
+/* builds meshlets (small clusters of triangles, with bounds and
+   normal cones; see mini::Meshlets) for all meshes of a scene, prints
+   some statistics about them, and (optionally) saves the scene with
+   the meshlets stored in the file */
+
+#include "miniScene/Scene.h"
+#include "miniScene/Serialized.h"
+#include <iomanip>
+
+namespace mini {
+
+  std::string fixed1(double d)
+  {
+    std::stringstream ss;
+    ss << std::fixed << std::setprecision(1) << d;
+    return ss.str();
+  }
+
+  void usage(const std::string &error = "")
+  {
+    if (!error.empty())
+      std::cerr << MINI_TERMINAL_RED << "Error: " << error
+                << MINI_TERMINAL_DEFAULT << std::endl << std::endl;
+    std::cout << "Usage: ./miniMeshletize in.mini [-o out.mini] [--max-vertices N] [--max-triangles N]" << std::endl;
+    exit(error.empty()?0:1);
+  }
+  
+  void miniMeshletize(int ac, char **av)
+  {
+    std::string inFileName = "";
+    std::string outFileName = "";
+    Meshlets::BuildConfig config;
+    for (int i=1;i<ac;i++) {
+      std::string arg = av[i];
+      if (arg == "-o")
+        outFileName = av[++i];
+      else if (arg == "--max-vertices")
+        config.maxVertices = std::stoi(av[++i]);
+      else if (arg == "--max-triangles")
+        config.maxTriangles = std::stoi(av[++i]);
+      else if (arg == "-h" || arg == "--help")
+        usage();
+      else if (arg[0] != '-')
+        inFileName = arg;
+      else
+        usage("unknown cmdline argument '"+arg+"'");
+    }
+    if (inFileName.empty())
+      usage("no input file specified");
+
+    std::cout << MINI_TERMINAL_LIGHT_BLUE
+              << "loading mini file from " << inFileName 
+              << MINI_TERMINAL_DEFAULT << std::endl;
+    Scene::SP scene = Scene::load(inFileName);
+    std::cout << MINI_TERMINAL_LIGHT_GREEN
+              << "#miniMeshletize: scene loaded."
+              << MINI_TERMINAL_DEFAULT << std::endl;
+
+    double t0 = getCurrentTime();
+    scene->buildMeshlets(/*rebuild:*/true,config);
+    double t1 = getCurrentTime();
+
+    SerializedScene serialized(scene.get());
+    size_t numMeshlets  = 0;
+    size_t numTriangles = 0;
+    size_t numVertices  = 0;
+    size_t numMeshletVertices = 0;
+    size_t numCullable  = 0;
+    for (auto &mesh : serialized.meshes.list) {
+      numTriangles += mesh->getNumPrims();
+      numVertices  += mesh->getNumVertices();
+      numMeshlets  += mesh->meshlets->meshlets.size();
+      numMeshletVertices += mesh->meshlets->vertices.size();
+      for (auto &meshlet : mesh->meshlets->meshlets)
+        numCullable += (meshlet.coneCutoff < 1.f);
+    }
+    std::cout << "built meshlets in " << prettyDouble(t1-t0) << "s" << std::endl;
+    std::cout << "meshlets\t: " << prettyNumber(numMeshlets) << " over "
+              << prettyNumber(serialized.meshes.size()) << " meshes, "
+              << prettyNumber(numCullable) << " with usable normal cones" << std::endl;
+    if (numMeshlets) {
+      std::cout << "avg fill\t: "
+                << fixed1(numTriangles/double(numMeshlets)) << " triangles, "
+                << fixed1(numMeshletVertices/double(numMeshlets)) << " vertices"
+                << " (max " << config.maxTriangles << "/" << config.maxVertices << ")"
+                << std::endl;
+      std::cout << "vertex overhead\t: "
+                << fixed1(numMeshletVertices/double(std::max(numVertices,size_t(1))))
+                << "x (meshlet vertices per mesh vertex)" << std::endl;
+    }
+
+    if (outFileName.empty())
+      return;
+    std::cout << MINI_TERMINAL_LIGHT_BLUE
+              << "saving to " << outFileName 
+              << MINI_TERMINAL_DEFAULT << std::endl;
+    scene->save(outFileName);
+    std::cout << MINI_TERMINAL_LIGHT_GREEN
+              << "#miniMeshletize: scene saved (with meshlets)."
+              << MINI_TERMINAL_DEFAULT << std::endl;
+  }
+  
+} // ::mini
+
+int main(int ac, char **av)
+{ mini::miniMeshletize(ac,av); return 0; }
@@ -56,6 +56,7 @@ namespace mini {
         Mesh::SP mesh = object->meshes[meshID];
         if (!mesh)
           continue;
+        mesh->ensureLoaded();
         std::cout << "\r# writing inst " << instID << "/" << scene->instances.size()
                   << " mesh " << meshID << "/" << object->meshes.size()
                   << "         " << std::flush;
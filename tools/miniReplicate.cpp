@@ -76,6 +76,8 @@ namespace mini {
       std::mt19937 re(rd());
       std::uniform_real_distribution<float> rng(0.f, 1.f);
 
+      SceneWriter::SP writer;
+      size_t numInstancesWritten = 0;
 
       for (int i=0;i<numReplications;i++) {
         float u = rng(re);
@@ -91,10 +93,10 @@ namespace mini {
         if (flat) {
           for (auto org : in->instances) {
 #if 1
-            for (auto mesh : org->object->meshes) {
+            for (auto &mesh : org->object->meshes) {
+              // (a distinct mesh, but without a copy of its arrays)
               Object::SP newObj = std::make_shared<Object>();
-              Mesh::SP newMesh = std::make_shared<Mesh>();
-              *newMesh = *mesh;
+              Mesh::SP newMesh = Mesh::createSharedCopy(mesh);
               newObj->meshes.push_back(newMesh);
               Instance::SP newInst = std::make_shared<Instance>(newObj,
                                                                 xfm*org->xfm);
@@ -102,9 +104,8 @@ namespace mini {
             }
 #else
             Object::SP newObj = std::make_shared<Object>();
-            for (auto mesh : org->object->meshes) {
-              Mesh::SP newMesh = std::make_shared<Mesh>();
-              *newMesh = *mesh;
+            for (auto &mesh : org->object->meshes) {
+              Mesh::SP newMesh = Mesh::createSharedCopy(mesh);
               newObj->meshes.push_back(newMesh);
             }
             out->instances.push_back(std::make_shared<Instance>(newObj,
@@ -112,19 +113,40 @@ namespace mini {
 #endif
           }
         } else {
+          // all replicas instantiate the same objects, so once the
+          // first replica got written (along with those objects) all
+          // others can get streamed straight to the file, without
+          // ever having all instances in memory
           for (auto org : in->instances) {
             out->instances.push_back(std::make_shared<Instance>(org->object,
                                                                 xfm*org->xfm));
           }
+          if (!writer) {
+            std::cout << MINI_TERMINAL_LIGHT_BLUE
+                      << "streaming to " << outFileName 
+                      << MINI_TERMINAL_DEFAULT << std::endl;
+            writer = std::make_shared<SceneWriter>(outFileName,out.get());
+          } else
+            for (auto inst : out->instances)
+              writer->write(inst);
+          numInstancesWritten += out->instances.size();
+          out->instances.clear();
         }
       }
-      std::cout << "created instantiated scene with " << out->instances.size() << " instances total" << std::endl;
+
+      if (writer) {
+        std::cout << "streamed instantiated scene with "
+                  << numInstancesWritten << " instances total" << std::endl;
+        writer->close();
+      } else {
+        std::cout << "created instantiated scene with " << out->instances.size() << " instances total" << std::endl;
         
-      std::cout << MINI_TERMINAL_LIGHT_BLUE
-                << "saving to " << outFileName 
-                << MINI_TERMINAL_DEFAULT << std::endl;
-      // writeToOBJ(out,outFileName);
-      out->save(outFileName);
+        std::cout << MINI_TERMINAL_LIGHT_BLUE
+                  << "saving to " << outFileName 
+                  << MINI_TERMINAL_DEFAULT << std::endl;
+        // writeToOBJ(out,outFileName);
+        out->save(outFileName);
+      }
       std::cout << MINI_TERMINAL_LIGHT_GREEN
                 << "#brixReplicate: replicated model written...."
                 << MINI_TERMINAL_DEFAULT << std::endl;
@@ -0,0 +1,127 @@
+// ======================================================================== //
+// Copyright 2018-2020 Ingo Wald                                            //
+//                                                                          //
+// Licensed under the Apache License, Version 2.0 (the "License");          //
+// you may not use this file except in compliance with the License.         //
+// You may obtain a copy of the License at                                  //
+//                                                                          //
+//     http://www.apache.org/licenses/LICENSE-2.0                           //
+//                                                                          //
+// Unless required by applicable law or agreed to in writing, software      //
+// distributed under the License is distributed on an "AS IS" BASIS,        //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. //
+// See the License for the specific language governing permissions and      //
+// limitations under the License.                                           //
+// ======================================================================== //
+
+/* optimizes the triangle and vertex order of all meshes of a scene
+   for GPU vertex processing (see mini::optimizeMesh()), reports
+   simulated vertex cache and vertex fetch statistics before and
+   after, and (optionally) saves the result */
+
+#include "miniScene/Optimize.h"
+#include "miniScene/Serialized.h"
+#include <iomanip>
+
+namespace mini {
+
+  void usage(const std::string &error = "")
+  {
+    if (!error.empty())
+      std::cerr << MINI_TERMINAL_RED << "Error: " << error
+                << MINI_TERMINAL_DEFAULT << std::endl << std::endl;
+    std::cout << "Usage: ./miniOptimize in.mini [-o out.mini] [--cache-size N]" << std::endl;
+    std::cout << "  --cache-size N : size of the FIFO vertex cache simulated for the statistics (default 16)" << std::endl;
+    exit(error.empty()?0:1);
+  }
+
+  /*! statistics over all meshes, weighted by their number of
+      triangles (acmr) or vertices (atvr, overfetch) */
+  MeshOrderStats analyzeScene(const SerializedScene &serialized, int cacheSize)
+  {
+    std::vector<MeshOrderStats> perMesh(serialized.meshes.size());
+    parallel_for
+      (perMesh.size(),
+       [&](size_t meshID) {
+         perMesh[meshID] = analyzeMeshOrder(*serialized.meshes.list[meshID],cacheSize);
+       });
+    MeshOrderStats total;
+    double numPrims = 0., numVertices = 0.;
+    for (size_t meshID=0;meshID<perMesh.size();meshID++) {
+      const Mesh &mesh = *serialized.meshes.list[meshID];
+      total.acmr      += perMesh[meshID].acmr*mesh.getNumPrims();
+      total.atvr      += perMesh[meshID].atvr*mesh.getNumVertices();
+      total.overfetch += perMesh[meshID].overfetch*mesh.getNumVertices();
+      numPrims    += mesh.getNumPrims();
+      numVertices += mesh.getNumVertices();
+    }
+    if (numPrims > 0.)    total.acmr /= numPrims;
+    if (numVertices > 0.) {
+      total.atvr      /= numVertices;
+      total.overfetch /= numVertices;
+    }
+    return total;
+  }
+
+  void print(const std::string &what, const MeshOrderStats &stats)
+  {
+    std::cout << what << std::fixed << std::setprecision(3)
+              << "ACMR " << stats.acmr
+              << ", ATVR " << stats.atvr
+              << ", overfetch " << stats.overfetch
+              << std::defaultfloat << std::endl;
+  }
+  
+  void miniOptimize(int ac, char **av)
+  {
+    std::string inFileName = "";
+    std::string outFileName = "";
+    int cacheSize = 16;
+    for (int i=1;i<ac;i++) {
+      std::string arg = av[i];
+      if (arg == "-o")
+        outFileName = av[++i];
+      else if (arg == "--cache-size")
+        cacheSize = std::stoi(av[++i]);
+      else if (arg == "-h" || arg == "--help")
+        usage();
+      else if (arg[0] != '-')
+        inFileName = arg;
+      else
+        usage("unknown cmdline argument '"+arg+"'");
+    }
+    if (inFileName.empty())
+      usage("no input file specified");
+
+    std::cout << MINI_TERMINAL_LIGHT_BLUE
+              << "loading mini file from " << inFileName 
+              << MINI_TERMINAL_DEFAULT << std::endl;
+    Scene::SP scene = Scene::load(inFileName);
+    std::cout << MINI_TERMINAL_LIGHT_GREEN
+              << "#miniOptimize: scene loaded."
+              << MINI_TERMINAL_DEFAULT << std::endl;
+
+    SerializedScene serialized(scene.get());
+    print("before\t: ",analyzeScene(serialized,cacheSize));
+    double t0 = getCurrentTime();
+    optimizeMeshes(scene);
+    double t1 = getCurrentTime();
+    print("after\t: ",analyzeScene(serialized,cacheSize));
+    std::cout << "optimized " << prettyNumber(serialized.meshes.size())
+              << " meshes in " << prettyDouble(t1-t0) << "s" << std::endl;
+    
+    if (outFileName.empty())
+      return;
+    std::cout << MINI_TERMINAL_LIGHT_BLUE
+              << "saving to " << outFileName 
+              << MINI_TERMINAL_DEFAULT << std::endl;
+    scene->save(outFileName);
+    std::cout << MINI_TERMINAL_LIGHT_GREEN
+              << "#miniOptimize: scene saved."
+              << MINI_TERMINAL_DEFAULT << std::endl;
+  }
+  
+} // ::mini
+
+int main(int ac, char **av)
+{ mini::miniOptimize(ac,av); return 0; }
@@ -0,0 +1,238 @@
+// ======================================================================== //
+// Copyright 2018-2020 Ingo Wald                                            //
+//                                                                          //
+// Licensed under the Apache License, Version 2.0 (the "License");          //
+// you may not use this file except in compliance with the License.         //
+// You may obtain a copy of the License at                                  //
+//                                                                          //
+//     http://www.apache.org/licenses/LICENSE-2.0                           //
+//                                                                          //
+// Unless required by applicable law or agreed to in writing, software      //
+// distributed under the License is distributed on an "AS IS" BASIS,        //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. //
+// See the License for the specific language governing permissions and      //
+// limitations under the License.                                           //
+// ======================================================================== //
+
+/* benchmarks mini::Intersector on a scene: traces primary rays (one
+   ray at a time, and in packets) and shadow rays from a default
+   camera, reports rays per second, and (optionally) writes a simple
+   shaded image of the scene. With --check-bvhs it also re-traces the
+   primary rays with all BVHs rebuilt from scratch, and reports rays
+   that hit differently - e.g., because BVHs stored in the file do
+   not match the geometry read back from it */
+
+#include "miniScene/Intersector.h"
+#include <fstream>
+
+namespace mini {
+
+  void usage(const std::string &error = "")
+  {
+    if (!error.empty())
+      std::cerr << MINI_TERMINAL_RED << "Error: " << error
+                << MINI_TERMINAL_DEFAULT << std::endl << std::endl;
+    std::cout << "Usage: ./miniRayBench in.mini [-res W H] [-o image.ppm] [--check-bvhs]" << std::endl;
+    exit(error.empty()?0:1);
+  }
+
+  template<typename Lambda>
+  double timed(const Lambda &lambda)
+  {
+    double t0 = getCurrentTime();
+    lambda();
+    return getCurrentTime()-t0;
+  }
+  
+  void miniRayBench(int ac, char **av)
+  {
+    std::string inFileName = "";
+    std::string outFileName = "";
+    vec2i res(1024,768);
+    bool checkBVHs = false;
+    for (int i=1;i<ac;i++) {
+      std::string arg = av[i];
+      if (arg == "-o")
+        outFileName = av[++i];
+      else if (arg == "--check-bvhs")
+        checkBVHs = true;
+      else if (arg == "-res") {
+        res.x = std::stoi(av[++i]);
+        res.y = std::stoi(av[++i]);
+      } else if (arg == "-h" || arg == "--help")
+        usage();
+      else if (arg[0] != '-')
+        inFileName = arg;
+      else
+        usage("unknown cmdline argument '"+arg+"'");
+    }
+    if (inFileName.empty())
+      usage("no input file specified");
+    
+    std::cout << MINI_TERMINAL_LIGHT_BLUE
+              << "loading mini file from " << inFileName 
+              << MINI_TERMINAL_DEFAULT << std::endl;
+    Scene::SP scene = Scene::load(inFileName);
+    std::cout << MINI_TERMINAL_LIGHT_GREEN
+              << "#miniRayBench: scene loaded."
+              << MINI_TERMINAL_DEFAULT << std::endl;
+
+    Intersector::SP intersector;
+    double buildTime = timed([&]{ intersector = Intersector::create(scene); });
+    std::cout << "built intersector in " << prettyDouble(buildTime) << "s" << std::endl;
+
+    // default camera: looking at the center of the scene, from a
+    // bit up front
+    const box3f bounds = scene->getBounds();
+    if (bounds.empty())
+      throw std::runtime_error("scene is empty - nothing to trace");
+    const vec3f at   = bounds.center();
+    const vec3f from = at + normalize(vec3f(-.4f,.6f,1.3f))*length(bounds.size());
+    const vec3f up(0.f,1.f,0.f);
+    const vec3f dir  = normalize(at-from);
+    const float aspect = res.x/float(res.y);
+    const vec3f du = normalize(cross(dir,up))*aspect*.6f;
+    const vec3f dv = normalize(cross(du,dir))*.6f;
+    
+    // primary rays, in rows of pixels (so that consecutive rays -
+    // which become packets - are coherent)
+    std::vector<Ray> primary(size_t(res.x)*res.y);
+    parallel_for
+      (res.y,
+       [&](size_t iy) {
+         for (int ix=0;ix<res.x;ix++) {
+           const float sx = 2.f*(ix+.5f)/res.x-1.f;
+           const float sy = 1.f-2.f*(iy+.5f)/res.y;
+           primary[iy*res.x+ix] = Ray(from,normalize(dir+sx*du+sy*dv));
+         }
+       });
+
+    const size_t numRays = primary.size();
+    std::vector<Hit> hits(numRays);
+    double singleTime = timed([&]{
+        parallel_for_blocked
+          (0,numRays,1024,
+           [&](size_t begin, size_t end) {
+             for (size_t i=begin;i<end;i++)
+               hits[i] = intersector->intersect(primary[i]);
+           });
+      });
+    std::vector<Hit> packetHits;
+    double packetTime = timed([&]{ intersector->intersect(primary,packetHits); });
+    size_t numHits = 0;
+    size_t numMismatches = 0;
+    for (size_t i=0;i<numRays;i++) {
+      numHits += hits[i].hadHit();
+      numMismatches += (hits[i].instID != packetHits[i].instID
+                        || hits[i].primID != packetHits[i].primID);
+    }
+
+    // shadow rays, from all hit points towards a point light above
+    // the scene
+    const vec3f lightPos = at + vec3f(.3f,1.f,.2f)*length(bounds.size());
+    std::vector<Ray> shadow(numRays);
+    for (size_t i=0;i<numRays;i++) {
+      if (!hits[i].hadHit())
+        shadow[i] = Ray(vec3f(0.f),vec3f(1.f),0.f,0.f);
+      else {
+        const vec3f P = primary[i].origin + hits[i].t*primary[i].direction;
+        shadow[i] = Ray(P,lightPos-P,1e-4f,1.f);
+      }
+    }
+    std::vector<uint8_t> occluded;
+    double singleShadowTime = timed([&]{
+        occluded.resize(numRays);
+        parallel_for_blocked
+          (0,numRays,1024,
+           [&](size_t begin, size_t end) {
+             for (size_t i=begin;i<end;i++)
+               occluded[i] = intersector->occluded(shadow[i]);
+           });
+      });
+    double packetShadowTime = timed([&]{ intersector->occluded(shadow,occluded); });
+
+    auto mrays = [&](double seconds) {
+      return prettyDouble(numRays/std::max(seconds,1e-9))+"rays/s";
+    };
+    std::cout << "primary rays\t: " << prettyNumber(numRays) << " ("
+              << prettyNumber(numHits) << " hits)" << std::endl;
+    std::cout << " single rays\t: " << prettyDouble(singleTime) << "s, "
+              << mrays(singleTime) << std::endl;
+    std::cout << " packets of " << Intersector::PACKET_SIZE << "\t: "
+              << prettyDouble(packetTime) << "s, " << mrays(packetTime) << std::endl;
+    std::cout << "shadow rays\t: " << prettyNumber(numRays) << std::endl;
+    std::cout << " single rays\t: " << prettyDouble(singleShadowTime) << "s, "
+              << mrays(singleShadowTime) << std::endl;
+    std::cout << " packets of " << Intersector::PACKET_SIZE << "\t: "
+              << prettyDouble(packetShadowTime) << "s, "
+              << mrays(packetShadowTime) << std::endl;
+    if (numMismatches)
+      std::cout << MINI_TERMINAL_RED
+                << "warning: " << prettyNumber(numMismatches)
+                << " rays hit different triangles as single rays and in packets"
+                << MINI_TERMINAL_DEFAULT << std::endl;
+
+    if (checkBVHs) {
+      // the intersector above used whatever BVHs the file had stored;
+      // rebuild all of them, and compare
+      scene->buildBVHs(/*rebuildObjectBVHs*/true);
+      Intersector::SP rebuilt = Intersector::create(scene);
+      // (rays through a shared edge may legitimately report either
+      // triangle, so only compare whether, and how far away, they hit)
+      size_t numDifferent = 0;
+      for (size_t i=0;i<numRays;i++) {
+        const Hit hit = rebuilt->intersect(primary[i]);
+        numDifferent += (hit.hadHit() != hits[i].hadHit()
+                         || (hit.hadHit() && hit.t != hits[i].t));
+      }
+      if (numDifferent)
+        std::cout << MINI_TERMINAL_RED
+                  << "warning: " << prettyNumber(numDifferent)
+                  << " rays hit differently with rebuilt BVHs"
+                  << MINI_TERMINAL_DEFAULT << std::endl;
+      else
+        std::cout << MINI_TERMINAL_LIGHT_GREEN
+                  << "all rays hit the same with rebuilt BVHs"
+                  << MINI_TERMINAL_DEFAULT << std::endl;
+    }
+    
+    if (outFileName.empty())
+      return;
+    
+    // simple 'eyelight' shading of the geometric normal, darkened
+    // where in shadow
+    std::vector<uint8_t> pixels(3*numRays);
+    for (size_t i=0;i<numRays;i++) {
+      float gray = .1f;
+      const Hit &hit = hits[i];
+      if (hit.hadHit()) {
+        const Instance::SP &inst = scene->instances[hit.instID];
+        const Mesh::SP &mesh = inst->object->meshes[hit.meshID];
+        const vec3i idx = mesh->getTriangle(hit.primID);
+        const vec3f v0 = xfmPoint(inst->xfm,mesh->getVertex(idx.x));
+        const vec3f v1 = xfmPoint(inst->xfm,mesh->getVertex(idx.y));
+        const vec3f v2 = xfmPoint(inst->xfm,mesh->getVertex(idx.z));
+        const vec3f N = cross(v1-v0,v2-v0);
+        const float lenN = length(N);
+        gray = .2f + .8f*(lenN > 0.f
+                          ? fabsf(dot(N,primary[i].direction))/lenN
+                          : 1.f);
+        if (occluded[i]) gray *= .5f;
+      }
+      const uint8_t c = (uint8_t)std::min(255.f,255.f*gray);
+      pixels[3*i+0] = pixels[3*i+1] = pixels[3*i+2] = c;
+    }
+    std::ofstream out(outFileName,std::ios::binary);
+    if (!out.good())
+      throw std::runtime_error("could not open '"+outFileName+"' for writing");
+    out << "P6\n" << res.x << " " << res.y << "\n255\n";
+    out.write((const char *)pixels.data(),pixels.size());
+    std::cout << MINI_TERMINAL_LIGHT_GREEN
+              << "#miniRayBench: image written to " << outFileName
+              << MINI_TERMINAL_DEFAULT << std::endl;
+  }
+  
+} // ::mini
+
+int main(int ac, char **av)
+{ mini::miniRayBench(ac,av); return 0; }
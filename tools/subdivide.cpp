@@ -62,12 +62,28 @@ namespace mini {
 
   Mesh::SP subdivide(Mesh::SP in)
   {
+    in->ensureLoaded();
     Mesh::SP out = Mesh::create(in->material);
 
-    // Put original vertices to new mesh
-    out->vertices  = in->vertices;
-    out->normals   = in->normals;
-    out->texcoords = in->texcoords;
+    // Put original vertices to new mesh - with room for the midpoints
+    // (about 1.5 per triangle for a closed mesh), so appending those
+    // doesn't keep re-allocating (and copying) the arrays
+    const size_t numVertices
+      = in->vertices.size() + 3*in->indices.size()/2;
+    out->vertices.reserve(numVertices);
+    out->vertices.insert(out->vertices.end(),
+                         in->vertices.begin(),in->vertices.end());
+    if (!in->normals.empty()) {
+      out->normals.reserve(numVertices);
+      out->normals.insert(out->normals.end(),
+                          in->normals.begin(),in->normals.end());
+    }
+    if (!in->texcoords.empty()) {
+      out->texcoords.reserve(numVertices);
+      out->texcoords.insert(out->texcoords.end(),
+                            in->texcoords.begin(),in->texcoords.end());
+    }
+    out->indices.reserve(4*in->indices.size());
     // Mapping between original vertices and midpoints vs new vertices
     std::map<std::pair<int, int>, int> alreadyAddedVertices;
     // Iterate each triangle
@@ -129,6 +145,9 @@ namespace mini {
     for (auto obj : objects)
       for (auto &mesh : obj->meshes)
         mesh = meshSubstitutions[mesh];
+    // (and release the original meshes, which nothing refers to any
+    // more, before saving)
+    meshSubstitutions.clear();
 
     // nothing to do for objects or instances; they've got their old
     // content swapped out by now.